@@ -5,12 +5,220 @@
 
 /**************************************/
 // Стандартные ответы на команды
-extern const char* REPLY_OK = "ok";
-extern const char* REPLY_DONTUNDERSTAND = "dontunderstand";
-extern const char* REPLY_BAD_PARAMS = "badparams";
-extern const char* REPLY_ERROR = "error";
-extern const char* REPLY_REPLY_BUF_ERROR = "replybuferror";
-extern const char* REPLY_BUSY = "busy";
+const char* REPLY_OK = "ok";
+const char* REPLY_DONTUNDERSTAND = "dontunderstand";
+const char* REPLY_BAD_PARAMS = "badparams";
+const char* REPLY_ERROR = "error";
+const char* REPLY_REPLY_BUF_ERROR = "replybuferror";
+const char* REPLY_BUSY = "busy";
+const char* REPLY_INPUT_OVERFLOW = "inputoverflow";
+
+// Блокировка для выполнения команд (см babbler_set_cmd_lock)
+static babbler_cmd_lock _cmd_lock = NULL;
+
+// Обработчики вокруг выполнения команд (см babbler_add_cmd_hook)
+static babbler_cmd_hook_t* _cmd_hooks = NULL;
+
+#ifdef BABBLER_TRACE
+#if (BABBLER_TRACE_DEPTH & (BABBLER_TRACE_DEPTH - 1)) != 0
+#error "BABBLER_TRACE_DEPTH must be a power of two"
+#endif
+
+// номер записи, которая сейчас пишется (seq еще не выставлен); сам этот
+// номер вызовам не выдается (на AVR unsigned int - 16 бит, номер 65535
+// встречается каждые 65536 вызовов)
+#define TRACE_SEQ_WRITING ((unsigned int)-1)
+
+#if defined(__unix__) || defined(__APPLE__)
+    // команды могут выполняться в нескольких потоках (babbler_posix)
+    #define TRACE_FETCH_ADD(ptr) __atomic_fetch_add(ptr, 1, __ATOMIC_RELAXED)
+    #define TRACE_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+    #define TRACE_STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+    #define TRACE_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+    // на контроллере handle_command вызывается только из loop - 
+    // достаточно обычных операций (на AVR и Cortex-M0 нет атомарных инструкций)
+    #define TRACE_FETCH_ADD(ptr) ((*(ptr))++)
+    #define TRACE_LOAD(ptr) (*(volatile unsigned int*)(ptr))
+    #define TRACE_STORE(ptr, val) (*(volatile unsigned int*)(ptr) = (val))
+    #define TRACE_FENCE()
+#endif
+
+// Журнал команд (см babbler_set_trace_clock)
+static babbler_trace_entry_t _trace[BABBLER_TRACE_DEPTH];
+// Количество записей за все время (номер следующей записи)
+static unsigned int _trace_next = 0;
+static babbler_clock _trace_clock = NULL;
+
+/**
+ * Записать вызов команды в журнал. Номер записи захватывается
+ * атомарным инкрементом, запись помечается на время заполнения,
+ * чтобы babbler_trace_read не прочитал ее наполовину.
+ */
+static void _trace_record(int cmd, int argc, int result, unsigned long start) {
+    unsigned int seq = TRACE_FETCH_ADD(&_trace_next);
+    if(seq == TRACE_SEQ_WRITING) {
+        // номер совпал с пометкой - берем следующий, иначе babbler_trace_read
+        // примет готовую запись за недописанную (или наоборот)
+        seq = TRACE_FETCH_ADD(&_trace_next);
+    }
+    babbler_trace_entry_t* entry = &_trace[seq & (BABBLER_TRACE_DEPTH - 1)];
+    
+    TRACE_STORE(&entry->seq, TRACE_SEQ_WRITING);
+    TRACE_FENCE();
+    entry->cmd = cmd;
+    entry->argc = argc;
+    entry->result = result;
+    entry->start = start;
+    entry->duration = _trace_clock != NULL ? _trace_clock() - start : 0;
+    TRACE_STORE(&entry->seq, seq);
+}
+
+/**
+ * Задать часы для журнала команд.
+ */
+void babbler_set_trace_clock(babbler_clock clock) {
+    _trace_clock = clock;
+}
+
+/**
+ * Прочитать журнал команд: последние записи, от старых к новым.
+ */
+int babbler_trace_read(babbler_trace_entry_t* entries, int max_entries) {
+    unsigned int next = TRACE_LOAD(&_trace_next);
+    unsigned int count = next < BABBLER_TRACE_DEPTH ? next : BABBLER_TRACE_DEPTH;
+    if(max_entries < 0) {
+        max_entries = 0;
+    }
+    if(count > (unsigned int)max_entries) {
+        count = max_entries;
+    }
+    
+    int read = 0;
+    for(unsigned int seq = next - count; seq != next; seq++) {
+        babbler_trace_entry_t* entry = &_trace[seq & (BABBLER_TRACE_DEPTH - 1)];
+        if(TRACE_LOAD(&entry->seq) != seq) {
+            // запись пишется или уже перезаписана
+            continue;
+        }
+        entries[read] = *entry;
+        TRACE_FENCE();
+        if(TRACE_LOAD(&entry->seq) == seq) {
+            entries[read].seq = seq;
+            read++;
+        }
+    }
+    return read;
+}
+
+/**
+ * Очистить журнал команд.
+ */
+void babbler_trace_clear() {
+    for(int i = 0; i < BABBLER_TRACE_DEPTH; i++) {
+        _trace[i].seq = TRACE_SEQ_WRITING;
+    }
+}
+#endif // BABBLER_TRACE
+
+/**
+ * Задать блокировку, которую handle_command захватывает перед 
+ * выполнением найденной команды и освобождает после выполнения.
+ */
+void babbler_set_cmd_lock(babbler_cmd_lock cmd_lock) {
+    _cmd_lock = cmd_lock;
+}
+
+/**
+ * Добавить обработчики в конец цепочки.
+ */
+void babbler_add_cmd_hook(babbler_cmd_hook_t* hook) {
+    hook->next = NULL;
+    if(_cmd_hooks == NULL) {
+        _cmd_hooks = hook;
+    } else {
+        babbler_cmd_hook_t* last = _cmd_hooks;
+        while(last->next != NULL) {
+            last = last->next;
+        }
+        last->next = hook;
+    }
+}
+
+/**
+ * Убрать обработчики из цепочки.
+ */
+void babbler_remove_cmd_hook(babbler_cmd_hook_t* hook) {
+    babbler_cmd_hook_t** prev = &_cmd_hooks;
+    while(*prev != NULL && *prev != hook) {
+        prev = &(*prev)->next;
+    }
+    if(*prev != NULL) {
+        *prev = hook->next;
+    }
+}
+
+/**
+ * Выполнить найденную команду: обработчики before, блокировка,
+ * команда, обработчики after.
+ */
+static int _exec_cmd(const babbler_cmd_t* cmd, int argc, char *argv[], char* reply_buffer, int reply_buf_size) {
+    if(_cmd_hooks == NULL && _cmd_lock == NULL) {
+        // ничего лишнего - просто вызываем команду
+        return cmd->exec_cmd(reply_buffer, reply_buf_size, argc, argv);
+    }
+    
+    int reply_len = 0;
+    bool exec = true;
+    for(babbler_cmd_hook_t* hook = _cmd_hooks; hook != NULL && exec; hook = hook->next) {
+        if(hook->before != NULL) {
+            exec = hook->before(cmd, argc, argv, reply_buffer, reply_buf_size, &reply_len);
+        }
+    }
+    
+    if(exec) {
+        if(_cmd_lock == NULL) {
+            reply_len = cmd->exec_cmd(reply_buffer, reply_buf_size, argc, argv);
+        } else {
+            _cmd_lock(cmd, true);
+            reply_len = cmd->exec_cmd(reply_buffer, reply_buf_size, argc, argv);
+            _cmd_lock(cmd, false);
+        }
+    }
+    
+    for(babbler_cmd_hook_t* hook = _cmd_hooks; hook != NULL; hook = hook->next) {
+        if(hook->after != NULL) {
+            hook->after(cmd, argc, argv, reply_buffer, reply_buf_size, &reply_len);
+        }
+    }
+    return reply_len;
+}
+
+int babbler_find_cmd(const char* name) {
+    for(int i=0; i < BABBLER_COMMANDS_COUNT; i++) {
+        if(BABBLER_STRCMP_FLASH(name, BABBLER_COMMANDS[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const babbler_man_t* babbler_find_manual(const char* name) {
+    // руководство с тем же индексом, что и команда: имена - одна и та же
+    // строка (сравниваем указатели)
+    int i = babbler_find_cmd(name);
+    if(i != -1 && i < BABBLER_MANUALS_COUNT && BABBLER_MANUALS[i].name == BABBLER_COMMANDS[i].name) {
+        return &BABBLER_MANUALS[i];
+    }
+    
+    // таблицы в разном порядке - ищем по имени
+    for(i=0; i < BABBLER_MANUALS_COUNT; i++) {
+        if(BABBLER_STRCMP_FLASH(name, BABBLER_MANUALS[i].name) == 0) {
+            return &BABBLER_MANUALS[i];
+        }
+    }
+    return NULL;
+}
 
 /**
  * Найти команду по имени, выполнить, записать ответ в reply_buffer,
@@ -41,15 +249,23 @@ int handle_command(char* cmd, int argc, char *argv[], char* reply_buffer, int re
     
     bool success = false;
     
+    #ifdef BABBLER_TRACE
+        unsigned long trace_start = _trace_clock != NULL ? _trace_clock() : 0;
+        int trace_cmd = -1;
+    #endif // BABBLER_TRACE
+    
     // Определим, с какой командой имеем дело
-    for(int i=0; i < BABBLER_COMMANDS_COUNT && !success; i++) {
-        if(strcmp(cmd, BABBLER_COMMANDS[i].name) == 0) {
-            // Нашли команду с запрошенным именем
-            success = true;
-            
-            // Выполнить команду
-            reply_len = BABBLER_COMMANDS[i].exec_cmd(reply_buffer, reply_buf_size, argc, argv);
-        }
+    int i = babbler_find_cmd(cmd);
+    if(i != -1) {
+        // Нашли команду с запрошенным именем
+        success = true;
+        
+        // Выполнить команду
+        reply_len = _exec_cmd(&BABBLER_COMMANDS[i], argc, argv, reply_buffer, reply_buf_size);
+        
+        #ifdef BABBLER_TRACE
+            trace_cmd = i;
+        #endif // BABBLER_TRACE
     }
     
     if(!success) {
@@ -58,6 +274,10 @@ int handle_command(char* cmd, int argc, char *argv[], char* reply_buffer, int re
         reply_len = strlen(reply_buffer);
     }
     
+    #ifdef BABBLER_TRACE
+        _trace_record(trace_cmd, argc, reply_len, trace_start);
+    #endif // BABBLER_TRACE
+    
     return reply_len;
 }
 
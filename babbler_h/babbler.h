@@ -1,8 +1,43 @@
 #ifndef BABBLER_H
 #define BABBLER_H
 
+#include "babbler_lib_config.h"
+
 #include "stddef.h"
 
+/**************************************/
+// Имена команд и руководства во флеше (включается BABBLER_PROGMEM 
+// в babbler_lib_config.h): строки для полей babbler_cmd_t.name и 
+// babbler_man_t объявляются с атрибутом BABBLER_FLASH,
+// библиотека читает их через BABBLER_*_FLASH.
+// Command names and manuals in flash (BABBLER_PROGMEM): declare strings
+// for babbler_cmd_t.name and babbler_man_t with BABBLER_FLASH.
+//
+//     static const char _name_ledon[] BABBLER_FLASH = "ledon";
+//     const babbler_cmd_t CMD_LEDON = {_name_ledon, &cmd_ledon};
+#ifdef BABBLER_PROGMEM
+#include <avr/pgmspace.h>
+
+#define BABBLER_FLASH PROGMEM
+/** Сравнить строку в RAM со строкой во флеше */
+#define BABBLER_STRCMP_FLASH(str, flash_str) strcmp_P(str, flash_str)
+/** Скопировать строку из флеша в RAM */
+#define BABBLER_STRCPY_FLASH(dst, flash_str) strcpy_P(dst, flash_str)
+/** Длина строки во флеше */
+#define BABBLER_STRLEN_FLASH(flash_str) strlen_P(flash_str)
+/** Прочитать байт из флеша */
+#define BABBLER_READ_BYTE_FLASH(addr) pgm_read_byte(addr)
+/** Прочитать 16-битное слово из флеша */
+#define BABBLER_READ_WORD_FLASH(addr) pgm_read_word(addr)
+#else
+#define BABBLER_FLASH
+#define BABBLER_STRCMP_FLASH(str, flash_str) strcmp(str, flash_str)
+#define BABBLER_STRCPY_FLASH(dst, flash_str) strcpy(dst, flash_str)
+#define BABBLER_STRLEN_FLASH(flash_str) strlen(flash_str)
+#define BABBLER_READ_BYTE_FLASH(addr) (*(const unsigned char*)(addr))
+#define BABBLER_READ_WORD_FLASH(addr) (*(const unsigned short*)(addr))
+#endif // BABBLER_PROGMEM
+
 /**************************************/
 // Стандартные ответы на команды (значения см в babbler.cpp)
 /** Команда выполнена */
@@ -23,13 +58,47 @@ extern const char* REPLY_ERROR;
 extern const char* REPLY_REPLY_BUF_ERROR;
 /** Устройство занято, команда отклонена */
 extern const char* REPLY_BUSY;
+/** Входной пакет не поместился в буфер, команда отброшена */
+extern const char* REPLY_INPUT_OVERFLOW;
+
+/**************************************/
+// Флаги команд (поле babbler_cmd_t.flags)
+/** 
+ * Команда только читает состояние устройства (не меняет его): 
+ * может выполняться одновременно с другими такими же командами.
+ */
+#define BABBLER_CMD_READONLY 0x01
+/** 
+ * Команда меняет состояние устройства: одновременно может выполняться 
+ * только одна такая команда (команды BABBLER_CMD_READONLY могут 
+ * выполняться параллельно с ней).
+ */
+#define BABBLER_CMD_MUTATING 0x02
+/** 
+ * Команда должна выполняться в одиночестве: никакие другие команды 
+ * не выполняются одновременно с ней. Так же обрабатываются команды 
+ * без флагов (значение по умолчанию для старых таблиц команд).
+ */
+#define BABBLER_CMD_EXCLUSIVE 0x04
+/** 
+ * Ответ команды зависит только от имени команды и параметров 
+ * (например, ping, name, version): ответ можно кэшировать.
+ */
+#define BABBLER_CMD_PURE 0x08
+/** 
+ * Ответ команды, который начинается с '{', - готовый объект JSON 
+ * (например, devinfo --json): обработчики формата JSON вставляют его 
+ * в поле reply как есть, без кавычек. Ответы остальных команд 
+ * всегда передаются строкой.
+ */
+#define BABBLER_CMD_REPLY_JSON 0x10
 
 /**
  * Информация, необходимая для запуска команды: 
  * имя и ссылка на функцию, выполняющую команду.
  */
 typedef struct {
-    /** Имя команды */
+    /** Имя команды (с BABBLER_PROGMEM - строка во флеше) */
     const char* name;
     
     /** 
@@ -49,15 +118,29 @@ typedef struct {
      *    -1: ошибка при формировании ответа (не хватило места в буфере, ошибка выделения памяти и т.п.)
      */
     int (*exec_cmd)(char* reply_buffer, int reply_buf_size, int argc, char *argv[]);
+    
+    /** 
+     * Флаги BABBLER_CMD_* (можно не указывать, по умолчанию 0 - 
+     * команда обрабатывается как BABBLER_CMD_EXCLUSIVE).
+     */
+    int flags;
 } babbler_cmd_t;
 
+/**
+ * Блокировка для выполнения команды (см babbler_set_cmd_lock).
+ * @param cmd - команда, которая будет выполнена (или только что выполнена)
+ * @param lock - true: захватить блокировку перед выполнением команды,
+ *     false: освободить после выполнения
+ */
+typedef void (*babbler_cmd_lock)(const babbler_cmd_t* cmd, bool lock);
+
 /**
  * Информация по использованию команды: 
  * имя, краткое описание, подробное описание 
  * (синтаксис, описание параметров, руководство).
  */
 typedef struct {
-    /** Имя команды */
+    /** Имя команды (с BABBLER_PROGMEM все строки руководства - во флеше) */
     const char* name;
         
     /** Краткое описание команды */
@@ -92,6 +175,82 @@ extern const babbler_man_t BABBLER_MANUALS[];
  */
 extern const int BABBLER_MANUALS_COUNT;
 
+/**
+ * Объявить таблицы BABBLER_COMMANDS и BABBLER_MANUALS (и количества)
+ * одним списком: каждая команда указывается один раз вместе с
+ * руководством, руководство получает тот же индекс, что и команда
+ * (babbler_find_manual находит его без сравнения строк).
+ * Команда, указанная в списке дважды, - ошибка компиляции
+ * (повторное объявление _babbler_cmd_<имя>).
+ *
+ * list - макрос со списком команд, принимает два макроса:
+ *     CMD(name, exec_cmd, flags, short_descr, manual) - новая команда,
+ *         name - имя без кавычек (строки имени, краткого описания и
+ *         руководства объявляются с BABBLER_FLASH);
+ *     USE(name, cmd, man) - готовые babbler_cmd_t и babbler_man_t
+ *         (например, из babbler_cmd_core.h), name - имя команды без кавычек.
+ *
+ * Declare BABBLER_COMMANDS and BABBLER_MANUALS (and counts) from a single
+ * list: each command is listed once with its manual, the manual gets the
+ * command's index (found by babbler_find_manual without string compare).
+ * A command listed twice fails to compile.
+ *
+ *     #define COMMANDS(CMD, USE) \
+ *         USE(help, CMD_HELP, MAN_HELP) \
+ *         USE(ping, CMD_PING, MAN_PING) \
+ *         CMD(ledon, &cmd_ledon, BABBLER_CMD_MUTATING, "turn led ON", \
+ *             "SYNOPSIS\n" \
+ *             "    ledon\n" \
+ *             "DESCRIPTION\n" \
+ *             "Turn led ON.")
+ *     BABBLER_REGISTER_COMMANDS(COMMANDS)
+ */
+#define BABBLER_REGISTER_COMMANDS(list) \
+    enum { list(_BABBLER_REG_ID, _BABBLER_REG_USE_ID) _babbler_cmd_count_ }; \
+    list(_BABBLER_REG_STRINGS, _BABBLER_REG_USE_STRINGS) \
+    extern const babbler_cmd_t BABBLER_COMMANDS[] = { \
+        list(_BABBLER_REG_CMD, _BABBLER_REG_USE_CMD) \
+    }; \
+    extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t); \
+    extern const babbler_man_t BABBLER_MANUALS[] = { \
+        list(_BABBLER_REG_MAN, _BABBLER_REG_USE_MAN) \
+    }; \
+    extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+// элементы списка для BABBLER_REGISTER_COMMANDS
+#define _BABBLER_REG_ID(name, exec_cmd, flags, short_descr, manual) _babbler_cmd_##name,
+#define _BABBLER_REG_USE_ID(name, cmd, man) _babbler_cmd_##name,
+#define _BABBLER_REG_STRINGS(name, exec_cmd, flags, short_descr, manual) \
+    static const char _babbler_name_##name[] BABBLER_FLASH = #name; \
+    static const char _babbler_descr_##name[] BABBLER_FLASH = short_descr; \
+    static const char _babbler_man_##name[] BABBLER_FLASH = manual;
+#define _BABBLER_REG_USE_STRINGS(name, cmd, man)
+#define _BABBLER_REG_CMD(name, exec_cmd, flags, short_descr, manual) \
+    {_babbler_name_##name, exec_cmd, flags},
+#define _BABBLER_REG_USE_CMD(name, cmd, man) cmd,
+#define _BABBLER_REG_MAN(name, exec_cmd, flags, short_descr, manual) \
+    {_babbler_name_##name, _babbler_descr_##name, _babbler_man_##name},
+#define _BABBLER_REG_USE_MAN(name, cmd, man) man,
+
+/**
+ * Найти зарегистрированную команду по имени.
+ *
+ * @param name - имя команды
+ * @return индекс команды в BABBLER_COMMANDS или -1, если команда не найдена
+ */
+int babbler_find_cmd(const char* name);
+
+/**
+ * Найти руководство для команды по имени: если у руководства с тем же 
+ * индексом, что и у команды в BABBLER_COMMANDS, та же строка имени 
+ * (таблицы объявлены BABBLER_REGISTER_COMMANDS или вручную в одном порядке), 
+ * руководство берется по индексу, иначе ищется по имени в BABBLER_MANUALS.
+ *
+ * @param name - имя команды
+ * @return руководство или NULL, если не найдено
+ */
+const babbler_man_t* babbler_find_manual(const char* name);
+
 /**
  * Найти команду по имени, выполнить, записать ответ в reply_buffer,
  * вернуть размер ответа.
@@ -116,5 +275,139 @@ extern const int BABBLER_MANUALS_COUNT;
  */
 int handle_command(char* cmd, int argc, char *argv[], char* reply_buffer, int reply_buf_size);
 
+/**
+ * Задать блокировку, которую handle_command захватывает перед 
+ * выполнением найденной команды и освобождает после выполнения, 
+ * например, чтобы многопоточный модуль ввода-вывода выполнял команды 
+ * BABBLER_CMD_READONLY параллельно, а остальные по очереди 
+ * (см поле babbler_cmd_t.flags).
+ * По умолчанию блокировки нет (NULL).
+ */
+void babbler_set_cmd_lock(babbler_cmd_lock cmd_lock);
+
+/**
+ * Обработчик, который вызывается перед выполнением команды
+ * (см babbler_add_cmd_hook).
+ * @param cmd - найденная команда
+ * @param argc - количество параметров команды (с именем команды)
+ * @param argv - параметры команды
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer
+ * @param reply_len - результат команды, если обработчик отменяет выполнение
+ * @return true - продолжить (следующие обработчики, выполнение команды);
+ *     false - не выполнять команду, результат - значение reply_len
+ *     (ответ уже в reply_buffer), например, отказ в доступе или ответ из кэша
+ */
+typedef bool (*babbler_cmd_before)(const babbler_cmd_t* cmd, int argc, char *argv[],
+        char* reply_buffer, int reply_buf_size, int* reply_len);
+
+/**
+ * Обработчик, который вызывается после выполнения команды
+ * (см babbler_add_cmd_hook).
+ * @param reply_len - результат команды (длина ответа или код ошибки),
+ *     обработчик может его изменить вместе с ответом в reply_buffer
+ * Остальные параметры - как у babbler_cmd_before.
+ */
+typedef void (*babbler_cmd_after)(const babbler_cmd_t* cmd, int argc, char *argv[],
+        char* reply_buffer, int reply_buf_size, int* reply_len);
+
+/**
+ * Обработчики вокруг выполнения команд: замер времени, журнал,
+ * проверка доступа, кэш ответов, сброс сторожевого таймера и т.п.
+ * без изменений в коде самих команд. Структура должна жить все время,
+ * пока обработчики зарегистрированы (глобальная или статическая переменная).
+ */
+typedef struct babbler_cmd_hook_t {
+    /** Вызывается перед выполнением команды (NULL - не вызывать) */
+    babbler_cmd_before before;
+    /** Вызывается после выполнения команды (NULL - не вызывать) */
+    babbler_cmd_after after;
+    
+    /** Следующие обработчики в цепочке (заполняется babbler_add_cmd_hook) */
+    struct babbler_cmd_hook_t* next;
+} babbler_cmd_hook_t;
+
+/**
+ * Добавить обработчики в конец цепочки. Обработчики before вызываются
+ * в порядке добавления; если один из них отменил выполнение команды,
+ * следующие before и сама команда не вызываются. Обработчики after 
+ * вызываются в порядке добавления всегда, когда команда найдена.
+ * Пока цепочка пуста (и нет блокировки babbler_set_cmd_lock), 
+ * handle_command вызывает команду напрямую.
+ * Добавлять обработчики до начала обработки команд.
+ *
+ *     static bool check_access(const babbler_cmd_t* cmd, int argc, char *argv[],
+ *             char* reply_buffer, int reply_buf_size, int* reply_len) {
+ *         if(locked && (cmd->flags & BABBLER_CMD_READONLY) == 0) {
+ *             strcpy(reply_buffer, REPLY_ERROR);
+ *             *reply_len = strlen(reply_buffer);
+ *             return false;
+ *         }
+ *         return true;
+ *     }
+ *     babbler_cmd_hook_t access_hook = {&check_access, NULL};
+ *     ...
+ *     babbler_add_cmd_hook(&access_hook);
+ */
+void babbler_add_cmd_hook(babbler_cmd_hook_t* hook);
+
+/**
+ * Убрать обработчики из цепочки.
+ */
+void babbler_remove_cmd_hook(babbler_cmd_hook_t* hook);
+
+#ifdef BABBLER_TRACE
+/**************************************/
+// Журнал выполненных команд (включается BABBLER_TRACE в babbler_lib_config.h):
+// кольцевой буфер на BABBLER_TRACE_DEPTH последних вызовов handle_command,
+// запись без блокировок (можно вызывать handle_command из нескольких потоков).
+// Command trace ring with the last BABBLER_TRACE_DEPTH handle_command calls.
+
+/**
+ * Источник времени для журнала команд (например, micros или millis).
+ */
+typedef unsigned long (*babbler_clock)();
+
+/**
+ * Запись журнала команд.
+ */
+typedef struct {
+    /** Порядковый номер вызова handle_command */
+    unsigned int seq;
+    /** Индекс команды в BABBLER_COMMANDS, -1 - команда не найдена */
+    int cmd;
+    /** Количество параметров (с именем команды) */
+    int argc;
+    /** Результат: длина ответа или код ошибки */
+    int result;
+    /** Время начала по часам babbler_set_trace_clock */
+    unsigned long start;
+    /** Длительность выполнения по тем же часам */
+    unsigned long duration;
+} babbler_trace_entry_t;
+
+/**
+ * Задать часы для журнала команд. По умолчанию часов нет (NULL),
+ * время начала и длительность записываются нулями.
+ *
+ *     babbler_set_trace_clock(&micros);
+ */
+void babbler_set_trace_clock(babbler_clock clock);
+
+/**
+ * Прочитать журнал команд: последние записи, от старых к новым.
+ * Запись, которую в этот момент перезаписывает другой поток, пропускается.
+ * @param entries - массив для записей
+ * @param max_entries - максимальное количество записей
+ * @return количество прочитанных записей
+ */
+int babbler_trace_read(babbler_trace_entry_t* entries, int max_entries);
+
+/**
+ * Очистить журнал команд.
+ */
+void babbler_trace_clear();
+#endif // BABBLER_TRACE
+
 #endif // BABBLER_H
 
@@ -0,0 +1,185 @@
+#include "babbler_async.h"
+
+#include "babbler.h"
+
+#include "string.h"
+
+/**
+ * Отложенная команда.
+ */
+typedef struct {
+    /** Ячейка занята */
+    bool used;
+    /** Владелец - модуль ввода-вывода, который отправит ответ */
+    void* owner;
+    
+    babbler_async_poll poll;
+    void* ctx;
+    
+    /** Оформление ответа (NULL - ответ не отправлять) */
+    babbler_async_finish finish;
+    int reserve;
+    
+    char cmd[BABBLER_ASYNC_CMD_SIZE];
+    char cmd_id[BABBLER_ASYNC_ID_SIZE];
+    bool has_id;
+} _async_cmd_t;
+
+static _async_cmd_t _cmds[BABBLER_ASYNC_MAX_INFLIGHT];
+static int _inflight = 0;
+
+/** Только что отложенная команда (ждет set_finish), -1 - нет */
+static int _pending = -1;
+/** Имя и id запроса выполняемой команды (см babbler_async_bind) */
+static const char* _bound_cmd = NULL;
+static const char* _bound_id = NULL;
+/** Владелец для новых отложенных команд */
+static void* _owner = NULL;
+/** С какой ячейки начинать опрос в babbler_async_tasks (по кругу) */
+static int _next_poll = 0;
+
+/**
+ * Отложить ответ команды: вызывать из функции exec_cmd вместо
+ * формирования ответа.
+ * @param poll - функция опроса команды
+ * @param ctx - произвольное значение для функции опроса
+ * @return REPLY_DEFERRED или длина ответа REPLY_BUSY (REPLY_ERROR, 
+ *     REPLY_REPLY_BUF_ERROR) в reply_buffer
+ */
+int babbler_async_defer(babbler_async_poll poll, void* ctx, char* reply_buffer, int reply_buf_size) {
+    if(_owner == NULL) {
+        // команду выполняет модуль, который не опрашивает отложенные
+        // команды (не babbler_serial, например babbler_posix): ответ
+        // никто не отправит, а ячейка останется занятой - отвечаем ошибкой
+        strcpy(reply_buffer, REPLY_ERROR);
+        return strlen(reply_buffer);
+    }
+    if(_bound_cmd == NULL) {
+        // формат без имени команды и id в ответе (handle_command_simple): 
+        // ответ, пришедший не по порядку, клиент не сопоставит с запросом
+        strcpy(reply_buffer, REPLY_ERROR);
+        return strlen(reply_buffer);
+    }
+    if(strlen(_bound_cmd) >= BABBLER_ASYNC_CMD_SIZE || 
+            (_bound_id != NULL && strlen(_bound_id) >= BABBLER_ASYNC_ID_SIZE)) {
+        // имя или id не помещаются в ячейку, а по обрезанным 
+        // клиент не узнает свой запрос
+        strcpy(reply_buffer, REPLY_REPLY_BUF_ERROR);
+        return strlen(reply_buffer);
+    }
+    
+    for(int i = 0; i < BABBLER_ASYNC_MAX_INFLIGHT; i++) {
+        if(!_cmds[i].used) {
+            _cmds[i].used = true;
+            _cmds[i].owner = _owner;
+            _cmds[i].poll = poll;
+            _cmds[i].ctx = ctx;
+            _cmds[i].finish = NULL;
+            _cmds[i].reserve = 0;
+            strcpy(_cmds[i].cmd, _bound_cmd);
+            _cmds[i].has_id = _bound_id != NULL;
+            if(_bound_id != NULL) {
+                strcpy(_cmds[i].cmd_id, _bound_id);
+            }
+            _inflight++;
+            _pending = i;
+            return REPLY_DEFERRED;
+        }
+    }
+    
+    // все ячейки заняты - выполнить команду сейчас нельзя
+    strcpy(reply_buffer, REPLY_BUSY);
+    return strlen(reply_buffer);
+}
+
+/**
+ * Запомнить имя команды и идентификатор запроса для команды, 
+ * которая сейчас будет выполнена (строки копирует babbler_async_defer).
+ */
+void babbler_async_bind(const char* cmd, const char* cmd_id) {
+    _bound_cmd = cmd;
+    _bound_id = cmd_id;
+}
+
+/**
+ * Задать оформление ответа для только что отложенной команды.
+ */
+void babbler_async_set_finish(babbler_async_finish finish, int reserve) {
+    if(_pending < 0) {
+        return;
+    }
+    _cmds[_pending].finish = finish;
+    _cmds[_pending].reserve = reserve;
+    _pending = -1;
+}
+
+/**
+ * Задать владельца для команд, которые будут отложены дальше.
+ */
+void babbler_async_set_owner(void* owner) {
+    _owner = owner;
+    // команда, для которой обработчик входных данных не задал
+    // оформление ответа, так и останется без ответа
+    _pending = -1;
+}
+
+/**
+ * Опросить отложенные команды владельца owner; ответ первой завершившейся
+ * команды оформить и записать в reply_buffer.
+ * @return длина ответа для отправки или 0, если отправлять нечего
+ */
+int babbler_async_tasks(void* owner, char* reply_buffer, int reply_buf_size) {
+    if(_inflight == 0) {
+        return 0;
+    }
+    
+    // опрашиваем по кругу, чтобы частые завершения одной команды
+    // не задерживали ответы остальных
+    for(int n = 0; n < BABBLER_ASYNC_MAX_INFLIGHT; n++) {
+        int i = (_next_poll + n) % BABBLER_ASYNC_MAX_INFLIGHT;
+        _async_cmd_t* cmd = &_cmds[i];
+        if(!cmd->used || cmd->owner != owner) {
+            continue;
+        }
+        
+        reply_buffer[0] = 0;
+        int reply_len = cmd->poll(reply_buffer, reply_buf_size - cmd->reserve, cmd->ctx);
+        if(reply_len == REPLY_DEFERRED) {
+            continue;
+        }
+        
+        // команда завершена - освобождаем ячейку
+        cmd->used = false;
+        _inflight--;
+        _next_poll = (i + 1) % BABBLER_ASYNC_MAX_INFLIGHT;
+        
+        if(cmd->finish == NULL) {
+            continue;
+        }
+        reply_len = cmd->finish(cmd->cmd, cmd->has_id ? cmd->cmd_id : NULL,
+            reply_buffer, reply_len, reply_buf_size);
+        if(reply_len > 0) {
+            return reply_len;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Количество выполняющихся отложенных команд владельца owner
+ * (NULL - всех владельцев).
+ */
+int babbler_async_inflight(void* owner) {
+    if(owner == NULL) {
+        return _inflight;
+    }
+    
+    int count = 0;
+    for(int i = 0; i < BABBLER_ASYNC_MAX_INFLIGHT; i++) {
+        if(_cmds[i].used && _cmds[i].owner == owner) {
+            count++;
+        }
+    }
+    return count;
+}
+
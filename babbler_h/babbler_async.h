@@ -0,0 +1,136 @@
+#ifndef BABBLER_ASYNC_H
+#define BABBLER_ASYNC_H
+
+#include "babbler_lib_config.h"
+#include "babbler_io.h"
+
+// Отложенные (асинхронные) команды: долгая команда не блокирует
+// обработку следующих запросов. Команда запускает действие, регистрирует
+// функцию опроса (babbler_async_defer) и сразу возвращает REPLY_DEFERRED;
+// модуль ввода-вывода продолжает принимать и выполнять другие команды,
+// а ответ отложенной команды отправляет, когда функция опроса сообщит
+// о завершении. В формате JSON ответ содержит id запроса, так что клиент
+// может держать несколько запросов в работе и сопоставлять ответы,
+// пришедшие не по порядку.
+//
+// Deferred commands: a slow command starts its action, registers a poll
+// function with babbler_async_defer and returns REPLY_DEFERRED; the I/O module
+// keeps serving other requests and sends the deferred reply when the poll
+// function reports completion (JSON replies carry the request id).
+//
+// Отложенные ответы отправляет только babbler_serial (в одном потоке):
+// вне его обработчика входных данных (например, в babbler_posix) команда
+// не откладывается, а получает ответ REPLY_ERROR. Так же и в форматах,
+// где в ответе нет имени команды и id запроса (handle_input_simple,
+// handle_input_simple_cobs, handle_input_simple_len_prefix): ответ,
+// пришедший не по порядку, там не с чем сопоставить.
+//
+// Only babbler_serial (single thread) sends deferred replies: outside its
+// input handler (e.g. under babbler_posix) a deferring command gets
+// REPLY_ERROR instead. So does it in formats whose replies carry no
+// command name and request id (handle_input_simple and its COBS and
+// length-prefixed variants): an out-of-order reply could not be matched.
+
+/**
+ * Функция опроса отложенной команды.
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа
+ * @param ctx - значение, переданное в babbler_async_defer
+ * @return
+ *     REPLY_DEFERRED - команда еще выполняется, опросить позже;
+ *     иначе результат выполнения команды, как у babbler_cmd_t.exec_cmd:
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+typedef int (*babbler_async_poll)(char* reply_buffer, int reply_buf_size, void* ctx);
+
+/**
+ * Оформить ответ отложенной команды для отправки: обернуть
+ * (например, в JSON с id запроса) и упаковать в пакет формата
+ * обработчика входных данных, которым была принята команда.
+ * @param cmd - имя команды
+ * @param cmd_id - клиентский идентификатор запроса (NULL, если нет)
+ * @param reply_buffer - буфер с результатом функции опроса
+ * @param reply_len - результат функции опроса (длина ответа или код ошибки)
+ * @param reply_buf_size - полный размер буфера reply_buffer
+ * @return длина пакета с ответом в байтах или код ошибки
+ */
+typedef int (*babbler_async_finish)(char* cmd, char* cmd_id,
+        char* reply_buffer, int reply_len, int reply_buf_size);
+
+/**
+ * Отложить ответ команды: вызывать из функции exec_cmd вместо
+ * формирования ответа.
+ *
+ *     int cmd_measure(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+ *         start_measure();
+ *         return babbler_async_defer(&poll_measure, NULL, reply_buffer, reply_buf_size);
+ *     }
+ *
+ * @param poll - функция опроса команды
+ * @param ctx - произвольное значение для функции опроса
+ * @return REPLY_DEFERRED - команда зарегистрирована, вернуть это значение из exec_cmd;
+ *     если уже выполняется BABBLER_ASYNC_MAX_INFLIGHT отложенных команд,
+ *     в reply_buffer записывается ответ REPLY_BUSY и возвращается его длина;
+ *     если владелец не задан (команду выполняет не babbler_serial, см
+ *     babbler_async_set_owner) или формат запроса не задал имя команды 
+ *     (см babbler_async_bind) - ответ REPLY_ERROR;
+ *     если имя команды или id запроса не помещаются в BABBLER_ASYNC_CMD_SIZE 
+ *     или BABBLER_ASYNC_ID_SIZE - ответ REPLY_REPLY_BUF_ERROR (обрезанный id 
+ *     клиент не сопоставит с запросом)
+ */
+int babbler_async_defer(babbler_async_poll poll, void* ctx, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Запомнить имя команды и идентификатор запроса для команды, которая 
+ * сейчас будет выполнена (вызывает обработчик формата с именем команды 
+ * в ответе, например handle_command_json, перед handle_command; после 
+ * выполнения сбросить - babbler_async_bind(NULL, NULL)). Отложить ответ 
+ * может только команда с заданным именем; строки должны жить, пока 
+ * выполняется команда, babbler_async_defer копирует их в ячейку.
+ * @param cmd - имя команды (NULL - сбросить)
+ * @param cmd_id - клиентский идентификатор запроса (NULL, если нет)
+ */
+void babbler_async_bind(const char* cmd, const char* cmd_id);
+
+/**
+ * Задать оформление ответа для только что отложенной команды (вызывает
+ * обработчик входных данных, например handle_input_json, когда команда
+ * вернула REPLY_DEFERRED). Пока оформление не задано, ответ команды
+ * не отправляется (отбрасывается после завершения).
+ * @param finish - функция оформления ответа
+ * @param reserve - сколько байт буфера ответа оставить для оформления
+ *     (функции опроса достанется reply_buf_size-reserve байт)
+ */
+void babbler_async_set_finish(babbler_async_finish finish, int reserve);
+
+/**
+ * Задать владельца для команд, которые будут отложены дальше (вызывает
+ * модуль ввода-вывода перед вызовом обработчика входных данных, например
+ * канал babbler_serial_t): ответ отложенной команды получит тот же канал
+ * (см babbler_async_tasks). После обработчика входных данных сбросить
+ * владельца (NULL), чтобы команды, выполненные другими модулями,
+ * не занимали ячейки, которые никто не опросит.
+ */
+void babbler_async_set_owner(void* owner);
+
+/**
+ * Опросить отложенные команды владельца owner; ответ первой завершившейся
+ * команды оформить и записать в reply_buffer (вызывает модуль ввода-вывода,
+ * когда буфер ответа свободен).
+ * @param owner - владелец (см babbler_async_set_owner)
+ * @param reply_buffer - буфер ответа модуля ввода-вывода
+ * @param reply_buf_size - размер буфера reply_buffer
+ * @return длина ответа для отправки или 0, если отправлять нечего
+ */
+int babbler_async_tasks(void* owner, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Количество выполняющихся отложенных команд владельца owner
+ * (NULL - всех владельцев).
+ */
+int babbler_async_inflight(void* owner);
+
+#endif // BABBLER_ASYNC_H
+
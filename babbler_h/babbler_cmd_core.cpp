@@ -1,18 +1,21 @@
 #include "babbler_cmd_core.h"
 
 #include "babbler.h"
+#include "babbler_manpack.h"
 
 #include "stdio.h"
+#include "stdlib.h"
 #include "string.h"
 
+static const char _name_help[] BABBLER_FLASH = "help";
 extern const babbler_cmd_t CMD_HELP = {
-    "help",
-    &cmd_help
+    _name_help,
+    &cmd_help,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
 
-extern const babbler_man_t MAN_HELP = {
-    "help",
-    "list available commands or show detailed help on selected command", 
+static const char _descr_help[] BABBLER_FLASH = "list available commands or show detailed help on selected command";
+static const char _man_help[] BABBLER_FLASH = 
     "SYNOPSIS\n"
     "    help\n"
     "    help [cmd_name]\n"
@@ -22,69 +25,115 @@ extern const babbler_man_t MAN_HELP = {
     "Running help with no options would list commands with short description.\n"
     "OPTIONS\n"
     "    cmd_name - command name to show detailed help for\n"
-    "    --list - list all available commands separated by space"
+    "    --list - list all available commands separated by space";
+extern const babbler_man_t MAN_HELP = {
+    _name_help,
+    _descr_help,
+    _man_help
 };
 
 
+static const char _name_ping[] BABBLER_FLASH = "ping";
 extern const babbler_cmd_t CMD_PING = {
-    "ping",
-    &cmd_ping
+    _name_ping,
+    &cmd_ping,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
 
-extern const babbler_man_t MAN_PING = {
-    "ping",
-    "check if device is available",
+static const char _descr_ping[] BABBLER_FLASH = "check if device is available";
+static const char _man_ping[] BABBLER_FLASH = 
     "SYNOPSIS\n"
     "    ping\n"
     "DESCRIPTION\n"
-    "Check if device is available, returns \"ok\" if device is ok"
+    "Check if device is available, returns \"ok\" if device is ok";
+extern const babbler_man_t MAN_PING = {
+    _name_ping,
+    _descr_ping,
+    _man_ping
+};
+
+#ifdef BABBLER_TRACE
+static const char _name_trace[] BABBLER_FLASH = "trace";
+extern const babbler_cmd_t CMD_TRACE = {
+    _name_trace,
+    &cmd_trace,
+    BABBLER_CMD_READONLY
+};
+
+static const char _descr_trace[] BABBLER_FLASH = "show last executed commands";
+static const char _man_trace[] BABBLER_FLASH = 
+    "SYNOPSIS\n"
+    "    trace\n"
+    "    trace [count]\n"
+    "    trace clear\n"
+    "DESCRIPTION\n"
+    "Show last executed commands, oldest first, one per line: "
+    "sequence number, command name (? - not found), argument count "
+    "with command name, result (reply length or error code), start time "
+    "and duration in device clock units; \"ok\" if trace is empty.\n"
+    "OPTIONS\n"
+    "    count - show only last count commands\n"
+    "    clear - clear trace";
+extern const babbler_man_t MAN_TRACE = {
+    _name_trace,
+    _descr_trace,
+    _man_trace
 };
+#endif // BABBLER_TRACE
 
 
 /** 
  * Вывести список команд.
  */
 int cmd_help(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    // имена и руководства могут быть во флеше (BABBLER_PROGMEM), 
+    // поэтому копируем их через BABBLER_STRCPY_FLASH
     if(argc <= 1) {
         // параметры не заданы или задан только 1й параметр (имя команды) - 
         // выводим список команд с кратким описанием
-        sprintf(reply_buffer, "Commands: \n");
+        strcpy(reply_buffer, "Commands: \n");
         for(int i=0; i < BABBLER_MANUALS_COUNT; i++) {
-            sprintf(reply_buffer+strlen(reply_buffer), "%s\n", BABBLER_MANUALS[i].name);
+            BABBLER_STRCPY_FLASH(reply_buffer+strlen(reply_buffer), BABBLER_MANUALS[i].name);
+            strcat(reply_buffer, "\n");
             if(BABBLER_MANUALS[i].short_descr != NULL) {
-                sprintf(reply_buffer+strlen(reply_buffer), "    %s\n", BABBLER_MANUALS[i].short_descr);
+                strcat(reply_buffer, "    ");
+                BABBLER_STRCPY_FLASH(reply_buffer+strlen(reply_buffer), BABBLER_MANUALS[i].short_descr);
+                strcat(reply_buffer, "\n");
             }
         }
     } else if(strcmp("--list", argv[1]) == 0) {
         // вывести список всех команд через пробел
         for(int i=0; i < BABBLER_MANUALS_COUNT; i++) {
-            sprintf(reply_buffer+strlen(reply_buffer), "%s", BABBLER_MANUALS[i].name);
+            BABBLER_STRCPY_FLASH(reply_buffer+strlen(reply_buffer), BABBLER_MANUALS[i].name);
             // добавлять пробел после каждой команды, кроме последней
             if(i < BABBLER_MANUALS_COUNT - 1) {
-                sprintf(reply_buffer+strlen(reply_buffer), " ");
+                strcat(reply_buffer, " ");
             }
         }
     } else {
         // вывести справку по указанной команде
-        bool cmd_found = false;
-        for(int i=0; i < BABBLER_MANUALS_COUNT && !cmd_found; i++) {
-            if(strcmp(BABBLER_MANUALS[i].name, argv[1]) == 0) {
-                sprintf(reply_buffer+strlen(reply_buffer), 
-                    "%s - manual\n", BABBLER_MANUALS[i].name);
-                if(BABBLER_MANUALS[i].short_descr != NULL && BABBLER_MANUALS[i].manual != NULL) {
-                    sprintf(reply_buffer+strlen(reply_buffer), 
-                        "NAME\n"
-                        "    %s - %s\n"
-                        "%s",
-                        BABBLER_MANUALS[i].name, BABBLER_MANUALS[i].short_descr, 
-                        BABBLER_MANUALS[i].manual);
-                }
-                
-                cmd_found = true;
+        const babbler_man_t* man = babbler_find_manual(argv[1]);
+        if(man != NULL) {
+            strcat(reply_buffer, argv[1]);
+            strcat(reply_buffer, " - manual\n");
+            if(man->short_descr != NULL && man->manual != NULL) {
+                strcat(reply_buffer, "NAME\n    ");
+                strcat(reply_buffer, argv[1]);
+                strcat(reply_buffer, " - ");
+                BABBLER_STRCPY_FLASH(reply_buffer+strlen(reply_buffer), man->short_descr);
+                strcat(reply_buffer, "\n");
+#ifdef BABBLER_PACKED_MANUALS
+                if(babbler_man_is_packed(man->manual)) {
+                    // сжатое руководство распаковываем сразу в буфер ответа
+                    int len = strlen(reply_buffer);
+                    if(babbler_man_unpack(reply_buffer+len, reply_buf_size-len, man->manual) == -1) {
+                        return -1;
+                    }
+                } else
+#endif
+                BABBLER_STRCPY_FLASH(reply_buffer+strlen(reply_buffer), man->manual);
             }
-        }
-        
-        if(!cmd_found) {
+        } else {
             // команда не найдена
             sprintf(reply_buffer+strlen(reply_buffer), "help: COMMAND NOT FOUND: %s", argv[1]);
         }
@@ -103,3 +152,70 @@ int cmd_ping(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
     return strlen(reply_buffer);
 }
 
+#ifdef BABBLER_TRACE
+/** 
+ * Показать журнал выполненных команд: по строке на команду,
+ * от старых к новым.
+ */
+int cmd_trace(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    int count = BABBLER_TRACE_DEPTH;
+    if(argc == 2 && strcmp("clear", argv[1]) == 0) {
+        babbler_trace_clear();
+        strcpy(reply_buffer, REPLY_OK);
+        return strlen(reply_buffer);
+    } else if(argc == 2 && atoi(argv[1]) > 0) {
+        count = atoi(argv[1]);
+        if(count > BABBLER_TRACE_DEPTH) {
+            count = BABBLER_TRACE_DEPTH;
+        }
+    } else if(argc > 1) {
+        strcpy(reply_buffer, REPLY_BAD_PARAMS);
+        return strlen(reply_buffer);
+    }
+    
+    babbler_trace_entry_t entries[BABBLER_TRACE_DEPTH];
+    count = babbler_trace_read(entries, count);
+    
+    int len = 0;
+    for(int i = 0; i < count; i++) {
+        // номер, имя команды (может быть во флеше), остальные поля
+        int line_len = snprintf(reply_buffer + len, reply_buf_size - len, "%s%u ",
+            i > 0 ? "\n" : "", entries[i].seq);
+        if(line_len < 0 || line_len >= reply_buf_size - len) {
+            // не влезло - пусть запросят меньше записей
+            return -1;
+        }
+        len += line_len;
+        
+        if(entries[i].cmd >= 0) {
+            const char* name = BABBLER_COMMANDS[entries[i].cmd].name;
+            if((int)BABBLER_STRLEN_FLASH(name) >= reply_buf_size - len) {
+                return -1;
+            }
+            BABBLER_STRCPY_FLASH(reply_buffer + len, name);
+            len += strlen(reply_buffer + len);
+        } else {
+            // команда не найдена
+            if(reply_buf_size - len < 2) {
+                return -1;
+            }
+            strcpy(reply_buffer + len, "?");
+            len++;
+        }
+        
+        line_len = snprintf(reply_buffer + len, reply_buf_size - len, " %d %d %lu %lu",
+            entries[i].argc, entries[i].result, entries[i].start, entries[i].duration);
+        if(line_len < 0 || line_len >= reply_buf_size - len) {
+            return -1;
+        }
+        len += line_len;
+    }
+    
+    if(count == 0) {
+        // журнал пуст
+        strcpy(reply_buffer, REPLY_OK);
+        len = strlen(reply_buffer);
+    }
+    return len;
+}
+#endif // BABBLER_TRACE
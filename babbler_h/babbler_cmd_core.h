@@ -14,6 +14,11 @@ extern const babbler_man_t MAN_HELP;
 /** Проверить доступность устройства */
 extern const babbler_cmd_t CMD_PING;
 extern const babbler_man_t MAN_PING;
+#ifdef BABBLER_TRACE
+/** Показать журнал выполненных команд */
+extern const babbler_cmd_t CMD_TRACE;
+extern const babbler_man_t MAN_TRACE;
+#endif // BABBLER_TRACE
 
 /**************************************/
 // Обработчики команд
@@ -28,5 +33,12 @@ int cmd_help(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NU
  */
 int cmd_ping(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL);
 
+#ifdef BABBLER_TRACE
+/** 
+ * Показать журнал выполненных команд.
+ */
+int cmd_trace(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL);
+#endif // BABBLER_TRACE
+
 #endif // BABBLER_CMD_CORE_H
 
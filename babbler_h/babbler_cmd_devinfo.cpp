@@ -1,7 +1,9 @@
 #include "babbler_cmd_devinfo.h"
 #include "babbler.h"
+#include "babbler_io.h"
 
 #include"string.h"
+#include"stdlib.h"
 
 // Значения свойств устройства (следует определить в главной программе)
 extern const char* DEVICE_NAME;
@@ -13,150 +15,391 @@ extern const char* DEVICE_MANUFACTURER;
 extern const char* DEVICE_URI;
 
 
+static const char _name_name[] BABBLER_FLASH = "name";
 extern const babbler_cmd_t CMD_NAME = {
-    "name",
-    &cmd_name
+    _name_name,
+    &cmd_name,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
-extern const babbler_man_t MAN_NAME = {
-    "name",
-    "get device name", 
+static const char _descr_name[] BABBLER_FLASH = "get device name";
+static const char _man_name[] BABBLER_FLASH = 
     "SYNOPSIS" 
     "    name" 
     "DESCRIPTION" 
-    "Get device name."
+    "Get device name.";
+extern const babbler_man_t MAN_NAME = {
+    _name_name,
+    _descr_name,
+    _man_name
 };
 
+static const char _name_model[] BABBLER_FLASH = "model";
 extern const babbler_cmd_t CMD_MODEL = {
-    "model",
-    &cmd_model
+    _name_model,
+    &cmd_model,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
-extern const babbler_man_t MAN_MODEL = {
-    "model",
-    "get device model",
+static const char _descr_model[] BABBLER_FLASH = "get device model";
+static const char _man_model[] BABBLER_FLASH = 
     "SYNOPSIS" 
     "    model" 
     "DESCRIPTION" 
-    "Get device model."
+    "Get device model.";
+extern const babbler_man_t MAN_MODEL = {
+    _name_model,
+    _descr_model,
+    _man_model
 };
 
+static const char _name_serial_number[] BABBLER_FLASH = "serial_number";
 extern const babbler_cmd_t CMD_SERIAL_NUMBER = {
-    "serial_number",
-    &cmd_serial_number
+    _name_serial_number,
+    &cmd_serial_number,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
-extern const babbler_man_t MAN_SERIAL_NUMBER = {
-    "serial_number",
-    "get device serial number",
+static const char _descr_serial_number[] BABBLER_FLASH = "get device serial number";
+static const char _man_serial_number[] BABBLER_FLASH = 
     "SYNOPSIS" 
     "    serial_number" 
     "DESCRIPTION" 
-    "Get device serial number."
+    "Get device serial number.";
+extern const babbler_man_t MAN_SERIAL_NUMBER = {
+    _name_serial_number,
+    _descr_serial_number,
+    _man_serial_number
 };
 
+static const char _name_description[] BABBLER_FLASH = "description";
 extern const babbler_cmd_t CMD_DESCRIPTION = {
-    "description",
-    &cmd_description
+    _name_description,
+    &cmd_description,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
-extern const babbler_man_t MAN_DESCRIPTION = {
-    "description", 
-    "get device description",
+static const char _descr_description[] BABBLER_FLASH = "get device description";
+static const char _man_description[] BABBLER_FLASH = 
     "SYNOPSIS" 
     "    description" 
     "DESCRIPTION" 
-    "Get device description"
+    "Get device description";
+extern const babbler_man_t MAN_DESCRIPTION = {
+    _name_description,
+    _descr_description,
+    _man_description
 };
 
+static const char _name_version[] BABBLER_FLASH = "version";
 extern const babbler_cmd_t CMD_VERSION = {
-    "version",
-    &cmd_version
+    _name_version,
+    &cmd_version,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
-extern const babbler_man_t MAN_VERSION = {
-    "version",
-    "get device version",
+static const char _descr_version[] BABBLER_FLASH = "get device version";
+static const char _man_version[] BABBLER_FLASH = 
     "SYNOPSIS" 
     "    version" 
     "DESCRIPTION" 
-    "Get device version."
+    "Get device version.";
+extern const babbler_man_t MAN_VERSION = {
+    _name_version,
+    _descr_version,
+    _man_version
 };
 
+static const char _name_manufacturer[] BABBLER_FLASH = "manufacturer";
 extern const babbler_cmd_t CMD_MANUFACTURER = {
-    "manufacturer",
-    &cmd_manufacturer
+    _name_manufacturer,
+    &cmd_manufacturer,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
-extern const babbler_man_t MAN_MANUFACTURER = {
-    "manufacturer",
-    "get device manufacturer",
+static const char _descr_manufacturer[] BABBLER_FLASH = "get device manufacturer";
+static const char _man_manufacturer[] BABBLER_FLASH = 
     "SYNOPSIS" 
     "    manufacturer" 
     "DESCRIPTION" 
-    "Get device manufacturer."
+    "Get device manufacturer.";
+extern const babbler_man_t MAN_MANUFACTURER = {
+    _name_manufacturer,
+    _descr_manufacturer,
+    _man_manufacturer
 };
 
+static const char _name_uri[] BABBLER_FLASH = "uri";
 extern const babbler_cmd_t CMD_URI = {
-    "uri",
-    &cmd_uri
+    _name_uri,
+    &cmd_uri,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE
 };
-extern const babbler_man_t MAN_URI = {
-    "uri",
-    "get device uri",
+static const char _descr_uri[] BABBLER_FLASH = "get device uri";
+static const char _man_uri[] BABBLER_FLASH = 
     "SYNOPSIS" 
     "    uri" 
     "DESCRIPTION" 
-    "Get device uri."
+    "Get device uri.";
+extern const babbler_man_t MAN_URI = {
+    _name_uri,
+    _descr_uri,
+    _man_uri
+};
+
+static const char _name_devinfo[] BABBLER_FLASH = "devinfo";
+extern const babbler_cmd_t CMD_DEVINFO = {
+    _name_devinfo,
+    &cmd_devinfo,
+    BABBLER_CMD_READONLY | BABBLER_CMD_PURE | BABBLER_CMD_REPLY_JSON
 };
+static const char _descr_devinfo[] BABBLER_FLASH = "get all device info in one reply";
+static const char _man_devinfo[] BABBLER_FLASH = 
+    "SYNOPSIS\n"
+    "    devinfo\n"
+    "    devinfo --json\n"
+    "DESCRIPTION\n"
+    "Get name, model, serial_number, description, version, manufacturer "
+    "and uri in one reply: key=value pairs separated by ';' or "
+    "JSON object with --json.\n"
+    "OPTIONS\n"
+    "    --json - reply with JSON object";
+extern const babbler_man_t MAN_DEVINFO = {
+    _name_devinfo,
+    _descr_devinfo,
+    _man_devinfo
+};
+
+// поля devinfo (в порядке значений в _devinfo_value)
+#define DEVINFO_NAME 0
+#define DEVINFO_MODEL 1
+#define DEVINFO_SERIAL_NUMBER 2
+#define DEVINFO_DESCRIPTION 3
+#define DEVINFO_VERSION 4
+#define DEVINFO_MANUFACTURER 5
+#define DEVINFO_URI 6
+// количество полей devinfo
+#define DEVINFO_FIELDS 7
+
+// Длины значений свойств и готовые ответы devinfo (см babbler_devinfo_setup);
+// после setup только читаются - обработчики могут выполняться параллельно
+static bool _devinfo_ready = false;
+static int _devinfo_len[DEVINFO_FIELDS];
+static char* _devinfo_text = NULL;
+static int _devinfo_text_len = 0;
+static char* _devinfo_json = NULL;
+static int _devinfo_json_len = 0;
+
+// имена полей devinfo подряд через '\0' (в порядке значений в _devinfo_value)
+static const char _devinfo_keys[] BABBLER_FLASH = 
+    "name\0model\0serial_number\0description\0version\0manufacturer\0uri";
+
+/**
+ * Значение свойства устройства field (DEVINFO_*).
+ */
+static const char* _devinfo_value(int field) {
+    const char* values[DEVINFO_FIELDS] = {
+        DEVICE_NAME, DEVICE_MODEL, DEVICE_SERIAL_NUMBER, DEVICE_DESCRIPTION,
+        DEVICE_VERSION, DEVICE_MANUFACTURER, DEVICE_URI
+    };
+    return values[field];
+}
+
+/**
+ * Записать символ в dst (если dst не NULL), увеличить len.
+ */
+static inline void _devinfo_put(char* dst, int* len, char c) {
+    if(dst != NULL) {
+        dst[*len] = c;
+    }
+    (*len)++;
+}
+
+/**
+ * Записать ответ devinfo в dst или только посчитать его длину.
+ *
+ * @param dst - буфер для ответа или NULL (только посчитать длину)
+ * @param json - true: объект JSON, false: пары key=value через ';'
+ * @return длина ответа без завершающего нуля
+ */
+static int _devinfo_write(char* dst, bool json) {
+    int len = 0;
+    const char* key = _devinfo_keys;
+    if(json) {
+        _devinfo_put(dst, &len, '{');
+    }
+    for(int i = 0; i < DEVINFO_FIELDS; i++) {
+        if(i > 0) {
+            _devinfo_put(dst, &len, json ? ',' : ';');
+        }
+        if(json) {
+            _devinfo_put(dst, &len, '"');
+        }
+        char c;
+        while((c = BABBLER_READ_BYTE_FLASH(key++)) != 0) {
+            _devinfo_put(dst, &len, c);
+        }
+        if(json) {
+            _devinfo_put(dst, &len, '"');
+            _devinfo_put(dst, &len, ':');
+            _devinfo_put(dst, &len, '"');
+        } else {
+            _devinfo_put(dst, &len, '=');
+        }
+        
+        for(const char* v = _devinfo_value(i); *v != 0; v++) {
+            if(json && (*v == '"' || *v == '\\')) {
+                _devinfo_put(dst, &len, '\\');
+                _devinfo_put(dst, &len, *v);
+            } else if(json && (unsigned char)*v < 0x20) {
+                // управляющие символы в строке JSON - \u00XX
+                static const char hex[] = "0123456789abcdef";
+                _devinfo_put(dst, &len, '\\');
+                _devinfo_put(dst, &len, 'u');
+                _devinfo_put(dst, &len, '0');
+                _devinfo_put(dst, &len, '0');
+                _devinfo_put(dst, &len, hex[(*v >> 4) & 0xF]);
+                _devinfo_put(dst, &len, hex[*v & 0xF]);
+            } else {
+                _devinfo_put(dst, &len, *v);
+            }
+        }
+        if(json) {
+            _devinfo_put(dst, &len, '"');
+        }
+    }
+    if(json) {
+        _devinfo_put(dst, &len, '}');
+    }
+    if(dst != NULL) {
+        dst[len] = 0;
+    }
+    return len;
+}
+
+/**
+ * Подготовить ответы команд, см babbler_devinfo_setup.
+ */
+int babbler_devinfo_setup() {
+    for(int i = 0; i < DEVINFO_FIELDS; i++) {
+        _devinfo_len[i] = strlen(_devinfo_value(i));
+    }
+    _devinfo_ready = true;
+    
+    free(_devinfo_text);
+    free(_devinfo_json);
+    _devinfo_text_len = _devinfo_write(NULL, false);
+    _devinfo_json_len = _devinfo_write(NULL, true);
+    _devinfo_text = (char*)malloc(_devinfo_text_len + 1);
+    _devinfo_json = (char*)malloc(_devinfo_json_len + 1);
+    if(_devinfo_text == NULL || _devinfo_json == NULL) {
+        // ответ devinfo будет собираться при каждом вызове
+        free(_devinfo_text);
+        free(_devinfo_json);
+        _devinfo_text = NULL;
+        _devinfo_json = NULL;
+        return -1;
+    }
+    _devinfo_write(_devinfo_text, false);
+    _devinfo_write(_devinfo_json, true);
+    return 0;
+}
+
+/**
+ * Скопировать готовый ответ длиной len (без завершающего нуля) в буфер ответа.
+ *
+ * @return длина ответа или REPLY_BUF_ERROR, если ответ не помещается в буфер
+ */
+static int _devinfo_copy(char* reply_buffer, int reply_buf_size, const char* reply, int len) {
+    if(len >= reply_buf_size) {
+        return REPLY_BUF_ERROR;
+    }
+    
+    // вместе с завершающим нулем
+    memcpy(reply_buffer, reply, len + 1);
+    return len;
+}
+
+/**
+ * Скопировать значение свойства устройства в буфер ответа.
+ *
+ * @param field - свойство (DEVINFO_*)
+ * @return длина ответа или REPLY_BUF_ERROR, если значение не помещается в буфер
+ */
+static int _devinfo_reply(char* reply_buffer, int reply_buf_size, int field) {
+    const char* value = _devinfo_value(field);
+    int value_len = _devinfo_ready ? _devinfo_len[field] : strlen(value);
+    return _devinfo_copy(reply_buffer, reply_buf_size, value, value_len);
+}
 
 /** 
  * Получить собственное имя устройства.
  */
 int cmd_name(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
-    strcpy(reply_buffer, DEVICE_NAME);
-    return strlen(reply_buffer);
+    return _devinfo_reply(reply_buffer, reply_buf_size, DEVINFO_NAME);
 }
 
 /** 
  * Получить модель устройства.
  */
 int cmd_model(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
-    strcpy(reply_buffer, DEVICE_MODEL);
-    return strlen(reply_buffer);
+    return _devinfo_reply(reply_buffer, reply_buf_size, DEVINFO_MODEL);
 }
 
 /** 
  * Получить серийный номер устройства.
  */
 int cmd_serial_number(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
-    strcpy(reply_buffer, DEVICE_SERIAL_NUMBER);
-    return strlen(reply_buffer);
+    return _devinfo_reply(reply_buffer, reply_buf_size, DEVINFO_SERIAL_NUMBER);
 }
 
 /** 
  * Получить словесное описание устройства. 
  */
 int cmd_description(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
-    strcpy(reply_buffer, DEVICE_DESCRIPTION);
-    return strlen(reply_buffer);
+    return _devinfo_reply(reply_buffer, reply_buf_size, DEVINFO_DESCRIPTION);
 }
 
 /** 
  * Получить версию прошивки устройства.
  */
 int cmd_version(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
-    strcpy(reply_buffer, DEVICE_VERSION);
-    return strlen(reply_buffer);
+    return _devinfo_reply(reply_buffer, reply_buf_size, DEVINFO_VERSION);
 }
 
 /** 
  * Получить производителя устройства.
  */
 int cmd_manufacturer(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
-    strcpy(reply_buffer, DEVICE_MANUFACTURER);
-    return strlen(reply_buffer);
+    return _devinfo_reply(reply_buffer, reply_buf_size, DEVINFO_MANUFACTURER);
 }
 
 /** 
  * Получить ссылку на страницу устройства.
  */
 int cmd_uri(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
-    strcpy(reply_buffer, DEVICE_URI);
-    return strlen(reply_buffer);
+    return _devinfo_reply(reply_buffer, reply_buf_size, DEVINFO_URI);
 }
 
+/** 
+ * Получить все свойства устройства одним ответом.
+ */
+int cmd_devinfo(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    bool json = false;
+    if(argc == 2 && strcmp(argv[1], "--json") == 0) {
+        json = true;
+    } else if(argc > 1) {
+        strcpy(reply_buffer, REPLY_BAD_PARAMS);
+        return strlen(reply_buffer);
+    }
+    
+    // готовый ответ из babbler_devinfo_setup
+    if(_devinfo_text != NULL) {
+        return json ?
+            _devinfo_copy(reply_buffer, reply_buf_size, _devinfo_json, _devinfo_json_len) :
+            _devinfo_copy(reply_buffer, reply_buf_size, _devinfo_text, _devinfo_text_len);
+    }
+    
+    // без него - сначала только длина ответа: проверить, поместится ли 
+    // он в буфер (без статических переменных - READONLY-команды 
+    // babbler_posix выполняются в нескольких потоках одновременно)
+    if(_devinfo_write(NULL, json) >= reply_buf_size) {
+        return REPLY_BUF_ERROR;
+    }
+    
+    return _devinfo_write(reply_buffer, json);
+}
@@ -28,10 +28,28 @@ extern const babbler_man_t MAN_MANUFACTURER;
 /** Получить ссылку на страницу устройства */
 extern const babbler_cmd_t CMD_URI;
 extern const babbler_man_t MAN_URI;
+/** Получить все свойства устройства одним ответом */
+extern const babbler_cmd_t CMD_DEVINFO;
+extern const babbler_man_t MAN_DEVINFO;
 
 
+/**
+ * Подготовить ответы команд: длины значений свойств DEVICE_* и оба 
+ * варианта ответа devinfo (key=value и JSON) в динамической памяти. 
+ * Вызывать один раз в setup, после того как заданы значения DEVICE_*, 
+ * до запуска рабочих потоков (babbler_posix_set_workers) - 
+ * обработчики потом только читают готовые значения.
+ * 
+ * Без вызова (или если не хватило памяти) обработчики считают длины 
+ * и собирают ответ devinfo при каждом вызове.
+ * 
+ * @return 0 - ответы готовы, -1 - не хватило памяти под ответы devinfo
+ */
+int babbler_devinfo_setup();
+
 /**************************************/
 // Обработчики команд
+// (если значение свойства не помещается в буфер ответа, возвращают REPLY_BUF_ERROR)
 
 /** 
  * Получить собственное имя устройства.
@@ -68,5 +86,14 @@ int cmd_manufacturer(char* reply_buffer, int reply_buf_size, int argc=0, char *a
  */
 int cmd_uri(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL);
 
+/** 
+ * Получить все свойства устройства одним ответом: пары key=value 
+ * через ';' (name=...;model=...;...;uri=...) или объект JSON 
+ * с параметром --json (у CMD_DEVINFO флаг BABBLER_CMD_REPLY_JSON: 
+ * в формате JSON объект попадает в поле reply без кавычек). 
+ * Если ответ не помещается в буфер, возвращает REPLY_BUF_ERROR.
+ */
+int cmd_devinfo(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL);
+
 #endif // BABBLER_CMD_DEVINFO_H
 
@@ -0,0 +1,216 @@
+#include "babbler_cobs.h"
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_io.h"
+
+#include "string.h"
+
+// тип контрольной суммы для обработчиков handle_input_*_cobs
+static int _crc_mode = BABBLER_CRC16;
+
+/**
+ * Тип контрольной суммы для обработчиков handle_input_simple_cobs
+ * и handle_input_json_cobs (по умолчанию BABBLER_CRC16).
+ * @param crc_mode - BABBLER_CRC_NONE, BABBLER_CRC16 или BABBLER_CRC32
+ */
+void babbler_cobs_set_crc(int crc_mode) {
+    _crc_mode = crc_mode;
+}
+
+/**
+ * Текущий тип контрольной суммы для обработчиков handle_input_*_cobs.
+ */
+int babbler_cobs_get_crc() {
+    return _crc_mode;
+}
+
+/**
+ * Фильтр пакетов COBS: пакет заканчивается нулевым байтом.
+ * См {module:babbler_io.h~packet_filter}
+ * @param input - входные данные
+ * @param input_len - длина данных в буфере
+ * @return 
+ *     true - буфер содержит пакет (последний байт буфера - ноль)
+ *     false - содержимое буфера не является пакетом
+ */
+bool packet_filter_cobs(char* input, int input_len) {
+    return input_len > 0 && input[input_len-1] == 0;
+}
+
+/**
+ * "Распаковать" пакет COBS в буфере: раскодировать содержимое на месте, 
+ * проверить и срезать контрольную сумму, добавить завершающий ноль после 
+ * данных (сами данные при этом могут содержать нули).
+ * @param input - буфер с входными данными
+ * @param input_len - длина пакета в буфере (вместе с завершающим нулем)
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return длина раскодированных данных или -1, если пакет поврежден 
+ *     (некорректная кодировка или не совпала контрольная сумма)
+ */
+int unpack_input_cobs(char* input, int input_len, int crc_mode) {
+    // срежем завершающий ноль
+    if(input_len > 0 && input[input_len-1] == 0) {
+        input_len--;
+    }
+    
+    // раскодированные данные короче закодированных, поэтому 
+    // можно писать в тот же буфер: позиция записи никогда 
+    // не обгоняет позицию чтения
+    int read_pos = 0;
+    int write_pos = 0;
+    while(read_pos < input_len) {
+        uint8_t code = (uint8_t)input[read_pos++];
+        if(code == 0) {
+            // нулей внутри пакета быть не должно
+            return -1;
+        }
+        
+        for(int i = 1; i < code; i++) {
+            if(read_pos >= input_len || input[read_pos] == 0) {
+                // блок обрывается раньше времени
+                return -1;
+            }
+            input[write_pos++] = input[read_pos++];
+        }
+        
+        // блок короче максимального заканчивается нулем 
+        // (кроме последнего блока)
+        if(code < 0xFF && read_pos < input_len) {
+            input[write_pos++] = 0;
+        }
+    }
+    
+    if(write_pos < crc_mode || !babbler_crc_check(input, write_pos, crc_mode)) {
+        return -1;
+    }
+    
+    int data_len = write_pos - crc_mode;
+    input[data_len] = 0;
+    return data_len;
+}
+
+/**
+ * "Упаковать" ответ в пакет COBS для отправки: дописать контрольную сумму, 
+ * закодировать на месте, добавить завершающий ноль.
+ * Реального размера буфера reply_buf_size должно хватить, чтобы вместить 
+ * все дополнительные байты (reply_len+COBS_OVERHEAD(reply_len, crc_mode)).
+ * @param reply_buffer - буфер с ответом
+ * @param reply_len - длина ответа в буфере
+ * @param reply_buf_size - размер буфера с ответом
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return новая длина ответа в буфере или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int pack_reply_cobs(char* reply_buffer, int reply_len, int reply_buf_size, int crc_mode) {
+    if(reply_len <= 0) {
+        return reply_len;
+    }
+    
+    if(reply_len + COBS_OVERHEAD(reply_len, crc_mode) > reply_buf_size) {
+        // В буфере не достаточно места, чтобы сформировать полностью корректный ответ
+        return REPLY_BUF_ERROR;
+    }
+    
+    int data_len = babbler_crc_append(reply_buffer, reply_len, crc_mode);
+    
+    // сдвинем данные вправо на количество служебных байт COBS, 
+    // тогда кодировать можно в тот же буфер с начала: позиция записи 
+    // никогда не обгоняет позицию чтения
+    int shift = data_len / 254 + 1;
+    memmove(reply_buffer + shift, reply_buffer, data_len);
+    
+    char* src = reply_buffer + shift;
+    char* src_end = src + data_len;
+    int code_pos = 0;
+    int write_pos = 1;
+    uint8_t code = 1;
+    while(src < src_end) {
+        if(*src == 0) {
+            // ноль заканчивает текущий блок
+            reply_buffer[code_pos] = code;
+            code_pos = write_pos++;
+            code = 1;
+        } else {
+            reply_buffer[write_pos++] = *src;
+            code++;
+            if(code == 0xFF) {
+                // блок максимальной длины (254 байта без нулей)
+                reply_buffer[code_pos] = code;
+                code_pos = write_pos++;
+                code = 1;
+            }
+        }
+        src++;
+    }
+    reply_buffer[code_pos] = code;
+    
+    // завершающий ноль - признак окончания пакета
+    reply_buffer[write_pos++] = 0;
+    
+    return write_pos;
+}
+
+/**
+ * Обработать входные данные в пакете COBS: распаковать пакет, 
+ * выполнить команду с параметрами, разделенными пробелами 
+ * (см handle_command_simple), упаковать ответ в пакет COBS.
+ * Поврежденные пакеты отбрасываются без ответа.
+ * См {module:babbler_io.h~input_handler}
+ * @param input_buffer - входные данные, пакет COBS
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_simple_cobs(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size) {
+    // "распакуем" пакет: раскодируем, проверим контрольную сумму, 
+    // добавим завершающий ноль
+    // "unpack" package: decode, check crc, add terminating zero
+    if(unpack_input_cobs(input_buffer, input_len, _crc_mode) < 0) {
+        // пакет поврежден - не отвечаем
+        // corrupted packet - no reply
+        return 0;
+    }
+    
+    // выполняем команду (оставим место для контрольной суммы и служебных байт COBS)
+    // execute command (leave space for checksum and COBS overhead)
+    int cmd_buf_size = reply_buf_size - COBS_OVERHEAD(reply_buf_size, _crc_mode);
+    int reply_len = handle_command_simple(input_buffer, reply_buffer, cmd_buf_size);
+    
+    // проверить на ошибку
+    // check for error
+    if(reply_len < 0) {
+        reply_len = write_reply_error(reply_buffer, reply_len, cmd_buf_size);
+    }
+    
+    // "упаковать" пакет для отправки
+    // "pack" reply to send
+    reply_len = pack_reply_cobs(reply_buffer, reply_len, reply_buf_size, _crc_mode);
+    
+    return reply_len;
+}
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_simple_cobs: текст ошибки 
+ * (см write_reply_error) в пакете COBS.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_simple_cobs(int error_code, char* reply_buffer, int reply_buf_size) {
+    int cmd_buf_size = reply_buf_size - COBS_OVERHEAD(reply_buf_size, _crc_mode);
+    int reply_len = write_reply_error(reply_buffer, error_code, cmd_buf_size);
+    return pack_reply_cobs(reply_buffer, reply_len, reply_buf_size, _crc_mode);
+}
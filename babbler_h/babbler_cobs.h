@@ -0,0 +1,120 @@
+#ifndef BABBLER_COBS_H
+#define BABBLER_COBS_H
+
+#include "babbler_crc.h"
+
+// Пакеты в кодировке COBS (Consistent Overhead Byte Stuffing): 
+// содержимое пакета кодируется так, что в нем не остается нулевых байт, 
+// нулевой байт - признак окончания пакета. Позволяет передавать двоичные 
+// данные, после помех на линии прием восстанавливается на первом же 
+// нулевом байте. В конец содержимого (до кодирования) может быть 
+// дописана контрольная сумма CRC-16 или CRC-32 (см babbler_crc.h), 
+// пакеты с неверной контрольной суммой отбрасываются.
+//
+// Пакет на линии: COBS(данные [CRC]) 0x00
+
+/**
+ * Максимальное количество дополнительных байт, которые добавляет 
+ * кодирование COBS с контрольной суммой к данным размером len байт:
+ * контрольная сумма, служебные байты COBS и завершающий ноль.
+ */
+#define COBS_OVERHEAD(len, crc_mode) ((crc_mode) + ((len) + (crc_mode)) / 254 + 2)
+
+/**
+ * Тип контрольной суммы для обработчиков handle_input_simple_cobs
+ * и handle_input_json_cobs (по умолчанию BABBLER_CRC16).
+ * @param crc_mode - BABBLER_CRC_NONE, BABBLER_CRC16 или BABBLER_CRC32
+ */
+void babbler_cobs_set_crc(int crc_mode);
+
+/**
+ * Текущий тип контрольной суммы для обработчиков handle_input_*_cobs.
+ */
+int babbler_cobs_get_crc();
+
+/**
+ * Фильтр пакетов COBS: пакет заканчивается нулевым байтом.
+ * См {module:babbler_io.h~packet_filter}
+ * @param input - входные данные
+ * @param input_len - длина данных в буфере
+ * @return 
+ *     true - буфер содержит пакет (последний байт буфера - ноль)
+ *     false - содержимое буфера не является пакетом
+ */
+bool packet_filter_cobs(char* input, int input_len);
+
+/**
+ * "Распаковать" пакет COBS в буфере: раскодировать содержимое на месте, 
+ * проверить и срезать контрольную сумму, добавить завершающий ноль после 
+ * данных (сами данные при этом могут содержать нули).
+ * @param input - буфер с входными данными
+ * @param input_len - длина пакета в буфере (вместе с завершающим нулем)
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return длина раскодированных данных или -1, если пакет поврежден 
+ *     (некорректная кодировка или не совпала контрольная сумма)
+ */
+int unpack_input_cobs(char* input, int input_len, int crc_mode);
+
+/**
+ * "Упаковать" ответ в пакет COBS для отправки: дописать контрольную сумму, 
+ * закодировать на месте, добавить завершающий ноль.
+ * Реального размера буфера reply_buf_size должно хватить, чтобы вместить 
+ * все дополнительные байты (reply_len+COBS_OVERHEAD(reply_len, crc_mode)).
+ * @param reply_buffer - буфер с ответом
+ * @param reply_len - длина ответа в буфере
+ * @param reply_buf_size - размер буфера с ответом
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return новая длина ответа в буфере или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int pack_reply_cobs(char* reply_buffer, int reply_len, int reply_buf_size, int crc_mode);
+
+/**
+ * Обработать входные данные в пакете COBS: распаковать пакет, 
+ * выполнить команду с параметрами, разделенными пробелами 
+ * (см handle_command_simple), упаковать ответ в пакет COBS.
+ * Поврежденные пакеты отбрасываются без ответа.
+ * См {module:babbler_io.h~input_handler}
+ * @param input_buffer - входные данные, пакет COBS
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+/**
+ * Handle input data in COBS packet: unpack packet, run command with
+ * space-separated parameters (see handle_command_simple), pack reply
+ * into COBS packet. Corrupted packets are dropped with no reply.
+ * @param input_buffer - input data, COBS packet
+ * @param input_len - input data length
+ * @param reply_buffer - reply buffer
+ * @param reply_buf_size - size of reply_buffer buffer - maximum length of reply.
+ * @return length of reply in bytes or error code
+ *     >0, <=reply_buf_size: number of bytes, written to reply_buffer
+ *     0: don't send reply
+ *    -1: error while constructing reply (not enought space in reply_buffer)
+ */
+int handle_input_simple_cobs(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_simple_cobs: текст ошибки 
+ * (см write_reply_error) в пакете COBS.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_simple_cobs(int error_code, char* reply_buffer, int reply_buf_size);
+
+#endif // BABBLER_COBS_H
+
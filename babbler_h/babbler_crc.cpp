@@ -0,0 +1,108 @@
+#include "babbler_crc.h"
+
+// Таблицы для расчета контрольных сумм по 4 бита за шаг: 
+// 16 значений вместо 256 - на AVR константы лежат в оперативной 
+// памяти, полные таблицы заняли бы 1.5Кб.
+
+static const uint16_t _crc16_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+static const uint32_t _crc32_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+/**
+ * Посчитать контрольную сумму CRC-16/CCITT-FALSE 
+ * (полином 0x1021, начальное значение 0xFFFF, без отражения).
+ * @param data - данные
+ * @param len - размер данных в байтах
+ * @return значение контрольной суммы
+ */
+uint16_t babbler_crc16(const char* data, int len) {
+    uint16_t crc = 0xFFFF;
+    for(int i = 0; i < len; i++) {
+        uint8_t b = (uint8_t)data[i];
+        // старшие 4 бита, потом младшие
+        crc = (crc << 4) ^ _crc16_table[(crc >> 12) ^ (b >> 4)];
+        crc = (crc << 4) ^ _crc16_table[(crc >> 12) ^ (b & 0x0F)];
+    }
+    return crc;
+}
+
+/**
+ * Посчитать контрольную сумму CRC-32 (IEEE 802.3, как в zlib: 
+ * отраженный полином 0xEDB88320, начальное значение 0xFFFFFFFF, 
+ * финальное xor 0xFFFFFFFF).
+ * @param data - данные
+ * @param len - размер данных в байтах
+ * @return значение контрольной суммы
+ */
+uint32_t babbler_crc32(const char* data, int len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for(int i = 0; i < len; i++) {
+        crc ^= (uint8_t)data[i];
+        // отраженный вариант: сначала младшие 4 бита, потом старшие
+        crc = (crc >> 4) ^ _crc32_table[crc & 0x0F];
+        crc = (crc >> 4) ^ _crc32_table[crc & 0x0F];
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * Посчитать контрольную сумму указанного типа.
+ */
+static uint32_t _crc(const char* data, int len, int crc_mode) {
+    if(crc_mode == BABBLER_CRC16) {
+        return babbler_crc16(data, len);
+    } else if(crc_mode == BABBLER_CRC32) {
+        return babbler_crc32(data, len);
+    } else {
+        return 0;
+    }
+}
+
+/**
+ * Посчитать контрольную сумму и дописать ее в конец данных 
+ * (старший байт первым).
+ * Реального размера буфера должно хватить, чтобы вместить 
+ * len+crc_mode байт.
+ * @param data - данные
+ * @param len - размер данных в байтах
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return новый размер данных (len+crc_mode)
+ */
+int babbler_crc_append(char* data, int len, int crc_mode) {
+    uint32_t crc = _crc(data, len, crc_mode);
+    for(int i = crc_mode - 1; i >= 0; i--) {
+        data[len + i] = (char)(crc & 0xFF);
+        crc >>= 8;
+    }
+    return len + crc_mode;
+}
+
+/**
+ * Проверить контрольную сумму в конце данных (старший байт первым).
+ * @param data - данные вместе с контрольной суммой в конце
+ * @param len - размер данных вместе с контрольной суммой
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return 
+ *     true - контрольная сумма совпадает
+ *     false - контрольная сумма не совпадает или данные короче контрольной суммы
+ */
+bool babbler_crc_check(const char* data, int len, int crc_mode) {
+    if(len < crc_mode) {
+        return false;
+    }
+    
+    uint32_t crc = _crc(data, len - crc_mode, crc_mode);
+    uint32_t expected = 0;
+    for(int i = len - crc_mode; i < len; i++) {
+        expected = (expected << 8) | (uint8_t)data[i];
+    }
+    return crc == expected;
+}
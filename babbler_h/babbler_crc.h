@@ -0,0 +1,59 @@
+#ifndef BABBLER_CRC_H
+#define BABBLER_CRC_H
+
+#include "stdint.h"
+
+// Контрольные суммы для проверки целостности пакетов
+// (см babbler_cobs.h)
+
+/** Без контрольной суммы */
+#define BABBLER_CRC_NONE 0
+/** CRC-16/CCITT-FALSE, 2 байта */
+#define BABBLER_CRC16 2
+/** CRC-32 (IEEE 802.3, как в zlib), 4 байта */
+#define BABBLER_CRC32 4
+
+/**
+ * Посчитать контрольную сумму CRC-16/CCITT-FALSE 
+ * (полином 0x1021, начальное значение 0xFFFF, без отражения).
+ * @param data - данные
+ * @param len - размер данных в байтах
+ * @return значение контрольной суммы
+ */
+uint16_t babbler_crc16(const char* data, int len);
+
+/**
+ * Посчитать контрольную сумму CRC-32 (IEEE 802.3, как в zlib: 
+ * отраженный полином 0xEDB88320, начальное значение 0xFFFFFFFF, 
+ * финальное xor 0xFFFFFFFF).
+ * @param data - данные
+ * @param len - размер данных в байтах
+ * @return значение контрольной суммы
+ */
+uint32_t babbler_crc32(const char* data, int len);
+
+/**
+ * Посчитать контрольную сумму и дописать ее в конец данных 
+ * (старший байт первым).
+ * Реального размера буфера должно хватить, чтобы вместить 
+ * len+crc_mode байт.
+ * @param data - данные
+ * @param len - размер данных в байтах
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return новый размер данных (len+crc_mode)
+ */
+int babbler_crc_append(char* data, int len, int crc_mode);
+
+/**
+ * Проверить контрольную сумму в конце данных (старший байт первым).
+ * @param data - данные вместе с контрольной суммой в конце
+ * @param len - размер данных вместе с контрольной суммой
+ * @param crc_mode - тип контрольной суммы: BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32
+ * @return 
+ *     true - контрольная сумма совпадает
+ *     false - контрольная сумма не совпадает или данные короче контрольной суммы
+ */
+bool babbler_crc_check(const char* data, int len, int crc_mode);
+
+#endif // BABBLER_CRC_H
+
@@ -0,0 +1,250 @@
+#include "babbler_footprint.h"
+
+#ifdef BABBLER_FOOTPRINT
+
+#include "stdint.h"
+#include "stdio.h"
+#include "string.h"
+
+#ifdef __AVR__
+#include <avr/io.h>
+
+// границы кучи avr-libc
+extern char __heap_start;
+extern char* __brkval;
+#endif
+
+// метка, которой размечаем неиспользованный стек
+#define STACK_PAINT 0xA5
+
+#if defined(__unix__) || defined(__APPLE__)
+    // память могут выделять команды в нескольких потоках (babbler_posix)
+    #define HEAP_ADD(ptr, val) __atomic_add_fetch(ptr, val, __ATOMIC_RELAXED)
+#else
+    // на контроллере команды выполняются только из loop
+    #define HEAP_ADD(ptr, val) (*(ptr) += (val))
+#endif
+
+static const char _name_footprint[] BABBLER_FLASH = "footprint";
+extern const babbler_cmd_t CMD_FOOTPRINT = {
+    _name_footprint,
+    &cmd_footprint,
+    BABBLER_CMD_READONLY
+};
+
+static const char _descr_footprint[] BABBLER_FLASH = "show stack and heap used per request";
+static const char _man_footprint[] BABBLER_FLASH = 
+    "SYNOPSIS\n"
+    "    footprint\n"
+    "    footprint reset\n"
+    "DESCRIPTION\n"
+    "Show stack depth and heap peak of the previous request and maximum "
+    "values since reset, and free RAM between heap and stack (AVR only). "
+    "Stack depth marked with '>' did not fit into painted area, "
+    "actual value is bigger.\n"
+    "OPTIONS\n"
+    "    reset - reset statistics";
+extern const babbler_man_t MAN_FOOTPRINT = {
+    _name_footprint,
+    _descr_footprint,
+    _man_footprint
+};
+
+static babbler_footprint_t _footprint;
+
+/** Стек на момент начала замера */
+static uint8_t* _stack_top;
+/** Размеченная область стека */
+static uint8_t* _paint_low;
+static uint8_t* _paint_high;
+
+/** Динамическая память: занято сейчас, пик, занято на момент начала замера */
+static long _heap_in_use;
+static long _heap_peak;
+static long _heap_begin;
+
+#ifdef __AVR__
+/** Максимальная граница кучи за запрос: куча растет в размеченную область */
+static uint8_t* _heap_end_max;
+
+static uint8_t* _heap_end() {
+    return (uint8_t*)(__brkval == 0 ? &__heap_start : __brkval);
+}
+#else
+/**
+ * Разметить стек под текущим вызовом: массив в кадре функции
+ * займет ту же память, что и кадры обработчика после возврата.
+ */
+static void __attribute__((noinline)) _paint_stack() {
+    volatile uint8_t area[BABBLER_FOOTPRINT_STACK_PAINT];
+    for(int i = 0; i < BABBLER_FOOTPRINT_STACK_PAINT; i++) {
+        area[i] = STACK_PAINT;
+    }
+    _paint_low = (uint8_t*)(uintptr_t)area;
+    _paint_high = _paint_low + BABBLER_FOOTPRINT_STACK_PAINT;
+}
+#endif // __AVR__
+
+/**
+ * Начать замер: разметить стек под текущим вызовом, запомнить
+ * занятую динамическую память.
+ */
+void babbler_footprint_begin() {
+    _heap_begin = _heap_in_use;
+    _heap_peak = _heap_in_use;
+
+#ifdef __AVR__
+    // размечаем свободную память от вершины стека вниз, но не ниже кучи
+    uint8_t* sp = (uint8_t*)SP;
+    uint8_t* heap_end = _heap_end();
+    _stack_top = sp;
+    _paint_high = sp;
+    _paint_low = (uintptr_t)(sp - heap_end) > BABBLER_FOOTPRINT_STACK_PAINT ?
+        sp - BABBLER_FOOTPRINT_STACK_PAINT : heap_end;
+    _heap_end_max = heap_end;
+    for(volatile uint8_t* p = _paint_low; p < _paint_high; p++) {
+        *p = STACK_PAINT;
+    }
+#else
+    _stack_top = (uint8_t*)__builtin_frame_address(0);
+    _paint_stack();
+#endif // __AVR__
+}
+
+/**
+ * Закончить замер: найти самый глубокий затертый байт стека,
+ * обновить статистику.
+ */
+void babbler_footprint_end() {
+    volatile uint8_t* p = _paint_low;
+#ifdef __AVR__
+    // память, которую заняла куча, - не стек
+    if(_heap_end_max > p) {
+        p = _heap_end_max;
+    }
+#endif // __AVR__
+    volatile uint8_t* scan_start = p;
+    while(p < _paint_high && *p == STACK_PAINT) {
+        p++;
+    }
+    
+    _footprint.requests++;
+    _footprint.stack_last = p < _stack_top ? _stack_top - (uint8_t*)p : 0;
+    if(_footprint.stack_last > _footprint.stack_max) {
+        _footprint.stack_max = _footprint.stack_last;
+    }
+    if(p == scan_start) {
+        _footprint.stack_overflow = true;
+    }
+    
+    _footprint.heap_last = _heap_peak - _heap_begin;
+    if(_footprint.heap_last > _footprint.heap_max) {
+        _footprint.heap_max = _footprint.heap_last;
+    }
+}
+
+/**
+ * Статистика расхода памяти.
+ */
+const babbler_footprint_t* babbler_footprint_stats() {
+    return &_footprint;
+}
+
+/**
+ * Сбросить статистику.
+ */
+void babbler_footprint_reset() {
+    memset(&_footprint, 0, sizeof(_footprint));
+}
+
+/**
+ * Свободная память между кучей и стеком, байт
+ * (только AVR, на остальных платформах -1).
+ */
+int babbler_footprint_free_ram() {
+#ifdef __AVR__
+    return (uint8_t*)SP - _heap_end();
+#else
+    return -1;
+#endif // __AVR__
+}
+
+/**
+ * Обновить пик занятой динамической памяти значением in_use.
+ */
+static void _heap_peak_update(long in_use) {
+#if defined(__unix__) || defined(__APPLE__)
+    long peak = __atomic_load_n(&_heap_peak, __ATOMIC_RELAXED);
+    while(in_use > peak && !__atomic_compare_exchange_n(&_heap_peak, &peak, in_use,
+            true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // другой поток успел обновить пик - peak перечитан, сравниваем снова
+    }
+#else
+    if(in_use > _heap_peak) {
+        _heap_peak = in_use;
+    }
+#endif
+}
+
+/**
+ * Выделить память с учетом в статистике: перед блоком
+ * храним его размер для babbler_footprint_free.
+ */
+void* babbler_footprint_malloc(size_t size) {
+    size_t* block = (size_t*)malloc(sizeof(size_t) + size);
+    if(block == NULL) {
+        return NULL;
+    }
+    *block = size;
+    
+    _heap_peak_update(HEAP_ADD(&_heap_in_use, (long)size));
+#ifdef __AVR__
+    if(_heap_end() > _heap_end_max) {
+        _heap_end_max = _heap_end();
+    }
+#endif // __AVR__
+    return block + 1;
+}
+
+/**
+ * Освободить память, выделенную babbler_footprint_malloc.
+ */
+void babbler_footprint_free(void* ptr) {
+    if(ptr == NULL) {
+        return;
+    }
+    size_t* block = (size_t*)ptr - 1;
+    HEAP_ADD(&_heap_in_use, -(long)*block);
+    free(block);
+}
+
+/**
+ * Показать расход памяти на обработку запросов.
+ */
+int cmd_footprint(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    if(argc == 2 && strcmp("reset", argv[1]) == 0) {
+        babbler_footprint_reset();
+        strcpy(reply_buffer, REPLY_OK);
+        return strlen(reply_buffer);
+    } else if(argc > 1) {
+        strcpy(reply_buffer, REPLY_BAD_PARAMS);
+        return strlen(reply_buffer);
+    }
+    
+    // статистика на момент вызова - без текущего запроса
+    int len = snprintf(reply_buffer, reply_buf_size,
+        "requests: %lu, stack: %d (max %s%d), heap: %ld (max %ld)",
+        _footprint.requests, _footprint.stack_last,
+        _footprint.stack_overflow ? ">" : "", _footprint.stack_max,
+        _footprint.heap_last, _footprint.heap_max);
+    if(len >= 0 && len < reply_buf_size && babbler_footprint_free_ram() >= 0) {
+        len += snprintf(reply_buffer + len, reply_buf_size - len,
+            ", free: %d", babbler_footprint_free_ram());
+    }
+    if(len < 0 || len >= reply_buf_size) {
+        return -1;
+    }
+    return len;
+}
+
+#endif // BABBLER_FOOTPRINT
@@ -0,0 +1,105 @@
+#ifndef BABBLER_FOOTPRINT_H
+#define BABBLER_FOOTPRINT_H
+
+#include "babbler_lib_config.h"
+#include "babbler.h"
+
+#include "stdlib.h"
+
+// Замер расхода памяти на обработку запроса (включается BABBLER_FOOTPRINT
+// в babbler_lib_config.h): глубина стека за вызов обработчика входных данных
+// (заполнение стека меткой и поиск самого глубокого затертого байта - так же
+// на устройстве и в сборке для Linux) и пик динамической памяти за запрос
+// (память, которую библиотека берет через BABBLER_MALLOC: разбор JSON,
+// параметры команды). Статический расход памяти и флеша по модулям
+// показывает babbler_host/footprint/footprint_report.py.
+//
+// Per-request memory footprint (enabled by BABBLER_FOOTPRINT): stack
+// high-water per input handler call (stack painting, same on the device
+// and on the host) and heap high-water per request (allocations made by
+// the library through BABBLER_MALLOC). Per-module static RAM/flash sizes
+// are reported by babbler_host/footprint/footprint_report.py.
+
+#ifdef BABBLER_FOOTPRINT
+
+/**
+ * Расход памяти на обработку запросов.
+ */
+typedef struct {
+    /** Количество замеренных запросов */
+    unsigned long requests;
+    /** Глубина стека за последний запрос, байт */
+    int stack_last;
+    /** Максимальная глубина стека, байт */
+    int stack_max;
+    /**
+     * Стек вышел за размеченную область (BABBLER_FOOTPRINT_STACK_PAINT):
+     * реальная глубина больше stack_max
+     */
+    bool stack_overflow;
+    /** Пик динамической памяти за последний запрос, байт */
+    long heap_last;
+    /** Максимальный пик динамической памяти за запрос, байт */
+    long heap_max;
+} babbler_footprint_t;
+
+/**
+ * Начать замер: разметить стек под текущим вызовом, запомнить
+ * занятую динамическую память. Вызывать непосредственно перед
+ * вызовом обработчика входных данных.
+ */
+void babbler_footprint_begin();
+
+/**
+ * Закончить замер: найти самый глубокий затертый байт стека,
+ * обновить статистику. Вызывать из той же функции, что и
+ * babbler_footprint_begin, сразу после вызова обработчика.
+ */
+void babbler_footprint_end();
+
+/**
+ * Статистика расхода памяти.
+ */
+const babbler_footprint_t* babbler_footprint_stats();
+
+/**
+ * Сбросить статистику.
+ */
+void babbler_footprint_reset();
+
+/**
+ * Свободная память между кучей и стеком, байт
+ * (только AVR, на остальных платформах -1).
+ */
+int babbler_footprint_free_ram();
+
+/**
+ * Выделить память с учетом в статистике (см BABBLER_MALLOC).
+ */
+void* babbler_footprint_malloc(size_t size);
+
+/**
+ * Освободить память, выделенную babbler_footprint_malloc.
+ */
+void babbler_footprint_free(void* ptr);
+
+#define BABBLER_MALLOC(size) babbler_footprint_malloc(size)
+#define BABBLER_FREE(ptr) babbler_footprint_free(ptr)
+
+/** Показать расход памяти на обработку запросов */
+extern const babbler_cmd_t CMD_FOOTPRINT;
+extern const babbler_man_t MAN_FOOTPRINT;
+
+/**
+ * Показать расход памяти на обработку запросов.
+ */
+int cmd_footprint(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL);
+
+#else
+
+#define BABBLER_MALLOC(size) malloc(size)
+#define BABBLER_FREE(ptr) free(ptr)
+
+#endif // BABBLER_FOOTPRINT
+
+#endif // BABBLER_FOOTPRINT_H
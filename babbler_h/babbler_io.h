@@ -6,6 +6,25 @@
 
 #define REPLY_BUF_ERROR -1
 
+/**
+ * Входной пакет не поместился в буфер чтения модуля ввода-вывода: 
+ * пакет отброшен целиком, не выполнялся.
+ */
+#define INPUT_OVERFLOW_ERROR -2
+
+/**
+ * Модуль ввода-вывода перегружен (очередь входных пакетов заполнена 
+ * выше допустимого уровня): пакет отброшен, не выполнялся, 
+ * клиенту следует повторить запрос позднее.
+ */
+#define INPUT_BUSY_ERROR -3
+
+/**
+ * Команда отложила ответ (см babbler_async.h): ответ будет сформирован 
+ * и отправлен позднее, сейчас ничего не отправлять.
+ */
+#define REPLY_DEFERRED -4
+
 /**
  * Фильтр пакетов. Определяет, является ли содержимое буфера пакетом.
  * @param input - входные данные
@@ -16,6 +35,34 @@
  */
 typedef bool (*packet_filter)(char* input, int input_len);
 
+/**
+ * Размер пакета. Определяет полный размер пакета по его началу
+ * (например, по заголовку с длиной), чтобы модуль ввода-вывода мог 
+ * дочитать пакет целиком одним блоком и заранее проверить, 
+ * поместится ли пакет в буфер.
+ * @param input - входные данные (начало пакета)
+ * @param input_len - размер данных в буфере
+ * @return 
+ *     >0 - полный размер пакета в байтах (long: на AVR размер
+ *         из заголовка может не поместиться в int)
+ *     -1 - размер пакета пока нельзя определить (например, 
+ *         заголовок принят не полностью)
+ */
+/**
+ * Packet size. Find out full packet size by it's beginning
+ * (e.g. by header with length), so that I/O module could read 
+ * the rest of the packet with one block and check in advance if
+ * the packet fits into the buffer.
+ * @param input - input data (packet beginning)
+ * @param input_len - data length in buffer
+ * @return 
+ *     >0 - full packet size in bytes (long: a size from the header
+ *         may not fit int on AVR)
+ *     -1 - packet size can not be found out yet (e.g. header 
+ *         is not received completely)
+ */
+typedef long (*packet_size_hint)(char* input, int input_len);
+
 /**
  * Обработать входные данные: разобрать строку, выполнить одну или 
  * несколько команд, записать ответ.
@@ -46,5 +93,30 @@ typedef bool (*packet_filter)(char* input, int input_len);
  */
 typedef int (*input_handler)(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size);
 
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * (например, INPUT_OVERFLOW_ERROR), упакованный в тот же формат, 
+ * что и ответы соответствующего обработчика input_handler.
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+/**
+ * Write reply with input error message (e.g. INPUT_OVERFLOW_ERROR),
+ * packed into the same format as the replies of corresponding input_handler.
+ * @param error_code - error code < 0
+ * @param reply_buffer - reply buffer
+ * @param reply_buf_size - size of reply_buffer buffer - maximum length of reply.
+ * @return length of reply in bytes or error code
+ *     >0, <=reply_buf_size: number of bytes, written to reply_buffer
+ *     0: don't send reply
+ *    -1: error while constructing reply (not enought space in reply_buffer)
+ */
+typedef int (*input_error_handler)(int error_code, char* reply_buffer, int reply_buf_size);
+
 #endif // BABBLER_IO_H
 
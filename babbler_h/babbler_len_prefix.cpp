@@ -0,0 +1,154 @@
+#include "babbler_len_prefix.h"
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_io.h"
+
+#include "string.h"
+
+/**
+ * Длина данных из заголовка пакета.
+ */
+static unsigned int _payload_len(char* input) {
+    // в unsigned int: на AVR int 16 бит, длина от 0x8000 стала бы отрицательной
+    return ((unsigned int)(unsigned char)input[0] << 8) | (unsigned char)input[1];
+}
+
+/**
+ * Фильтр пакетов с длиной в заголовке.
+ * См {module:babbler_io.h~packet_filter}
+ * @param input - входные данные
+ * @param input_len - длина данных в буфере
+ * @return 
+ *     true - буфер содержит пакет (принят заголовок и указанное в нем 
+ *         количество байт данных)
+ *     false - содержимое буфера не является пакетом
+ */
+bool packet_filter_len_prefix(char* input, int input_len) {
+    return input_len == packet_size_len_prefix(input, input_len);
+}
+
+/**
+ * Полный размер пакета по заголовку.
+ * См {module:babbler_io.h~packet_size_hint}
+ * @param input - входные данные (начало пакета)
+ * @param input_len - размер данных в буфере
+ * @return полный размер пакета вместе с заголовком или -1, 
+ *     если заголовок еще не принят
+ */
+long packet_size_len_prefix(char* input, int input_len) {
+    if(input_len < LEN_PREFIX_HEADER_SIZE) {
+        return -1;
+    }
+    return LEN_PREFIX_HEADER_SIZE + (long)_payload_len(input);
+}
+
+/**
+ * "Распаковать" пакет в буфере: срезать заголовок (данные сдвигаются 
+ * в начало буфера), добавить завершающий ноль после данных.
+ * @param input - буфер с входными данными
+ * @param input_len - длина пакета в буфере вместе с заголовком
+ * @return длина данных или -1, если длина в заголовке не совпадает 
+ *     с размером пакета
+ */
+int unpack_input_len_prefix(char* input, int input_len) {
+    if(input_len < LEN_PREFIX_HEADER_SIZE || !packet_filter_len_prefix(input, input_len)) {
+        return -1;
+    }
+    
+    int data_len = input_len - LEN_PREFIX_HEADER_SIZE;
+    memmove(input, input + LEN_PREFIX_HEADER_SIZE, data_len);
+    input[data_len] = 0;
+    return data_len;
+}
+
+/**
+ * "Упаковать" ответ в пакет для отправки: добавить заголовок с длиной 
+ * (данные сдвигаются вправо на размер заголовка).
+ * Реального размера буфера reply_buf_size должно хватить, чтобы вместить 
+ * заголовок (reply_len+LEN_PREFIX_HEADER_SIZE).
+ * @param reply_buffer - буфер с ответом
+ * @param reply_len - длина ответа в буфере
+ * @param reply_buf_size - размер буфера с ответом
+ * @return новая длина ответа в буфере или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int pack_reply_len_prefix(char* reply_buffer, int reply_len, int reply_buf_size) {
+    if(reply_len <= 0) {
+        return reply_len;
+    }
+    
+    // в long: на AVR reply_len + LEN_PREFIX_HEADER_SIZE может переполнить int
+    if((long)reply_len + LEN_PREFIX_HEADER_SIZE > reply_buf_size || (long)reply_len > 0xFFFFL) {
+        // В буфере не достаточно места, чтобы сформировать полностью корректный ответ
+        return REPLY_BUF_ERROR;
+    }
+    
+    memmove(reply_buffer + LEN_PREFIX_HEADER_SIZE, reply_buffer, reply_len);
+    reply_buffer[0] = (char)((reply_len >> 8) & 0xFF);
+    reply_buffer[1] = (char)(reply_len & 0xFF);
+    
+    return reply_len + LEN_PREFIX_HEADER_SIZE;
+}
+
+/**
+ * Обработать входные данные в пакете с длиной в заголовке: распаковать пакет, 
+ * выполнить команду с параметрами, разделенными пробелами 
+ * (см handle_command_simple), упаковать ответ в пакет с длиной.
+ * См {module:babbler_io.h~input_handler}
+ * @param input_buffer - входные данные, пакет с длиной в заголовке
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_simple_len_prefix(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size) {
+    // "распакуем" пакет: срежем заголовок, добавим завершающий ноль
+    // "unpack" package: cut header, add terminating zero
+    if(unpack_input_len_prefix(input_buffer, input_len) < 0) {
+        // длина не совпадает (например, пакет обрезан) - не отвечаем
+        // length mismatch (e.g. truncated packet) - no reply
+        return 0;
+    }
+    
+    // выполняем команду (оставим место для заголовка)
+    // execute command (leave space for header)
+    int cmd_buf_size = reply_buf_size - LEN_PREFIX_HEADER_SIZE;
+    int reply_len = handle_command_simple(input_buffer, reply_buffer, cmd_buf_size);
+    
+    // проверить на ошибку
+    // check for error
+    if(reply_len < 0) {
+        reply_len = write_reply_error(reply_buffer, reply_len, cmd_buf_size);
+    }
+    
+    // "упаковать" пакет для отправки - добавить заголовок
+    // "pack" reply to send - add header
+    reply_len = pack_reply_len_prefix(reply_buffer, reply_len, reply_buf_size);
+    
+    return reply_len;
+}
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_simple_len_prefix: текст ошибки 
+ * (см write_reply_error) в пакете с длиной.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_simple_len_prefix(int error_code, char* reply_buffer, int reply_buf_size) {
+    int cmd_buf_size = reply_buf_size - LEN_PREFIX_HEADER_SIZE;
+    int reply_len = write_reply_error(reply_buffer, error_code, cmd_buf_size);
+    return pack_reply_len_prefix(reply_buffer, reply_len, reply_buf_size);
+}
@@ -0,0 +1,106 @@
+#ifndef BABBLER_LEN_PREFIX_H
+#define BABBLER_LEN_PREFIX_H
+
+// Пакеты с длиной в заголовке: 2 байта - длина данных (старший байт 
+// первым), за ними сами данные. Приемник заранее знает, сколько байт 
+// ждать, поэтому пакет определяется за O(1) (без поиска разделителя), 
+// а данные можно дочитать одним блоком (см {module:babbler_io.h~packet_size_hint}).
+//
+// Пакет на линии: LEN_HI LEN_LO данные[LEN]
+
+/** Размер заголовка пакета с длиной */
+#define LEN_PREFIX_HEADER_SIZE 2
+
+/**
+ * Фильтр пакетов с длиной в заголовке.
+ * См {module:babbler_io.h~packet_filter}
+ * @param input - входные данные
+ * @param input_len - длина данных в буфере
+ * @return 
+ *     true - буфер содержит пакет (принят заголовок и указанное в нем 
+ *         количество байт данных)
+ *     false - содержимое буфера не является пакетом
+ */
+bool packet_filter_len_prefix(char* input, int input_len);
+
+/**
+ * Полный размер пакета по заголовку.
+ * См {module:babbler_io.h~packet_size_hint}
+ * @param input - входные данные (начало пакета)
+ * @param input_len - размер данных в буфере
+ * @return полный размер пакета вместе с заголовком или -1, 
+ *     если заголовок еще не принят
+ */
+long packet_size_len_prefix(char* input, int input_len);
+
+/**
+ * "Распаковать" пакет в буфере: срезать заголовок (данные сдвигаются 
+ * в начало буфера), добавить завершающий ноль после данных.
+ * @param input - буфер с входными данными
+ * @param input_len - длина пакета в буфере вместе с заголовком
+ * @return длина данных или -1, если длина в заголовке не совпадает 
+ *     с размером пакета
+ */
+int unpack_input_len_prefix(char* input, int input_len);
+
+/**
+ * "Упаковать" ответ в пакет для отправки: добавить заголовок с длиной 
+ * (данные сдвигаются вправо на размер заголовка).
+ * Реального размера буфера reply_buf_size должно хватить, чтобы вместить 
+ * заголовок (reply_len+LEN_PREFIX_HEADER_SIZE).
+ * @param reply_buffer - буфер с ответом
+ * @param reply_len - длина ответа в буфере
+ * @param reply_buf_size - размер буфера с ответом
+ * @return новая длина ответа в буфере или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int pack_reply_len_prefix(char* reply_buffer, int reply_len, int reply_buf_size);
+
+/**
+ * Обработать входные данные в пакете с длиной в заголовке: распаковать пакет, 
+ * выполнить команду с параметрами, разделенными пробелами 
+ * (см handle_command_simple), упаковать ответ в пакет с длиной.
+ * См {module:babbler_io.h~input_handler}
+ * @param input_buffer - входные данные, пакет с длиной в заголовке
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+/**
+ * Handle input data in length-prefixed packet: unpack packet, run command with
+ * space-separated parameters (see handle_command_simple), pack reply
+ * into length-prefixed packet.
+ * @param input_buffer - input data, length-prefixed packet
+ * @param input_len - input data length
+ * @param reply_buffer - reply buffer
+ * @param reply_buf_size - size of reply_buffer buffer - maximum length of reply.
+ * @return length of reply in bytes or error code
+ *     >0, <=reply_buf_size: number of bytes, written to reply_buffer
+ *     0: don't send reply
+ *    -1: error while constructing reply (not enought space in reply_buffer)
+ */
+int handle_input_simple_len_prefix(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_simple_len_prefix: текст ошибки 
+ * (см write_reply_error) в пакете с длиной.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_simple_len_prefix(int error_code, char* reply_buffer, int reply_buf_size);
+
+#endif // BABBLER_LEN_PREFIX_H
+
@@ -5,3 +5,131 @@
 // enable serial port debug messages
 //#define DEBUG_SERIAL
 
+// максимальное количество пакетов в очереди приема модуля babbler_serial
+// (см babbler_serial_set_rx_queue)
+// maximum number of frames in babbler_serial receive queue
+// (see babbler_serial_set_rx_queue)
+#ifndef BABBLER_SERIAL_RX_QUEUE_MAX
+#define BABBLER_SERIAL_RX_QUEUE_MAX 4
+#endif
+
+// отправлять ответ в babbler_serial целиком за один вызов Serial.write
+// (блокирует loop до окончания отправки); по умолчанию ответ отправляется
+// порциями по Serial.availableForWrite() за вызов babbler_serial_tasks.
+// Включить, если реализация порта не поддерживает availableForWrite.
+// send babbler_serial reply with single Serial.write call
+// (blocks loop until reply is sent); by default reply is sent
+// by Serial.availableForWrite() sized chunks per babbler_serial_tasks call.
+// Enable if serial port implementation does not support availableForWrite.
+// Для отдельного канала - babbler_serial_port_set_blocking_write.
+// Per channel - babbler_serial_port_set_blocking_write.
+//#define BABBLER_SERIAL_BLOCKING_WRITE
+
+// через сколько миллисекунд ожидания места в буфере отправки канал
+// babbler_serial, поток которого ни разу не сообщил о свободном месте
+// (availableForWrite всегда 0, например SoftwareSerial), переходит
+// на блокирующую запись
+// after how many milliseconds of waiting for TX buffer space a babbler_serial
+// channel whose stream never reported free space (availableForWrite always 0,
+// e.g. SoftwareSerial) switches to blocking writes
+#ifndef BABBLER_SERIAL_WRITE_STALL_TIMEOUT
+#define BABBLER_SERIAL_WRITE_STALL_TIMEOUT 100
+#endif
+
+// через сколько миллисекунд снова вызвать babbler_serial_tasks, пока
+// выполняются отложенные команды (см babbler_serial_idle)
+// how soon to call babbler_serial_tasks again while deferred commands
+// are in flight, milliseconds (see babbler_serial_idle)
+#ifndef BABBLER_SERIAL_ASYNC_POLL_INTERVAL
+#define BABBLER_SERIAL_ASYNC_POLL_INTERVAL 1
+#endif
+
+// максимальное количество одновременно выполняющихся отложенных команд
+// (см babbler_async.h), остальным отвечаем REPLY_BUSY
+// maximum number of deferred commands in flight (see babbler_async.h),
+// others are answered with REPLY_BUSY
+#ifndef BABBLER_ASYNC_MAX_INFLIGHT
+#define BABBLER_ASYNC_MAX_INFLIGHT 4
+#endif
+
+// размер буферов для имени команды и идентификатора запроса
+// отложенной команды (с завершающим нулем)
+// deferred command name and request id buffer sizes (with terminating zero)
+#ifndef BABBLER_ASYNC_CMD_SIZE
+#define BABBLER_ASYNC_CMD_SIZE 16
+#endif
+#ifndef BABBLER_ASYNC_ID_SIZE
+#define BABBLER_ASYNC_ID_SIZE 16
+#endif
+
+// замерять расход стека и динамической памяти на обработку запроса
+// (см babbler_footprint.h, команда footprint)
+// measure stack and heap used per request
+// (see babbler_footprint.h, footprint command)
+//#define BABBLER_FOOTPRINT
+
+// сколько байт стека размечать для замера глубины стека (на AVR не больше
+// свободной памяти между кучей и стеком); если обработчик ушел глубже,
+// замер покажет нижнюю границу
+// how many stack bytes to paint for stack depth measurement (on AVR limited
+// by free memory between heap and stack); deeper handlers get a lower bound
+#ifndef BABBLER_FOOTPRINT_STACK_PAINT
+#ifdef __AVR__
+#define BABBLER_FOOTPRINT_STACK_PAINT 1024
+#else
+#define BABBLER_FOOTPRINT_STACK_PAINT 8192
+#endif
+#endif
+
+// вести журнал выполненных команд: команда, количество параметров,
+// результат, время начала и длительность (см babbler_set_trace_clock,
+// команда trace)
+// record executed commands: command, argument count, result,
+// start time and duration (see babbler_set_trace_clock, trace command)
+//#define BABBLER_TRACE
+
+// количество записей в журнале команд, степень двойки
+// (на AVR запись занимает 16 байт RAM)
+// command trace depth, power of two (an entry takes 16 bytes RAM on AVR)
+#ifndef BABBLER_TRACE_DEPTH
+#define BABBLER_TRACE_DEPTH 16
+#endif
+
+// хранить имена команд и руководства во флеше, а не в RAM (AVR: PROGMEM);
+// строки для собственных команд объявлять с BABBLER_FLASH (см babbler.h).
+// В сборке для Linux проверяется, что строки действительно объявлены так.
+// keep command names and manuals in flash instead of RAM (AVR: PROGMEM);
+// declare strings for own commands with BABBLER_FLASH (see babbler.h).
+// The Linux build checks that the strings are really declared so.
+//#define BABBLER_PROGMEM
+
+// хранить руководства команд сжатыми общим словарем, команда help
+// распаковывает их сразу в буфер ответа (см babbler_manpack.h,
+// babbler_host/manpack/babbler_manpack.py)
+// keep command manuals packed with a shared dictionary, help unpacks
+// them straight into the reply buffer (see babbler_manpack.h,
+// babbler_host/manpack/babbler_manpack.py)
+//#define BABBLER_PACKED_MANUALS
+
+// кэшировать готовые ответы на запросы из команд BABBLER_CMD_PURE
+// (см babbler_reply_cache.h)
+// cache final replies to requests of BABBLER_CMD_PURE commands
+// (see babbler_reply_cache.h)
+//#define BABBLER_REPLY_CACHE
+
+// байт под запросы и ответы в кэше, количество записей
+// и максимальная длина запроса для кэша
+// cache bytes for requests and replies, entry count and max request length
+#ifndef BABBLER_REPLY_CACHE_SIZE
+#ifdef __AVR__
+#define BABBLER_REPLY_CACHE_SIZE 256
+#else
+#define BABBLER_REPLY_CACHE_SIZE 4096
+#endif
+#endif
+#ifndef BABBLER_REPLY_CACHE_ENTRIES
+#define BABBLER_REPLY_CACHE_ENTRIES 8
+#endif
+#ifndef BABBLER_REPLY_CACHE_KEY_SIZE
+#define BABBLER_REPLY_CACHE_KEY_SIZE 48
+#endif
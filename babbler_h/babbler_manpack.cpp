@@ -0,0 +1,52 @@
+#include "babbler_manpack.h"
+
+#ifdef BABBLER_PACKED_MANUALS
+
+// пустой словарь для прошивок без сжатых руководств (BABBLER_PACKED_MANUALS
+// включен в общем babbler_lib_config.h для всех скетчей), сгенерированный
+// заголовок его заменяет
+extern const uint16_t BABBLER_MAN_DICT_INDEX[] BABBLER_FLASH __attribute__((weak)) = {0};
+extern const char BABBLER_MAN_DICT[] BABBLER_FLASH __attribute__((weak)) = "";
+
+bool babbler_man_is_packed(const char* manual) {
+    return manual != NULL && BABBLER_READ_BYTE_FLASH(manual) == BABBLER_MAN_PACKED;
+}
+
+int babbler_man_unpack(char* dst, int dst_size, const char* packed) {
+    if(dst_size <= 0) {
+        return -1;
+    }
+    
+    int len = 0;
+    // пропускаем признак сжатой строки
+    const char* src = packed + 1;
+    unsigned char c;
+    while((c = BABBLER_READ_BYTE_FLASH(src++)) != 0) {
+        if(c == BABBLER_MAN_ESCAPE) {
+            c = BABBLER_READ_BYTE_FLASH(src++);
+        } else if(c >= BABBLER_MAN_DICT_FIRST) {
+            // строка словаря: копируем от ее смещения до смещения следующей
+            int word = c - BABBLER_MAN_DICT_FIRST;
+            unsigned int from = BABBLER_READ_WORD_FLASH(&BABBLER_MAN_DICT_INDEX[word]);
+            unsigned int to = BABBLER_READ_WORD_FLASH(&BABBLER_MAN_DICT_INDEX[word + 1]);
+            if(len + (int)(to - from) >= dst_size) {
+                dst[len] = 0;
+                return -1;
+            }
+            for(unsigned int i = from; i < to; i++) {
+                dst[len++] = BABBLER_READ_BYTE_FLASH(&BABBLER_MAN_DICT[i]);
+            }
+            continue;
+        }
+        
+        if(len + 1 >= dst_size) {
+            dst[len] = 0;
+            return -1;
+        }
+        dst[len++] = c;
+    }
+    dst[len] = 0;
+    return len;
+}
+
+#endif // BABBLER_PACKED_MANUALS
@@ -0,0 +1,73 @@
+#ifndef BABBLER_MANPACK_H
+#define BABBLER_MANPACK_H
+
+#include "babbler_lib_config.h"
+#include "babbler.h"
+
+#include "stdint.h"
+
+// Сжатые руководства команд (включается BABBLER_PACKED_MANUALS
+// в babbler_lib_config.h): тексты руководств хранятся во флеше сжатыми
+// общим статическим словарем частых подстрок, команда help распаковывает
+// текст сразу в буфер ответа (без промежуточного буфера-окна).
+// Заголовок с MAN_* и словарем генерирует
+// babbler_host/manpack/babbler_manpack.py из текстового файла руководств.
+// Руководства, записанные обычной строкой (например, MAN_HELP, MAN_PING),
+// работают как раньше.
+//
+// Compressed command manuals (BABBLER_PACKED_MANUALS): manual texts are
+// kept in flash packed with a shared static dictionary of frequent
+// substrings, help unpacks them straight into the reply buffer (no window
+// buffer). babbler_host/manpack/babbler_manpack.py generates the header
+// with MAN_* and the dictionary from a manuals text file. Plain string
+// manuals keep working.
+//
+// Формат сжатой строки / packed string format:
+//     BABBLER_MAN_PACKED - первый байт, признак сжатой строки
+//     0x01..0x7F         - символ как есть
+//     0x80..0xFE         - строка словаря с номером (байт - 0x80)
+//     0xFF               - следующий байт как есть (UTF-8, 0x01)
+//     0x00               - конец строки
+
+#ifdef BABBLER_PACKED_MANUALS
+
+/** Первый байт сжатого руководства */
+#define BABBLER_MAN_PACKED 0x01
+/** Код первой строки словаря */
+#define BABBLER_MAN_DICT_FIRST 0x80
+/** Следующий байт - символ как есть */
+#define BABBLER_MAN_ESCAPE 0xFF
+
+/**
+ * Смещения строк словаря в BABBLER_MAN_DICT, в конце - общая длина
+ * (определяет сгенерированный заголовок, во флеше).
+ */
+extern const uint16_t BABBLER_MAN_DICT_INDEX[];
+
+/**
+ * Строки словаря подряд без разделителей
+ * (определяет сгенерированный заголовок, во флеше).
+ */
+extern const char BABBLER_MAN_DICT[];
+
+/**
+ * Проверить, сжата ли строка руководства.
+ * @param manual - строка руководства (во флеше, если включен BABBLER_PROGMEM)
+ */
+bool babbler_man_is_packed(const char* manual);
+
+/**
+ * Распаковать сжатое руководство.
+ *
+ * @param dst - буфер для распакованного текста
+ * @param dst_size - размер буфера (вместе с завершающим нулем)
+ * @param packed - сжатое руководство (во флеше, если включен BABBLER_PROGMEM)
+ * @return длина распакованного текста без завершающего нуля
+ *     или -1, если текст не поместился в буфер
+ *     (в буфере - начало текста с завершающим нулем)
+ */
+int babbler_man_unpack(char* dst, int dst_size, const char* packed);
+
+#endif // BABBLER_PACKED_MANUALS
+
+#endif // BABBLER_MANPACK_H
@@ -0,0 +1,215 @@
+#include "babbler_reply_cache.h"
+
+#ifdef BABBLER_REPLY_CACHE
+
+#include "babbler_simple.h"
+
+#include "string.h"
+
+// в запросе выполнено несколько разных команд
+#define CMD_SEVERAL -2
+
+/**
+ * Запись кэша; ключ и ответ лежат в _data.
+ */
+typedef struct {
+    /** Обработчик входных данных, который упаковал ответ */
+    input_handler handle_input;
+    /** Индекс команды в BABBLER_COMMANDS или CMD_SEVERAL */
+    int cmd;
+    /** Длина ключа (запроса) */
+    int key_len;
+    /** Длина ответа */
+    int reply_len;
+} _entry_t;
+
+// записи от самой старой к самой новой
+static _entry_t _entries[BABBLER_REPLY_CACHE_ENTRIES];
+static int _entries_count = 0;
+// ключи и ответы записей подряд: ключ 0, ответ 0, ключ 1, ответ 1...
+static char _data[BABBLER_REPLY_CACHE_SIZE];
+static int _data_len = 0;
+
+// запрос из последнего babbler_reply_cache_lookup (_key_len == -1 -
+// сохранять нечего)
+static input_handler _handle_input = NULL;
+static char _key[BABBLER_REPLY_CACHE_KEY_SIZE];
+static int _key_len = -1;
+// команда, выполненная в запросе: -1 - ни одной, CMD_SEVERAL - несколько
+static int _key_cmd = -1;
+// в запросе выполнялись только команды BABBLER_CMD_PURE без ошибок
+static bool _key_pure = false;
+
+static unsigned long _hits = 0;
+
+/**
+ * Отметить выполненную команду для текущего запроса.
+ */
+static void _after_cmd(const babbler_cmd_t* cmd, int argc, char* argv[],
+        char* reply_buffer, int reply_buf_size, int* reply_len) {
+    if(_key_len == -1) {
+        // команда выполнена не между lookup и store
+        return;
+    }
+    
+    int i = cmd - BABBLER_COMMANDS;
+    if(!(cmd->flags & BABBLER_CMD_PURE) || *reply_len < 0) {
+        _key_pure = false;
+    } else if(_key_cmd == -1) {
+        _key_cmd = i;
+    } else if(_key_cmd != i) {
+        _key_cmd = CMD_SEVERAL;
+    }
+}
+
+static babbler_cmd_hook_t _hook = {NULL, &_after_cmd, NULL};
+static bool _hook_added = false;
+
+/**
+ * Ключ для запроса. Запрос handle_input_simple нормализуется так же, 
+ * как его разбирает handle_command_simple: без перевода строки в конце, 
+ * до первого нуля, без пробелов ' ' по краям, подряд идущие пробелы - 
+ * один пробел ("help  ping" и "help ping" - один ключ). Остальные 
+ * символы, в том числе табуляция, - как есть: handle_command_simple 
+ * делит параметры только по ' ' ("ping\t" - другая команда).
+ * Запросы других обработчиков копируются байт в байт (в JSON пробелы 
+ * внутри строк значимы, в пакетах COBS и с длиной - любой байт).
+ *
+ * @return длина ключа или -1, если ключ не поместился в key
+ */
+static int _make_key(input_handler handle_input, const char* input_buffer, int input_len,
+        char* key, int key_size) {
+    if(handle_input != handle_input_simple) {
+        if(input_len > key_size) {
+            return -1;
+        }
+        memcpy(key, input_buffer, input_len);
+        return input_len;
+    }
+    
+    if(input_len > 0 && input_buffer[input_len - 1] == '\n') {
+        input_len--;
+    }
+    int key_len = 0;
+    bool space = false;
+    for(int i = 0; i < input_len && input_buffer[i] != 0; i++) {
+        if(input_buffer[i] == ' ') {
+            // пробел в ключ - только перед следующим параметром
+            space = key_len > 0;
+            continue;
+        }
+        if(key_len + (space ? 2 : 1) > key_size) {
+            return -1;
+        }
+        if(space) {
+            key[key_len++] = ' ';
+            space = false;
+        }
+        key[key_len++] = input_buffer[i];
+    }
+    return key_len;
+}
+
+/**
+ * Убрать запись с индексом index.
+ */
+static void _remove(int index) {
+    int offset = 0;
+    for(int i = 0; i < index; i++) {
+        offset += _entries[i].key_len + _entries[i].reply_len;
+    }
+    int size = _entries[index].key_len + _entries[index].reply_len;
+    memmove(_data + offset, _data + offset + size, _data_len - offset - size);
+    _data_len -= size;
+    
+    for(int i = index; i < _entries_count - 1; i++) {
+        _entries[i] = _entries[i + 1];
+    }
+    _entries_count--;
+}
+
+int babbler_reply_cache_lookup(input_handler handle_input, const char* input_buffer, int input_len,
+        char* reply_buffer, int reply_buf_size) {
+    if(!_hook_added) {
+        babbler_add_cmd_hook(&_hook);
+        _hook_added = true;
+    }
+    
+    _key_len = _make_key(handle_input, input_buffer, input_len, _key, BABBLER_REPLY_CACHE_KEY_SIZE);
+    if(_key_len == -1) {
+        // длинный запрос - не кэшируем
+        return -1;
+    }
+    _handle_input = handle_input;
+    _key_cmd = -1;
+    _key_pure = true;
+    
+    int offset = 0;
+    for(int i = 0; i < _entries_count; i++) {
+        const _entry_t* entry = &_entries[i];
+        if(entry->handle_input == handle_input && entry->key_len == _key_len &&
+                memcmp(_data + offset, _key, _key_len) == 0) {
+            if(entry->reply_len > reply_buf_size) {
+                // ответ из кэша не помещается в этот буфер - выполнить
+                // запрос как обычно, но второй раз не сохранять
+                _key_len = -1;
+                return -1;
+            }
+            
+            memcpy(reply_buffer, _data + offset + entry->key_len, entry->reply_len);
+            _hits++;
+            _key_len = -1;
+            return entry->reply_len;
+        }
+        offset += entry->key_len + entry->reply_len;
+    }
+    return -1;
+}
+
+void babbler_reply_cache_store(const char* reply_buffer, int reply_len) {
+    int key_len = _key_len;
+    _key_len = -1;
+    if(key_len == -1 || !_key_pure || _key_cmd == -1 || reply_len <= 0 ||
+            key_len + reply_len > BABBLER_REPLY_CACHE_SIZE) {
+        return;
+    }
+    
+    // нет места - вытесняем самые старые записи
+    while(_entries_count == BABBLER_REPLY_CACHE_ENTRIES ||
+            _data_len + key_len + reply_len > BABBLER_REPLY_CACHE_SIZE) {
+        _remove(0);
+    }
+    
+    _entry_t* entry = &_entries[_entries_count++];
+    entry->handle_input = _handle_input;
+    entry->cmd = _key_cmd;
+    entry->key_len = key_len;
+    entry->reply_len = reply_len;
+    memcpy(_data + _data_len, _key, key_len);
+    memcpy(_data + _data_len + key_len, reply_buffer, reply_len);
+    _data_len += key_len + reply_len;
+}
+
+void babbler_reply_cache_invalidate(const char* cmd_name) {
+    if(cmd_name == NULL) {
+        _entries_count = 0;
+        _data_len = 0;
+        return;
+    }
+    
+    int cmd = babbler_find_cmd(cmd_name);
+    if(cmd == -1) {
+        return;
+    }
+    for(int i = _entries_count - 1; i >= 0; i--) {
+        if(_entries[i].cmd == cmd || _entries[i].cmd == CMD_SEVERAL) {
+            _remove(i);
+        }
+    }
+}
+
+unsigned long babbler_reply_cache_hits() {
+    return _hits;
+}
+
+#endif // BABBLER_REPLY_CACHE
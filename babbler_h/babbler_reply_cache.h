@@ -0,0 +1,72 @@
+#ifndef BABBLER_REPLY_CACHE_H
+#define BABBLER_REPLY_CACHE_H
+
+#include "babbler_lib_config.h"
+#include "babbler.h"
+#include "babbler_io.h"
+
+// Кэш ответов (включается BABBLER_REPLY_CACHE в babbler_lib_config.h):
+// готовые ответы (уже упакованные обработчиком входных данных) на запросы,
+// в которых выполнялись только команды BABBLER_CMD_PURE. Ключ - обработчик
+// входных данных и запрос: для handle_input_simple - как его разбирает
+// handle_command_simple (лишние пробелы ' ' не учитываются, табуляция -
+// часть параметра), для остальных обработчиков - байт в байт.
+// Повторный запрос получает ответ из кэша без разбора и выполнения команд
+// (и без обработчиков babbler_add_cmd_hook, журнала trace). Если ответ
+// команды BABBLER_CMD_PURE все-таки может измениться, после изменения
+// вызвать babbler_reply_cache_invalidate. Модуль babbler_serial использует
+// кэш сам; вызывать из одного потока.
+//
+// Reply cache (enabled by BABBLER_REPLY_CACHE): final (already packed by
+// the input handler) replies to requests that executed only
+// BABBLER_CMD_PURE commands, keyed by input handler and request. For
+// handle_input_simple the request is normalised the way
+// handle_command_simple parses it (runs of ' ' fold, tabs are kept); other
+// handlers use the exact request bytes.
+// A repeated request is served from the cache without parsing or running
+// commands (no cmd hooks, no trace). Call babbler_reply_cache_invalidate
+// when a BABBLER_CMD_PURE reply may change. babbler_serial uses the cache
+// by itself; single thread only.
+
+#ifdef BABBLER_REPLY_CACHE
+
+/**
+ * Найти ответ на запрос в кэше и скопировать в буфер ответа.
+ * Если ответа нет, запоминает запрос для babbler_reply_cache_store
+ * (вызывать до обработчика, пока он не изменил входные данные).
+ *
+ * @param handle_input - обработчик входных данных, который получит запрос
+ * @param input_buffer - запрос
+ * @param input_len - длина запроса
+ * @param reply_buffer - буфер ответа
+ * @param reply_buf_size - размер буфера ответа
+ * @return длина ответа из кэша или -1, если ответа в кэше нет
+ */
+int babbler_reply_cache_lookup(input_handler handle_input, const char* input_buffer, int input_len,
+        char* reply_buffer, int reply_buf_size);
+
+/**
+ * Сохранить ответ на запрос из последнего babbler_reply_cache_lookup,
+ * если в запросе выполнялись только команды BABBLER_CMD_PURE без ошибок.
+ * Вызывать сразу после обработчика входных данных.
+ *
+ * @param reply_buffer - ответ обработчика
+ * @param reply_len - длина ответа (результат обработчика)
+ */
+void babbler_reply_cache_store(const char* reply_buffer, int reply_len);
+
+/**
+ * Убрать из кэша ответы команды (и запросы из нескольких команд).
+ *
+ * @param cmd_name - имя команды, NULL - очистить кэш полностью
+ */
+void babbler_reply_cache_invalidate(const char* cmd_name);
+
+/**
+ * Количество ответов, отправленных из кэша.
+ */
+unsigned long babbler_reply_cache_hits();
+
+#endif // BABBLER_REPLY_CACHE
+
+#endif // BABBLER_REPLY_CACHE_H
@@ -67,6 +67,10 @@ int handle_command_simple(char* input_buffer, char* reply_buffer, int reply_buf_
         
         token = strtok_r(NULL, " ", &last);
     }
+    if(tokensNum == 0) {
+        // пустая строка - команды с пустым именем нет
+        tokens[0] = input_buffer;
+    }
     
     // выполнить команду
     int reply_len = handle_command(tokens[0], tokensNum, tokens, reply_buffer, reply_buf_size);
@@ -178,6 +182,12 @@ int write_reply_error(char* reply_buffer, int error_code, int reply_buf_size) {
         if(error_code == REPLY_BUF_ERROR) {
             strcpy(reply_buffer, REPLY_REPLY_BUF_ERROR);
             error_code = strlen(reply_buffer);
+        } else if(error_code == INPUT_OVERFLOW_ERROR) {
+            strcpy(reply_buffer, REPLY_INPUT_OVERFLOW);
+            error_code = strlen(reply_buffer);
+        } else if(error_code == INPUT_BUSY_ERROR) {
+            strcpy(reply_buffer, REPLY_BUSY);
+            error_code = strlen(reply_buffer);
         } else {
             sprintf(reply_buffer, "error: %d", error_code);
             error_code = strlen(reply_buffer);
@@ -241,3 +251,21 @@ int handle_input_simple(char* input_buffer, int input_len, char* reply_buffer, i
     return reply_len;
 }
 
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_simple: текст ошибки (см write_reply_error) 
+ * и перенос строки.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_simple(int error_code, char* reply_buffer, int reply_buf_size) {
+    int reply_len = write_reply_error(reply_buffer, error_code, reply_buf_size-2);
+    return pack_reply_newline(reply_buffer, reply_len, reply_buf_size);
+}
@@ -127,5 +127,20 @@ int write_reply_error(char* reply_buffer, int error_code, int reply_buf_size);
  */
 int handle_input_simple(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size);
 
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_simple: текст ошибки (см write_reply_error) 
+ * и перенос строки.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_simple(int error_code, char* reply_buffer, int reply_buf_size);
+
 #endif // BABBLER_SIMPLE_H
 
@@ -59,8 +59,10 @@ void setup() {
 }
 
 void loop() {
-    // постоянно следим за последовательным портом, ждем входные данные
-    // monitor serial port for input data
-    babbler_serial_tasks();
+    // постоянно следим за последовательным портом, ждем входные данные;
+    // пока данных нет, процессор спит (если в loop больше ничего не делаем)
+    // monitor serial port for input data;
+    // sleep while there is no input (if loop has nothing else to do)
+    babbler_serial_idle(babbler_serial_tasks());
 }
 
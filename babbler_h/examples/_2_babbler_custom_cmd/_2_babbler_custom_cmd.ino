@@ -59,7 +59,10 @@ babbler_cmd_t CMD_LEDON = {
     "ledon",
     /* указатель на функцию с реализацией команды */
     /* pointer to function with command implementation*/
-    &cmd_ledon
+    &cmd_ledon,
+    /* флаги команды (не обязательно): меняет состояние устройства */
+    /* command flags (optional): changes device state */
+    BABBLER_CMD_MUTATING
 };
 
 babbler_man_t MAN_LEDON = {
@@ -83,7 +86,10 @@ babbler_cmd_t CMD_LEDOFF = {
     "ledoff",
     /* указатель на функцию с реализацией команды */
     /* pointer to function with command implementation*/
-    &cmd_ledoff
+    &cmd_ledoff,
+    /* флаги команды (не обязательно): меняет состояние устройства */
+    /* command flags (optional): changes device state */
+    BABBLER_CMD_MUTATING
 };
 
 babbler_man_t MAN_LEDOFF = {
@@ -107,7 +113,10 @@ babbler_cmd_t CMD_LEDSTATUS = {
     "ledstatus",
     /* указатель на функцию с реализацией команды */
     /* pointer to function with command implementation*/
-    &cmd_ledstatus
+    &cmd_ledstatus,
+    /* флаги команды (не обязательно): только читает состояние устройства */
+    /* command flags (optional): only reads device state */
+    BABBLER_CMD_READONLY
 };
 
 babbler_man_t MAN_LEDSTATUS = {
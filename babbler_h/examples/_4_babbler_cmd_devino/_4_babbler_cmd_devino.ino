@@ -17,13 +17,13 @@ char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
 char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
 
 
-extern const char* DEVICE_NAME = "Babbler demo";
-extern const char* DEVICE_MODEL = "prototype1";
-extern const char* DEVICE_SERIAL_NUBMER = "00000003";
-extern const char* DEVICE_DESCRIPTION = "Communicative Arduino-based device powered by Babbler communication library";
-extern const char* DEVICE_VERSION = "0.1-devel";
-extern const char* DEVICE_MANUFACTURER = "Sad robot";
-extern const char* DEVICE_URI = "sadrobot.su";
+const char* DEVICE_NAME = "Babbler demo";
+const char* DEVICE_MODEL = "prototype1";
+const char* DEVICE_SERIAL_NUBMER = "00000003";
+const char* DEVICE_DESCRIPTION = "Communicative Arduino-based device powered by Babbler communication library";
+const char* DEVICE_VERSION = "0.1-devel";
+const char* DEVICE_MANUFACTURER = "Sad robot";
+const char* DEVICE_URI = "sadrobot.su";
 
 #define LED_PIN 13
 bool ledison = false;
@@ -150,6 +150,7 @@ extern const babbler_cmd_t BABBLER_COMMANDS[] = {
     CMD_VERSION,
     CMD_MANUFACTURER,
     CMD_URI,
+    CMD_DEVINFO,
     
     // пользовательские команды
     // custom commands
@@ -178,6 +179,7 @@ extern const babbler_man_t BABBLER_MANUALS[] = {
     MAN_VERSION,
     MAN_MANUFACTURER,
     MAN_URI,
+    MAN_DEVINFO,
     
     // пользовательские команды
     // custom commands
@@ -195,6 +197,10 @@ void setup() {
     Serial.begin(9600);
     Serial.println("Starting babbler-powered device, type help for list of commands");
     
+    // ответы команд devinfo - один раз, до первой команды
+    // build devinfo replies once, before the first command
+    babbler_devinfo_setup();
+    
     babbler_serial_set_packet_filter(packet_filter_newline);
     babbler_serial_set_input_handler(handle_input_simple);
     //babbler_serial_setup(
@@ -0,0 +1,164 @@
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_async.h"
+#include "babbler_serial.h"
+
+// Размеры буферов для чтения команд и записи ответов
+// Read and write buffer size for communication modules
+#define SERIAL_READ_BUFFER_SIZE 128
+#define SERIAL_WRITE_BUFFER_SIZE 512
+
+// Буферы для обмена данными с компьютером через последовательный порт.
+// +1 байт в конце для завершающего нуля
+// Data exchange buffers to communicate with computer via serial port.
+// +1 extra byte at the end for terminating zero
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+// второй буфер чтения: следующая команда принимается, пока выполняется текущая
+// second read buffer: next command is received while current one executes
+char serial_read_buffer2[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+#define SENSOR_PIN A0
+
+// Долгое измерение: копим отсчеты в течение заданного времени
+// Slow measurement: accumulate samples for given time
+unsigned long measure_end = 0;
+unsigned long measure_sum = 0;
+unsigned long measure_count = 0;
+
+/** Функция опроса команды measure: вызывается из babbler_serial_tasks */
+/** measure command poll function: called from babbler_serial_tasks */
+int poll_measure(char* reply_buffer, int reply_buf_size, void* ctx) {
+    measure_sum += analogRead(SENSOR_PIN);
+    measure_count++;
+    
+    if((long)(millis() - measure_end) < 0) {
+        // еще измеряем - ответ позже
+        // still measuring - reply later
+        return REPLY_DEFERRED;
+    }
+    
+    snprintf(reply_buffer, reply_buf_size, "%lu", measure_sum / measure_count);
+    return strlen(reply_buffer);
+}
+
+/**
+ * Реализация команды measure (среднее значение датчика за 1 секунду):
+ * команда не блокирует loop, пока она выполняется, устройство
+ * отвечает на другие команды.
+ */
+/**
+ * measure command implementation (average sensor value for 1 second):
+ * command does not block loop, device keeps answering other commands
+ * while it runs.
+ */
+int cmd_measure(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    if(babbler_async_inflight(NULL) > 0) {
+        // измерение уже идет
+        // measurement is already running
+        strcpy(reply_buffer, REPLY_BUSY);
+        return strlen(reply_buffer);
+    }
+    
+    measure_end = millis() + 1000;
+    measure_sum = 0;
+    measure_count = 0;
+    
+    // ответ отправит babbler_serial_tasks, когда poll_measure его сформирует
+    // babbler_serial_tasks will send reply when poll_measure produces it
+    return babbler_async_defer(&poll_measure, NULL, reply_buffer, reply_buf_size);
+}
+
+babbler_cmd_t CMD_MEASURE = {
+    /* имя команды */
+    /* command name */
+    "measure",
+    /* указатель на функцию с реализацией команды */
+    /* pointer to function with command implementation*/
+    &cmd_measure,
+    /* флаги команды (не обязательно): только читает состояние устройства */
+    /* command flags (optional): only reads device state */
+    BABBLER_CMD_READONLY
+};
+
+babbler_man_t MAN_MEASURE = {
+    /* имя команды */
+    /* command name */
+    "measure",
+    /* краткое описание */
+    /* short description */
+    "average sensor value for 1 second",
+    /* руководство */
+    /* manual */
+    "SYNOPSIS\n"
+    "    measure\n"
+    "DESCRIPTION\n"
+    "Average sensor value for 1 second. Reply is sent when measurement is done, "
+    "other commands are served meanwhile; use request id to match replies."
+};
+
+/** Зарегистрированные команды */
+/** Registered commands */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    CMD_HELP,
+    CMD_PING,
+    
+    // пользовательские команды
+    // custom commands
+    CMD_MEASURE
+};
+
+/** Количество зарегистрированных команд */
+/** Number of registered commands*/
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+
+/** Руководства для зарегистрированных команд */
+/** Manuals for registered commands */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    MAN_HELP,
+    MAN_PING,
+    
+    // пользовательские команды
+    // custom commands
+    MAN_MEASURE
+};
+
+/** Количество руководств для зарегистрированных команд */
+/** Number of manuals for registered commands */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+
+void setup() {
+    Serial.begin(9600);
+    Serial.println("Starting babbler-powered device with deferred commands,"
+        " type {\"cmd\": \"measure\", \"id\": \"1\"} and then {\"cmd\": \"ping\", \"id\": \"2\"}");
+    // ответ на ping придет раньше, чем на measure:
+    // ping reply comes before measure reply:
+    // {"cmd":"ping","id":"2","reply":"ok"}
+    // {"cmd":"measure","id":"1","reply":"512"}
+    
+    babbler_serial_set_packet_filter(packet_filter_newline);
+    babbler_serial_set_input_handler(handle_input_json);
+    babbler_serial_set_error_handler(handle_input_error_json);
+    babbler_serial_setup(
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE,
+        BABBLER_SERIAL_SKIP_PORT_INIT);
+    babbler_serial_set_double_buffer(serial_read_buffer2);
+}
+
+void loop() {
+    // постоянно следим за последовательным портом, ждем входные данные,
+    // опрашиваем отложенные команды; между вызовами процессор спит
+    // monitor serial port for input data, poll deferred commands;
+    // sleep between calls
+    babbler_serial_idle(babbler_serial_tasks());
+}
+
@@ -0,0 +1,191 @@
+// Сжатые руководства команд: тексты руководств во флеше сжаты общим
+// словарем, команда help распаковывает их сразу в буфер ответа.
+// Включить BABBLER_PACKED_MANUALS в babbler_lib_config.h (на AVR также
+// BABBLER_PROGMEM, чтобы руководства и словарь не копировались в RAM).
+// Руководства пишутся в manuals.man, manuals_packed.h с MAN_* и именами
+// команд NAME_* генерирует babbler_host/manpack/babbler_manpack.py:
+//
+//     python3 babbler_host/manpack/babbler_manpack.py \
+//         babbler_h/examples/babbler_manpack/manuals.man \
+//         -o babbler_h/examples/babbler_manpack/manuals_packed.h
+//
+// Packed command manuals: manual texts in flash are packed with a shared
+// dictionary, help unpacks them straight into the reply buffer.
+// Enable BABBLER_PACKED_MANUALS in babbler_lib_config.h (on AVR also
+// BABBLER_PROGMEM to keep manuals and dictionary out of RAM). Manuals are
+// written in manuals.man, babbler_host/manpack/babbler_manpack.py generates
+// manuals_packed.h with MAN_* and command names NAME_* (see command above).
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_cmd_core.h"
+#include "babbler_serial.h"
+
+// MAN_LEDON, MAN_LEDOFF, MAN_LEDSTATUS, MAN_BLINK, NAME_*
+#include "manuals_packed.h"
+
+// Размеры буферов для чтения команд и записи ответов
+// Read and write buffer size for communication modules
+#define SERIAL_READ_BUFFER_SIZE 128
+#define SERIAL_WRITE_BUFFER_SIZE 512
+
+// Буферы для обмена данными с компьютером через последовательный порт.
+// +1 байт в конце для завершающего нуля
+// Data exchange buffers to communicate with computer via serial port.
+// +1 extra byte at the end for terminating zero
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+
+#define LED_PIN 13
+bool ledison = false;
+
+/** Реализация команды ledon (включить лампочку) */
+/** ledon (turn led ON) command implementation */
+int cmd_ledon(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    digitalWrite(LED_PIN, HIGH);
+    ledison = true;
+    
+    // команда выполнена
+    strcpy(reply_buffer, REPLY_OK);
+    return strlen(reply_buffer);
+}
+
+/** Реализация команды ledoff (выключить лампочку) */
+/** ledoff (turn led OFF) command implementation */
+int cmd_ledoff(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    digitalWrite(LED_PIN, LOW);
+    ledison = false;
+    
+    // команда выполнена
+    strcpy(reply_buffer, REPLY_OK);
+    return strlen(reply_buffer);
+}
+
+/** Реализация команды ledstatus (cтатус лампочки) */
+/** ledstatus (get led status) command implementation */
+int cmd_ledstatus(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    if(ledison) {
+        strcpy(reply_buffer, "on");
+    } else {
+        strcpy(reply_buffer, "off");
+    }
+    
+    return strlen(reply_buffer);
+}
+
+/** Реализация команды blink (помигать лампочкой) */
+/** blink (blink led several times) command implementation */
+int cmd_blink(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    // ожидаемые параметры
+    // argv[1] - сколько раз мигнуть (необязательный)
+    // argv[2] - период в миллисекундах (необязательный)
+    // expected params
+    // argv[1] - blink count (optional)
+    // argv[2] - period in milliseconds (optional)
+    int count = argc > 1 ? atoi(argv[1]) : 3;
+    int period = argc > 2 ? atoi(argv[2]) : 500;
+    if(argc > 3 || count < 1 || count > 100 || period < 10 || period > 2000) {
+        strcpy(reply_buffer, REPLY_BAD_PARAMS);
+        return strlen(reply_buffer);
+    }
+    
+    for(int i = 0; i < count; i++) {
+        digitalWrite(LED_PIN, HIGH);
+        delay(period / 2);
+        digitalWrite(LED_PIN, LOW);
+        delay(period / 2);
+    }
+    ledison = false;
+    
+    // команда выполнена
+    strcpy(reply_buffer, REPLY_OK);
+    return strlen(reply_buffer);
+}
+
+babbler_cmd_t CMD_LEDON = {
+    /* имя команды - строка во флеше из manuals_packed.h */
+    /* command name - string in flash from manuals_packed.h */
+    NAME_LEDON,
+    &cmd_ledon,
+    BABBLER_CMD_MUTATING
+};
+
+babbler_cmd_t CMD_LEDOFF = {
+    NAME_LEDOFF,
+    &cmd_ledoff,
+    BABBLER_CMD_MUTATING
+};
+
+babbler_cmd_t CMD_LEDSTATUS = {
+    NAME_LEDSTATUS,
+    &cmd_ledstatus,
+    BABBLER_CMD_READONLY
+};
+
+babbler_cmd_t CMD_BLINK = {
+    NAME_BLINK,
+    &cmd_blink,
+    BABBLER_CMD_MUTATING
+};
+
+/** Зарегистрированные команды */
+/** Registered commands */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    CMD_HELP,
+    CMD_PING,
+    
+    // пользовательские команды
+    // custom commands
+    CMD_LEDON,
+    CMD_LEDOFF,
+    CMD_LEDSTATUS,
+    CMD_BLINK
+};
+
+/** Количество зарегистрированных команд */
+/** Number of registered commands*/
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+
+/** Руководства для зарегистрированных команд */
+/** Manuals for registered commands */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    // команды из babbler_cmd_core.h (руководства несжатые)
+    // commands from babbler_cmd.core.h (plain manuals)
+    MAN_HELP,
+    MAN_PING,
+    
+    // пользовательские команды (сжатые руководства из manuals_packed.h)
+    // custom commands (packed manuals from manuals_packed.h)
+    MAN_LEDON,
+    MAN_LEDOFF,
+    MAN_LEDSTATUS,
+    MAN_BLINK
+};
+
+/** Количество руководств для зарегистрированных команд */
+/** Number of manuals for registered commands */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+void setup() {
+    Serial.begin(9600);
+    Serial.println(F("Starting babbler-powered device, type help for list of commands"));
+    
+    babbler_serial_set_packet_filter(packet_filter_newline);
+    babbler_serial_set_input_handler(handle_input_simple);
+    babbler_serial_setup(
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE,
+        BABBLER_SERIAL_SKIP_PORT_INIT);
+    
+    pinMode(LED_PIN, OUTPUT);
+}
+
+void loop() {
+    // постоянно следим за последовательным портом, ждем входные данные
+    // monitor serial port for input data
+    babbler_serial_tasks();
+}
@@ -0,0 +1,76 @@
+// Сгенерировано babbler_manpack.py из babbler_h/examples/babbler_manpack/manuals.man, не редактировать.
+// Generated by babbler_manpack.py from babbler_h/examples/babbler_manpack/manuals.man, do not edit.
+// 4 manuals: 787 bytes plain, 483 bytes packed (dictionary 195 bytes, 21 words)
+
+#include "babbler.h"
+#include "babbler_manpack.h"
+
+#ifndef BABBLER_PACKED_MANUALS
+#error "Enable BABBLER_PACKED_MANUALS in babbler_lib_config.h"
+#endif
+
+// словарь: строки подряд и смещения, где начинается каждая
+// dictionary: strings one after another and their offsets
+extern const uint16_t BABBLER_MAN_DICT_INDEX[] BABBLER_FLASH = {
+    0, 4, 27, 40, 46, 58, 70, 78, 84, 89, 101, 104,
+    110, 116, 120, 124, 127, 130, 137, 143, 148, 151,
+};
+extern const char BABBLER_MAN_DICT[] BABBLER_FLASH = 
+    " led. Returns \"ok\" when the\n"
+    "DESCRIPTION\n"
+    " blinkSYNOPSIS\n"
+    "    is turned Ocommand  untilcount00, default    period times OFF theu"
+    "rnstafinisheN and . Theoff";
+
+const char NAME_LEDON[] BABBLER_FLASH = "ledon";
+static const char _descr_ledon[] BABBLER_FLASH = "turn led ON";
+static const char _man_ledon[] BABBLER_FLASH = 
+    "\001\204\200on\202T\217\200 ON\223\200 \220ys ON\207\200\224 \206or\207"
+    "\203\n"
+    "\206\221s\201\200\205N.";
+const babbler_man_t MAN_LEDON = {
+    NAME_LEDON,
+    _descr_ledon,
+    _man_ledon
+};
+
+const char NAME_LEDOFF[] BABBLER_FLASH = "ledoff";
+static const char _descr_ledoff[] BABBLER_FLASH = "turn led OFF";
+static const char _man_ledoff[] BABBLER_FLASH = 
+    "\001\204\200\224\202T\217\200\215\223\200 \220ys\215\207\200on \206or\207"
+    "\203\n"
+    "\206\220rts\201\200\205FF.";
+const babbler_man_t MAN_LEDOFF = {
+    NAME_LEDOFF,
+    _descr_ledoff,
+    _man_ledoff
+};
+
+const char NAME_LEDSTATUS[] BABBLER_FLASH = "ledstatus";
+static const char _descr_ledstatus[] BABBLER_FLASH = "get led status: on/off";
+static const char _man_ledstatus[] BABBLER_FLASH = 
+    "\001\204\200\220tus\202Get\200 \220tus: ret\217s \"on\" if\216\200\205"
+    "\222\"\224\" if\216\n"
+    "led\205FF.";
+const babbler_man_t MAN_LEDSTATUS = {
+    NAME_LEDSTATUS,
+    _descr_ledstatus,
+    _man_ledstatus
+};
+
+const char NAME_BLINK[] BABBLER_FLASH = "blink";
+static const char _descr_blink[] BABBLER_FLASH = "blink led several times";
+static const char _man_blink[] BABBLER_FLASH = 
+    "\001\204\203\n"
+    "\212\203 [\210]\n"
+    "\212\203 [\210] [\213]\202Blink\200 several\214: t\217\200 O\222t\217\200"
+    "\215 \210\214,\n"
+    "then leave\216\200\215\201\200 has \221d\203ing.\n"
+    "OPTIONS\n"
+    "\212 \210 - how many\214 to\203\216\200, 1..1\2113\n"
+    "\212 \213 -\203 \213 in milliseconds, 10..20\211500";
+const babbler_man_t MAN_BLINK = {
+    NAME_BLINK,
+    _descr_blink,
+    _man_blink
+};
@@ -18,13 +18,13 @@ char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
 
 
 
-extern const char* DEVICE_NAME = "Robot Car";
-extern const char* DEVICE_MODEL = "model2";
-extern const char* DEVICE_SERIAL_NUBMER = "00000003";
-extern const char* DEVICE_DESCRIPTION = "Programmable arduino-based wheeled robot";
-extern const char* DEVICE_VERSION = "2.3-devel";
-extern const char* DEVICE_MANUFACTURER = "Sad robot";
-extern const char* DEVICE_URI = "sadrobot.su";
+const char* DEVICE_NAME = "Robot Car";
+const char* DEVICE_MODEL = "model2";
+const char* DEVICE_SERIAL_NUBMER = "00000003";
+const char* DEVICE_DESCRIPTION = "Programmable arduino-based wheeled robot";
+const char* DEVICE_VERSION = "2.3-devel";
+const char* DEVICE_MANUFACTURER = "Sad robot";
+const char* DEVICE_URI = "sadrobot.su";
 
 /** Зарегистрированные команды */
 extern const babbler_cmd_t BABBLER_COMMANDS[] = {
@@ -177,6 +177,10 @@ void setup() {
     Serial.begin(9600);
     Serial.println("Starting babbler-powered device, type help for list of commands");
     
+    // ответы команд devinfo - один раз, до первой команды
+    // build devinfo replies once, before the first command
+    babbler_devinfo_setup();
+    
     babbler_serial_set_packet_filter(packet_filter_newline);
     babbler_serial_set_input_handler(handle_input);
     //babbler_serial_setup(
@@ -0,0 +1,84 @@
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_cmd_core.h"
+#include "babbler_serial.h"
+
+// Размеры буферов для чтения команд и записи ответов
+// Read and write buffer size for communication modules
+#define SERIAL_READ_BUFFER_SIZE 128
+#define SERIAL_WRITE_BUFFER_SIZE 512
+
+// Буферы для обмена данными с компьютером через последовательный порт Serial
+// (отладочная консоль).
+// +1 байт в конце для завершающего нуля
+// Data exchange buffers to communicate with computer via serial port Serial
+// (debug console).
+// +1 extra byte at the end for terminating zero
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+// Отдельный канал связи с собственными буферами через порт Serial1
+// (например, Arduino Mega): обмен с управляющим компьютером в формате JSON.
+// Separate communication channel with it's own buffers via Serial1 port
+// (e.g. on Arduino Mega): JSON data exchange with host computer.
+babbler_serial_t host_port;
+char host_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char host_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+/** Зарегистрированные команды */
+/** Registered commands */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    CMD_HELP,
+    CMD_PING
+};
+
+/** Количество зарегистрированных команд */
+/** Number of registered commands*/
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+/** Руководства для зарегистрированных команд */
+/** Manuals for registered commands */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    MAN_HELP,
+    MAN_PING
+};
+
+/** Количество руководств для зарегистрированных команд */
+/** Number of manuals for registered commands */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+void setup() {
+    Serial.begin(9600);
+    Serial.println("Starting babbler-powered device, type help for list of commands");
+    
+    // отладочная консоль: простые текстовые команды через Serial
+    // debug console: simple text commands via Serial
+    babbler_serial_set_packet_filter(packet_filter_newline);
+    babbler_serial_set_input_handler(handle_input_simple);
+    babbler_serial_set_error_handler(handle_input_error_simple);
+    babbler_serial_setup(
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE,
+        BABBLER_SERIAL_SKIP_PORT_INIT);
+    
+    // управляющий компьютер: команды JSON через Serial1
+    // host computer: JSON commands via Serial1
+    Serial1.begin(115200);
+    babbler_serial_port_setup(&host_port, Serial1,
+        host_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        host_write_buffer, SERIAL_WRITE_BUFFER_SIZE);
+    babbler_serial_port_set_packet_filter(&host_port, packet_filter_newline);
+    babbler_serial_port_set_input_handler(&host_port, handle_input_json);
+    babbler_serial_port_set_error_handler(&host_port, handle_input_error_json);
+}
+
+void loop() {
+    // постоянно следим за обоими последовательными портами, ждем входные данные
+    // monitor both serial ports for input data
+    babbler_serial_tasks();
+}
@@ -0,0 +1,154 @@
+// Имена команд и руководства во флеше (AVR: PROGMEM), а не в RAM.
+// Включить BABBLER_PROGMEM в babbler_lib_config.h (define в скетче 
+// не действует на файлы библиотеки). Строки собственных команд объявлять 
+// с атрибутом BABBLER_FLASH - так скетч работает и без BABBLER_PROGMEM.
+//
+// Command names and manuals in flash (AVR: PROGMEM) instead of RAM.
+// Enable BABBLER_PROGMEM in babbler_lib_config.h (a define in the sketch
+// does not reach library files). Declare own command strings with
+// BABBLER_FLASH - the sketch works without BABBLER_PROGMEM too.
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_cmd_core.h"
+#include "babbler_serial.h"
+
+// Размеры буферов для чтения команд и записи ответов
+// Read and write buffer size for communication modules
+#define SERIAL_READ_BUFFER_SIZE 128
+#define SERIAL_WRITE_BUFFER_SIZE 512
+
+// Буферы для обмена данными с компьютером через последовательный порт.
+// +1 байт в конце для завершающего нуля
+// Data exchange buffers to communicate with computer via serial port.
+// +1 extra byte at the end for terminating zero
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+
+#define LED_PIN 13
+bool ledison = false;
+
+/** Реализация команды ledon (включить лампочку) */
+/** ledon (turn led ON) command implementation */
+int cmd_ledon(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    digitalWrite(LED_PIN, HIGH);
+    ledison = true;
+    
+    // команда выполнена
+    strcpy(reply_buffer, REPLY_OK);
+    return strlen(reply_buffer);
+}
+
+/** Реализация команды ledstatus (cтатус лампочки) */
+/** ledstatus (get led status) command implementation */
+int cmd_ledstatus(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    if(ledison) {
+        strcpy(reply_buffer, "on");
+    } else {
+        strcpy(reply_buffer, "off");
+    }
+    
+    return strlen(reply_buffer);
+}
+
+// строки команд во флеше
+// command strings in flash
+const char NAME_LEDON[] BABBLER_FLASH = "ledon";
+const char DESCR_LEDON[] BABBLER_FLASH = "turn led ON";
+const char MANUAL_LEDON[] BABBLER_FLASH = 
+    "SYNOPSIS\n"
+    "    ledon\n"
+    "DESCRIPTION\n"
+    "Turn led ON.";
+
+const char NAME_LEDSTATUS[] BABBLER_FLASH = "ledstatus";
+const char DESCR_LEDSTATUS[] BABBLER_FLASH = "get led status: on/off";
+const char MANUAL_LEDSTATUS[] BABBLER_FLASH = 
+    "SYNOPSIS\n"
+    "    ledstatus\n"
+    "DESCRIPTION\n"
+    "Get led status: on/off.";
+
+babbler_cmd_t CMD_LEDON = {
+    /* имя команды - строка во флеше */
+    /* command name - string in flash */
+    NAME_LEDON,
+    &cmd_ledon,
+    BABBLER_CMD_MUTATING
+};
+
+babbler_man_t MAN_LEDON = {
+    NAME_LEDON,
+    DESCR_LEDON,
+    MANUAL_LEDON
+};
+
+babbler_cmd_t CMD_LEDSTATUS = {
+    NAME_LEDSTATUS,
+    &cmd_ledstatus,
+    BABBLER_CMD_READONLY
+};
+
+babbler_man_t MAN_LEDSTATUS = {
+    NAME_LEDSTATUS,
+    DESCR_LEDSTATUS,
+    MANUAL_LEDSTATUS
+};
+
+/** Зарегистрированные команды */
+/** Registered commands */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    CMD_HELP,
+    CMD_PING,
+    
+    // пользовательские команды
+    // custom commands
+    CMD_LEDON,
+    CMD_LEDSTATUS
+};
+
+/** Количество зарегистрированных команд */
+/** Number of registered commands*/
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+
+/** Руководства для зарегистрированных команд */
+/** Manuals for registered commands */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    MAN_HELP,
+    MAN_PING,
+    
+    // пользовательские команды
+    // custom commands
+    MAN_LEDON,
+    MAN_LEDSTATUS
+};
+
+/** Количество руководств для зарегистрированных команд */
+/** Number of manuals for registered commands */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+void setup() {
+    Serial.begin(9600);
+    Serial.println(F("Starting babbler-powered device, type help for list of commands"));
+    
+    babbler_serial_set_packet_filter(packet_filter_newline);
+    babbler_serial_set_input_handler(handle_input_simple);
+    babbler_serial_setup(
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE,
+        BABBLER_SERIAL_SKIP_PORT_INIT);
+    
+    pinMode(LED_PIN, OUTPUT);
+}
+
+void loop() {
+    // постоянно следим за последовательным портом, ждем входные данные
+    // monitor serial port for input data
+    babbler_serial_tasks();
+}
@@ -25,6 +25,13 @@
 char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
 char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
 
+// Очередь приема: клиент может отправить несколько команд подряд,
+// не дожидаясь ответа на каждую
+// Receive queue: client may send several commands in a row
+// without waiting for reply to each of them
+#define SERIAL_RX_QUEUE_FRAMES 3
+char serial_rx_queue[BABBLER_SERIAL_RX_QUEUE_SIZE(SERIAL_READ_BUFFER_SIZE, SERIAL_RX_QUEUE_FRAMES)];
+
 #endif // BABBLER_SERIAL
 
 
@@ -64,6 +71,7 @@ void babbler_setup() {
     #ifdef BABBLER_SERIAL
         babbler_serial_set_packet_filter(packet_filter_newline);
         babbler_serial_set_input_handler(handle_input_simple);
+        babbler_serial_set_error_handler(handle_input_error_simple);
     
         #ifdef DEBUG_SERIAL
             Serial.println("Enable Babbler Serial communication module");
@@ -77,6 +85,11 @@ void babbler_setup() {
                 serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE,
                 9600);
         #endif // DEBUG_SERIAL
+        
+        babbler_serial_set_rx_queue(serial_rx_queue, SERIAL_RX_QUEUE_FRAMES);
+        // обрабатывать накопившиеся команды не дольше 10 миллисекунд за один вызов
+        // handle queued commands for no longer than 10 milliseconds per call
+        babbler_serial_set_time_budget(10);
     #endif // BABBLER_SERIAL
 }
 
@@ -92,6 +105,18 @@ void babbler_tasks(){
     #endif // BABBLER_SERIAL
 }
 
+#ifdef BABBLER_SERIAL
+/**
+ * Забирать входные данные из аппаратного буфера порта в очередь приема
+ * сразу, как они появятся
+ * Move input data from serial port hardware buffer to receive queue
+ * as soon as it arrives
+ */
+void serialEvent() {
+    babbler_serial_receive();
+}
+#endif // BABBLER_SERIAL
+
 void setup() {
     #ifdef DEBUG_SERIAL
         Serial.begin(9600);
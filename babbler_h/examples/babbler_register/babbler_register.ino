@@ -0,0 +1,122 @@
+// Команды и руководства одним списком: BABBLER_REGISTER_COMMANDS объявляет
+// BABBLER_COMMANDS и BABBLER_MANUALS с одинаковыми индексами, так что
+// таблицы не нужно держать согласованными вручную, а команда help находит
+// руководство по индексу команды. Команда, указанная дважды, - ошибка
+// компиляции.
+//
+// Commands and manuals in a single list: BABBLER_REGISTER_COMMANDS declares
+// BABBLER_COMMANDS and BABBLER_MANUALS with matching indices, so there is
+// no need to keep the tables in sync by hand, and help finds a manual by
+// the command's index. A command listed twice fails to compile.
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_cmd_core.h"
+#include "babbler_serial.h"
+
+// Размеры буферов для чтения команд и записи ответов
+// Read and write buffer size for communication modules
+#define SERIAL_READ_BUFFER_SIZE 128
+#define SERIAL_WRITE_BUFFER_SIZE 512
+
+// Буферы для обмена данными с компьютером через последовательный порт.
+// +1 байт в конце для завершающего нуля
+// Data exchange buffers to communicate with computer via serial port.
+// +1 extra byte at the end for terminating zero
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+
+#define LED_PIN 13
+bool ledison = false;
+
+/** Реализация команды ledon (включить лампочку) */
+/** ledon (turn led ON) command implementation */
+int cmd_ledon(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    digitalWrite(LED_PIN, HIGH);
+    ledison = true;
+    
+    // команда выполнена
+    strcpy(reply_buffer, REPLY_OK);
+    return strlen(reply_buffer);
+}
+
+/** Реализация команды ledoff (выключить лампочку) */
+/** ledoff (turn led OFF) command implementation */
+int cmd_ledoff(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    digitalWrite(LED_PIN, LOW);
+    ledison = false;
+    
+    // команда выполнена
+    strcpy(reply_buffer, REPLY_OK);
+    return strlen(reply_buffer);
+}
+
+/** Реализация команды ledstatus (cтатус лампочки) */
+/** ledstatus (get led status) command implementation */
+int cmd_ledstatus(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    if(ledison) {
+        strcpy(reply_buffer, "on");
+    } else {
+        strcpy(reply_buffer, "off");
+    }
+    
+    return strlen(reply_buffer);
+}
+
+/** 
+ * Зарегистрированные команды с руководствами:
+ * USE - команды из библиотеки, CMD - пользовательские команды
+ * (имя, функция, флаги, краткое описание, руководство).
+ *
+ * Registered commands with manuals:
+ * USE - library commands, CMD - custom commands
+ * (name, function, flags, short description, manual).
+ */
+#define COMMANDS(CMD, USE) \
+    /* команды из babbler_cmd_core.h */ \
+    /* commands from babbler_cmd.core.h */ \
+    USE(help, CMD_HELP, MAN_HELP) \
+    USE(ping, CMD_PING, MAN_PING) \
+    \
+    /* пользовательские команды */ \
+    /* custom commands */ \
+    CMD(ledon, &cmd_ledon, BABBLER_CMD_MUTATING, "turn led ON", \
+        "SYNOPSIS\n" \
+        "    ledon\n" \
+        "DESCRIPTION\n" \
+        "Turn led ON.") \
+    CMD(ledoff, &cmd_ledoff, BABBLER_CMD_MUTATING, "turn led OFF", \
+        "SYNOPSIS\n" \
+        "    ledoff\n" \
+        "DESCRIPTION\n" \
+        "Turn led OFF.") \
+    CMD(ledstatus, &cmd_ledstatus, BABBLER_CMD_READONLY, "get led status: on/off", \
+        "SYNOPSIS\n" \
+        "    ledstatus\n" \
+        "DESCRIPTION\n" \
+        "Get led status: on/off.")
+
+// BABBLER_COMMANDS, BABBLER_MANUALS и количества
+// BABBLER_COMMANDS, BABBLER_MANUALS and counts
+BABBLER_REGISTER_COMMANDS(COMMANDS)
+
+void setup() {
+    Serial.begin(9600);
+    Serial.println(F("Starting babbler-powered device, type help for list of commands"));
+    
+    babbler_serial_set_packet_filter(packet_filter_newline);
+    babbler_serial_set_input_handler(handle_input_simple);
+    babbler_serial_setup(
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE,
+        BABBLER_SERIAL_SKIP_PORT_INIT);
+    
+    pinMode(LED_PIN, OUTPUT);
+}
+
+void loop() {
+    // постоянно следим за последовательным портом, ждем входные данные
+    // monitor serial port for input data
+    babbler_serial_tasks();
+}
@@ -0,0 +1,154 @@
+#ifndef BABBLER_HOST_ARDUINO_H
+#define BABBLER_HOST_ARDUINO_H
+
+// Минимальная замена Arduino.h для сборки библиотеки на Linux (см CMakeLists.txt):
+// время (millis, delay), классы Print/Stream и порт Serial, который читает
+// и пишет дескрипторы файлов (stdin/stdout, псевдотерминал, socketpair).
+// Только то, что нужно модулям babbler_h, babbler_json и babbler_serial.
+//
+// Minimal Arduino.h replacement for Linux builds of the library:
+// time functions, Print/Stream and a Serial port backed by file descriptors
+// (stdin/stdout, pty, socketpair).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/**
+ * Ждать входные данные во всех открытых портах HostSerial не дольше 1 миллисекунды
+ * (см babbler_host_wait).
+ */
+void yield();
+
+class Print {
+public:
+    virtual ~Print() {}
+    
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* buffer, size_t size) {
+        return write((const uint8_t*)buffer, size);
+    }
+    
+    virtual int availableForWrite() {
+        return 0;
+    }
+    virtual void flush() {}
+    
+    size_t print(const char* str);
+    size_t print(char c);
+    size_t print(int n);
+    size_t print(long n);
+    size_t print(unsigned long n);
+    size_t println();
+    size_t println(const char* str);
+    size_t println(int n);
+    size_t println(long n);
+    size_t println(unsigned long n);
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    
+    /**
+     * Прочитать не больше length байт, которые уже пришли
+     * (без ожидания, в отличие от Arduino Stream.readBytes с таймаутом).
+     */
+    size_t readBytes(char* buffer, size_t length);
+};
+
+/**
+ * Последовательный порт поверх дескрипторов файлов: чтение
+ * неблокирующее (available/read), запись блокирующая
+ * (availableForWrite сообщает о большом буфере, ответ уходит целиком).
+ *
+ * Serial port on top of file descriptors: non-blocking reads,
+ * blocking writes.
+ */
+class HostSerial : public Stream {
+public:
+    HostSerial();
+    
+    /**
+     * Открыть порт: если дескрипторы не заданы (attach, openPty, openPipe),
+     * порт работает через stdin/stdout. Скорость игнорируется.
+     */
+    void begin(long speed);
+    void end();
+    
+    /**
+     * Читать из in_fd, писать в out_fd (могут совпадать).
+     */
+    void attach(int in_fd, int out_fd);
+    
+    /**
+     * Работать через новый псевдотерминал в сыром режиме: клиент
+     * открывает slave_name (например, screen /dev/pts/N).
+     * @return 0 - успех, -1 - ошибка (см errno)
+     */
+    int openPty(char* slave_name, int slave_name_size);
+    
+    /**
+     * Работать через пару соединенных сокетов (socketpair) - канал в памяти
+     * для тестов и замеров: клиент пишет команды и читает ответы через client_fd.
+     * @return 0 - успех, -1 - ошибка (см errno)
+     */
+    int openPipe(int* client_fd);
+    
+    /** Дескриптор для чтения (-1 - порт не открыт) */
+    int fd() {
+        return _in_fd;
+    }
+    
+    /** Входные данные закончились (клиент закрыл свою сторону, конец stdin) */
+    bool eof() {
+        return _eof && _rx_len == 0;
+    }
+    
+    int available();
+    int read();
+    int peek();
+    
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buffer, size_t size);
+    using Print::write;
+    int availableForWrite();
+    
+    operator bool() {
+        return _in_fd >= 0;
+    }
+    
+    /** Следующий открытый порт (см yield) */
+    HostSerial* next;
+
+private:
+    void _open(int in_fd, int out_fd, int extra_fd);
+    
+    int _in_fd;
+    int _out_fd;
+    /** Дополнительный дескриптор, который нужно закрыть в end (slave псевдотерминала) */
+    int _extra_fd;
+    bool _eof;
+    
+    /** Принятые, но еще не прочитанные байты (аналог приемного буфера UART) */
+    uint8_t _rx_buffer[256];
+    int _rx_head;
+    int _rx_len;
+};
+
+extern HostSerial Serial;
+
+#endif // BABBLER_HOST_ARDUINO_H
@@ -0,0 +1,367 @@
+#include "Arduino.h"
+#include "babbler_host.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/socket.h>
+
+// Размер буфера отправки, о котором сообщает availableForWrite:
+// запись блокирующая, так что ответ любого разумного размера уходит целиком
+#define HOST_SERIAL_TX_SIZE 65536
+
+// Сколько портов ждать одновременно в yield
+#define HOST_SERIAL_MAX_POLL 16
+
+HostSerial Serial;
+
+// Открытые порты, их дескрипторы ждет yield
+static HostSerial* _ports = NULL;
+
+static struct timespec _start_time;
+static bool _start_time_set = false;
+
+// Виртуальное время (см babbler_host_set_virtual_time)
+static bool _virtual_time = false;
+static uint64_t _virtual_us = 0;
+
+/**
+ * Микросекунды с первого вызова функций времени.
+ */
+static uint64_t _now_us() {
+    if(_virtual_time) {
+        return _virtual_us;
+    }
+    
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(!_start_time_set) {
+        _start_time = now;
+        _start_time_set = true;
+    }
+    return (uint64_t)(now.tv_sec - _start_time.tv_sec) * 1000000 +
+        (now.tv_nsec - _start_time.tv_nsec) / 1000;
+}
+
+void babbler_host_set_virtual_time(bool enable) {
+    if(enable && !_virtual_time) {
+        // продолжаем с текущего момента, чтобы время не шло назад
+        _virtual_us = _now_us();
+    }
+    _virtual_time = enable;
+}
+
+void babbler_host_advance_time(uint64_t us) {
+    _virtual_us += us;
+}
+
+uint64_t babbler_host_time_us() {
+    return _now_us();
+}
+
+unsigned long millis() {
+    return (unsigned long)(_now_us() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)_now_us();
+}
+
+void delay(unsigned long ms) {
+    if(_virtual_time) {
+        _virtual_us += (uint64_t)ms * 1000;
+        return;
+    }
+    
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    while(nanosleep(&ts, &ts) < 0 && errno == EINTR);
+}
+
+void delayMicroseconds(unsigned int us) {
+    if(_virtual_time) {
+        _virtual_us += us;
+        return;
+    }
+    
+    struct timespec ts;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while(nanosleep(&ts, &ts) < 0 && errno == EINTR);
+}
+
+void yield() {
+    babbler_host_wait(1);
+}
+
+void babbler_host_wait(unsigned long ms) {
+    if(_virtual_time) {
+        // ждать некого - время идет только по babbler_host_advance_time
+        _virtual_us += 1000;
+        return;
+    }
+    
+    struct pollfd fds[HOST_SERIAL_MAX_POLL];
+    int count = 0;
+    for(HostSerial* port = _ports; port != NULL && count < HOST_SERIAL_MAX_POLL; port = port->next) {
+        if(port->eof()) {
+            // закрытый дескриптор всегда готов к чтению - не ждем его
+            continue;
+        }
+        fds[count].fd = port->fd();
+        fds[count].events = POLLIN;
+        count++;
+    }
+    int poll_timeout;
+    if(count == 0) {
+        // будить некому - не спим дольше миллисекунды, как yield
+        poll_timeout = ms > 0 ? 1 : 0;
+    } else if(ms == (unsigned long)-1) {
+        poll_timeout = -1;
+    } else {
+        poll_timeout = ms > INT_MAX ? INT_MAX : (int)ms;
+    }
+    poll(fds, count, poll_timeout);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    while(written < size && write(buffer[written])) {
+        written++;
+    }
+    return written;
+}
+
+size_t Print::print(const char* str) {
+    return write((const uint8_t*)str, strlen(str));
+}
+
+size_t Print::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t Print::print(int n) {
+    return print((long)n);
+}
+
+size_t Print::print(long n) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%ld", n);
+    return print(buf);
+}
+
+size_t Print::print(unsigned long n) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lu", n);
+    return print(buf);
+}
+
+size_t Print::println() {
+    return print("\r\n");
+}
+
+size_t Print::println(const char* str) {
+    return print(str) + println();
+}
+
+size_t Print::println(int n) {
+    return print(n) + println();
+}
+
+size_t Print::println(long n) {
+    return print(n) + println();
+}
+
+size_t Print::println(unsigned long n) {
+    return print(n) + println();
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while(count < length && available() > 0) {
+        buffer[count++] = read();
+    }
+    return count;
+}
+
+HostSerial::HostSerial() {
+    next = NULL;
+    _in_fd = -1;
+    _out_fd = -1;
+    _extra_fd = -1;
+    _eof = false;
+    _rx_head = 0;
+    _rx_len = 0;
+}
+
+void HostSerial::_open(int in_fd, int out_fd, int extra_fd) {
+    end();
+    
+    // читаем без блокировки, как из приемного буфера UART
+    int flags = fcntl(in_fd, F_GETFL);
+    if(flags >= 0) {
+        fcntl(in_fd, F_SETFL, flags | O_NONBLOCK);
+    }
+    
+    _in_fd = in_fd;
+    _out_fd = out_fd;
+    _extra_fd = extra_fd;
+    _eof = false;
+    _rx_head = 0;
+    _rx_len = 0;
+    
+    next = _ports;
+    _ports = this;
+}
+
+void HostSerial::begin(long speed) {
+    if(_in_fd < 0) {
+        _open(STDIN_FILENO, STDOUT_FILENO, -1);
+    }
+}
+
+void HostSerial::end() {
+    if(_in_fd < 0) {
+        return;
+    }
+    
+    // убираем из списка открытых портов
+    for(HostSerial** port = &_ports; *port != NULL; port = &(*port)->next) {
+        if(*port == this) {
+            *port = next;
+            break;
+        }
+    }
+    next = NULL;
+    
+    // stdin/stdout не закрываем
+    if(_in_fd > STDERR_FILENO) {
+        close(_in_fd);
+    }
+    if(_out_fd != _in_fd && _out_fd > STDERR_FILENO) {
+        close(_out_fd);
+    }
+    if(_extra_fd >= 0) {
+        close(_extra_fd);
+    }
+    _in_fd = -1;
+    _out_fd = -1;
+    _extra_fd = -1;
+}
+
+void HostSerial::attach(int in_fd, int out_fd) {
+    _open(in_fd, out_fd, -1);
+}
+
+int HostSerial::openPty(char* slave_name, int slave_name_size) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if(fd < 0) {
+        return -1;
+    }
+    
+    char name[64];
+    int slave_fd = -1;
+    if(grantpt(fd) < 0 || unlockpt(fd) < 0 || ptsname_r(fd, name, sizeof(name)) != 0 ||
+            (slave_fd = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    
+    // сырой режим: без эха, без обработки переводов строк и управляющих символов;
+    // свой дескриптор slave держим открытым, чтобы чтение не возвращало ошибку,
+    // пока клиент не подключен
+    struct termios tio;
+    if(tcgetattr(slave_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(slave_fd, TCSANOW, &tio);
+    }
+    
+    _open(fd, fd, slave_fd);
+    
+    if(slave_name != NULL && slave_name_size > 0) {
+        strncpy(slave_name, name, slave_name_size);
+        slave_name[slave_name_size - 1] = 0;
+    }
+    return 0;
+}
+
+int HostSerial::openPipe(int* client_fd) {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        return -1;
+    }
+    _open(fds[0], fds[0], -1);
+    *client_fd = fds[1];
+    return 0;
+}
+
+int HostSerial::available() {
+    if(_rx_len == 0 && _in_fd >= 0) {
+        ssize_t res = ::read(_in_fd, _rx_buffer, sizeof(_rx_buffer));
+        if(res > 0) {
+            _rx_head = 0;
+            _rx_len = res;
+        } else if(res == 0) {
+            _eof = true;
+        }
+    }
+    return _rx_len;
+}
+
+int HostSerial::read() {
+    if(available() == 0) {
+        return -1;
+    }
+    uint8_t c = _rx_buffer[_rx_head];
+    _rx_head++;
+    _rx_len--;
+    return c;
+}
+
+int HostSerial::peek() {
+    if(available() == 0) {
+        return -1;
+    }
+    return _rx_buffer[_rx_head];
+}
+
+size_t HostSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HostSerial::write(const uint8_t* buffer, size_t size) {
+    if(_out_fd < 0) {
+        return 0;
+    }
+    
+    size_t written = 0;
+    while(written < size) {
+        ssize_t res = ::write(_out_fd, buffer + written, size - written);
+        if(res < 0) {
+            if(errno == EINTR) {
+                continue;
+            } else if(errno == EAGAIN) {
+                // дескриптор неблокирующий (общий с чтением) - ждем места
+                struct pollfd pfd;
+                pfd.fd = _out_fd;
+                pfd.events = POLLOUT;
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            break;
+        }
+        written += res;
+    }
+    return written;
+}
+
+int HostSerial::availableForWrite() {
+    return HOST_SERIAL_TX_SIZE;
+}
@@ -0,0 +1,42 @@
+#ifndef BABBLER_HOST_H
+#define BABBLER_HOST_H
+
+#include <stdint.h>
+
+// Управление временем сборки для Linux (см Arduino.h из babbler_host):
+// в режиме виртуального времени millis/micros возвращают значение счетчика,
+// который двигает только программа (babbler_host_advance_time), а delay
+// и yield сдвигают его вместо ожидания. Нужно для моделирования линии связи
+// (см babbler_link_sim.h) - результат не зависит от загрузки машины.
+//
+// Host build time control: in virtual time mode millis/micros return a counter
+// advanced only by the program, delay and yield advance it instead of waiting.
+
+/**
+ * Включить или выключить виртуальное время. При включении счетчик
+ * продолжает с текущего значения millis/micros.
+ */
+void babbler_host_set_virtual_time(bool enable);
+
+/**
+ * Сдвинуть виртуальное время вперед на us микросекунд.
+ */
+void babbler_host_advance_time(uint64_t us);
+
+/**
+ * Текущее время в микросекундах (виртуальное или с момента запуска),
+ * без переполнения, в отличие от micros.
+ */
+uint64_t babbler_host_time_us();
+
+/**
+ * Ждать входные данные во всех открытых портах HostSerial не дольше
+ * ms миллисекунд, ((unsigned long)-1 - без ограничения) одним вызовом poll.
+ * Другие потоки (Stream) ожидание не прерывают. В режиме виртуального
+ * времени сдвигает время на 1 миллисекунду, как yield.
+ * Вызывается из babbler_serial_idle вместо yield: процесс не просыпается
+ * каждую миллисекунду.
+ */
+void babbler_host_wait(unsigned long ms);
+
+#endif // BABBLER_HOST_H
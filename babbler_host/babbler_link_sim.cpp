@@ -0,0 +1,183 @@
+#include "babbler_link_sim.h"
+#include "babbler_host.h"
+
+// Бит на байт: старт, 8 бит данных, стоп (8N1)
+#define BITS_PER_BYTE 10
+
+babbler_link_sim_config_t babbler_link_sim_default_config() {
+    babbler_link_sim_config_t config;
+    config.baud = 115200;
+    config.rx_fifo = 64;
+    config.tx_fifo = 64;
+    config.latency_us = 0;
+    config.jitter_us = 0;
+    config.drop_rate = 0;
+    config.seed = 1;
+    return config;
+}
+
+LinkSimSerial::LinkSimSerial(const babbler_link_sim_config_t& config) {
+    _config = config;
+    _byte_ns = (uint64_t)BITS_PER_BYTE * 1000000000ULL / config.baud;
+    _client_tx_free_ns = 0;
+    _device_tx_free_ns = 0;
+    _last_to_device_us = 0;
+    _last_to_client_us = 0;
+    _dropped = 0;
+    _overruns = 0;
+    _random = config.seed != 0 ? config.seed : 1;
+}
+
+/**
+ * Случайное число xorshift32: воспроизводимо при одинаковом seed.
+ */
+static uint32_t _next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+bool LinkSimSerial::_drop() {
+    return _config.drop_rate > 0 &&
+        _next_random(&_random) < _config.drop_rate * 4294967296.0;
+}
+
+uint64_t LinkSimSerial::_arrival(uint64_t wire_done_us, uint64_t* last_arrival_us) {
+    uint64_t arrival = wire_done_us + _config.latency_us;
+    if(_config.jitter_us > 0) {
+        arrival += _next_random(&_random) % (_config.jitter_us + 1);
+    }
+    // разброс задержки не переставляет байты местами
+    if(arrival < *last_arrival_us) {
+        arrival = *last_arrival_us;
+    }
+    *last_arrival_us = arrival;
+    return arrival;
+}
+
+void LinkSimSerial::clientWrite(const char* data, int len) {
+    uint64_t now_ns = babbler_host_time_us() * 1000;
+    if(_client_tx_free_ns < now_ns) {
+        _client_tx_free_ns = now_ns;
+    }
+    for(int i = 0; i < len; i++) {
+        _client_tx_free_ns += _byte_ns;
+        _timed_byte_t b;
+        b.time_us = _arrival(_client_tx_free_ns / 1000, &_last_to_device_us);
+        b.c = data[i];
+        _to_device.push_back(b);
+    }
+}
+
+int LinkSimSerial::clientRead(char* buffer, int size) {
+    _update();
+    int count = 0;
+    while(count < size && !_client_rx.empty()) {
+        buffer[count++] = _client_rx.front();
+        _client_rx.pop_front();
+    }
+    return count;
+}
+
+void LinkSimSerial::_update() {
+    uint64_t now = babbler_host_time_us();
+    
+    // байты от клиента дошли до устройства: в FIFO приема, если есть место
+    while(!_to_device.empty() && _to_device.front().time_us <= now) {
+        if(_drop()) {
+            _dropped++;
+        } else if((int)_rx_fifo.size() >= _config.rx_fifo) {
+            _overruns++;
+        } else {
+            _rx_fifo.push_back(_to_device.front().c);
+        }
+        _to_device.pop_front();
+    }
+    
+    // байты ушли из FIFO отправки устройства в линию
+    while(!_tx_fifo.empty() && _tx_fifo.front().time_us <= now) {
+        _timed_byte_t b = _tx_fifo.front();
+        _tx_fifo.pop_front();
+        b.time_us = _arrival(b.time_us, &_last_to_client_us);
+        _to_client.push_back(b);
+    }
+    
+    // байты от устройства дошли до клиента
+    while(!_to_client.empty() && _to_client.front().time_us <= now) {
+        if(_drop()) {
+            _dropped++;
+        } else {
+            _client_rx.push_back(_to_client.front().c);
+        }
+        _to_client.pop_front();
+    }
+}
+
+uint64_t LinkSimSerial::nextEventUs() {
+    _update();
+    uint64_t next = UINT64_MAX;
+    if(!_to_device.empty() && _to_device.front().time_us < next) {
+        next = _to_device.front().time_us;
+    }
+    if(!_tx_fifo.empty() && _tx_fifo.front().time_us < next) {
+        next = _tx_fifo.front().time_us;
+    }
+    if(!_to_client.empty() && _to_client.front().time_us < next) {
+        next = _to_client.front().time_us;
+    }
+    return next;
+}
+
+int LinkSimSerial::available() {
+    _update();
+    return _rx_fifo.size();
+}
+
+int LinkSimSerial::read() {
+    _update();
+    if(_rx_fifo.empty()) {
+        return -1;
+    }
+    uint8_t c = _rx_fifo.front();
+    _rx_fifo.pop_front();
+    return c;
+}
+
+int LinkSimSerial::peek() {
+    _update();
+    if(_rx_fifo.empty()) {
+        return -1;
+    }
+    return _rx_fifo.front();
+}
+
+size_t LinkSimSerial::write(uint8_t c) {
+    _update();
+    if((int)_tx_fifo.size() >= _config.tx_fifo) {
+        // FIFO заполнен: как HardwareSerial.write, ждем, пока уйдет
+        // первый байт (в виртуальном времени)
+        uint64_t now = babbler_host_time_us();
+        babbler_host_advance_time(_tx_fifo.front().time_us - now);
+        _update();
+    }
+    
+    uint64_t now_ns = babbler_host_time_us() * 1000;
+    if(_device_tx_free_ns < now_ns) {
+        _device_tx_free_ns = now_ns;
+    }
+    _device_tx_free_ns += _byte_ns;
+    
+    _timed_byte_t b;
+    b.time_us = _device_tx_free_ns / 1000;
+    b.c = c;
+    _tx_fifo.push_back(b);
+    return 1;
+}
+
+int LinkSimSerial::availableForWrite() {
+    _update();
+    return _config.tx_fifo - _tx_fifo.size();
+}
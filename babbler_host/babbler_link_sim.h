@@ -0,0 +1,128 @@
+#ifndef BABBLER_LINK_SIM_H
+#define BABBLER_LINK_SIM_H
+
+#include "Arduino.h"
+
+#include <stdint.h>
+#include <deque>
+
+// Модель последовательной линии для сборки под Linux: время передачи каждого
+// байта на заданной скорости (8N1 - 10 бит на байт), аппаратные FIFO приема
+// и отправки устройства, задержка и разброс задержки (USB-преобразователь,
+// радиомодуль и т.п.), потери байт. Работает в виртуальном времени
+// (см babbler_host_set_virtual_time): устройство - модуль babbler_serial
+// с каналом на LinkSimSerial, клиент - программа, которая пишет запросы
+// (clientWrite) и читает ответы (clientRead).
+//
+// Serial link model for the host build: per-byte timing at a given baud rate,
+// device RX/TX FIFOs, latency with jitter and byte drops, in virtual time.
+
+/**
+ * Параметры линии.
+ */
+typedef struct {
+    /** Скорость, бит/с */
+    long baud;
+    /** Глубина аппаратного FIFO приема устройства, байт (AVR: 64) */
+    int rx_fifo;
+    /** Глубина аппаратного FIFO отправки устройства, байт (AVR: 64) */
+    int tx_fifo;
+    /** Задержка доставки байта в одну сторону, микросекунды */
+    uint32_t latency_us;
+    /** Случайная добавка к задержке, от 0 до jitter_us микросекунд */
+    uint32_t jitter_us;
+    /** Вероятность потери байта (0 - без потерь) */
+    double drop_rate;
+    /** Начальное значение генератора случайных чисел */
+    uint32_t seed;
+} babbler_link_sim_config_t;
+
+/**
+ * Параметры по умолчанию: 115200 бод, FIFO по 64 байта, без задержек и потерь.
+ */
+babbler_link_sim_config_t babbler_link_sim_default_config();
+
+/**
+ * Конец линии со стороны устройства: поток для babbler_serial_port_setup.
+ */
+class LinkSimSerial : public Stream {
+public:
+    LinkSimSerial(const babbler_link_sim_config_t& config);
+    
+    /**
+     * Клиент отправляет данные устройству: байты уходят в линию друг
+     * за другом на скорости линии, начиная с текущего момента.
+     */
+    void clientWrite(const char* data, int len);
+    
+    /**
+     * Клиент забирает байты, которые дошли до него к текущему моменту.
+     * @return количество прочитанных байт
+     */
+    int clientRead(char* buffer, int size);
+    
+    /**
+     * Ближайший момент (микросекунды виртуального времени), когда что-то
+     * изменится в линии: байт дойдет до устройства или клиента либо
+     * освободится место в FIFO отправки; UINT64_MAX - линия пуста.
+     */
+    uint64_t nextEventUs();
+    
+    /** Байты, потерянные в линии */
+    unsigned long dropped() {
+        return _dropped;
+    }
+    
+    /** Байты, потерянные из-за переполнения FIFO приема устройства */
+    unsigned long overruns() {
+        return _overruns;
+    }
+    
+    int available();
+    int read();
+    int peek();
+    
+    size_t write(uint8_t c);
+    using Print::write;
+    int availableForWrite();
+
+private:
+    typedef struct {
+        uint64_t time_us;
+        uint8_t c;
+    } _timed_byte_t;
+    
+    /** Продвинуть линию к текущему моменту */
+    void _update();
+    /** Когда байт, переданный целиком к моменту wire_done_us, дойдет до другой стороны */
+    uint64_t _arrival(uint64_t wire_done_us, uint64_t* last_arrival_us);
+    bool _drop();
+    
+    babbler_link_sim_config_t _config;
+    /** Время передачи одного байта, наносекунды */
+    uint64_t _byte_ns;
+    
+    /** Байты от клиента в линии (время прихода к устройству) */
+    std::deque<_timed_byte_t> _to_device;
+    /** Аппаратный FIFO приема устройства */
+    std::deque<uint8_t> _rx_fifo;
+    /** FIFO отправки устройства (время, когда байт уйдет в линию) */
+    std::deque<_timed_byte_t> _tx_fifo;
+    /** Байты от устройства в линии (время прихода к клиенту) */
+    std::deque<_timed_byte_t> _to_client;
+    /** Дошедшие до клиента байты */
+    std::deque<uint8_t> _client_rx;
+    
+    /** Когда передатчик клиента освободится, наносекунды */
+    uint64_t _client_tx_free_ns;
+    /** Когда передатчик устройства освободится, наносекунды */
+    uint64_t _device_tx_free_ns;
+    uint64_t _last_to_device_us;
+    uint64_t _last_to_client_us;
+    
+    unsigned long _dropped;
+    unsigned long _overruns;
+    uint32_t _random;
+};
+
+#endif // BABBLER_LINK_SIM_H
@@ -0,0 +1,490 @@
+/**
+ * Замеры производительности библиотеки (см CMakeLists.txt, цель bench):
+ * поиск команды в таблице, разбор строки, оформление ответа, обработчики
+ * входных данных целиком.
+ *
+ * Для каждого замера: время на операцию (нс), выделений памяти на операцию
+ * (malloc/calloc/realloc) и байт, скопированных функциями libc
+ * (memcpy, memmove, strcpy, stpcpy, strncpy, strcat, sprintf, snprintf).
+ * Вызовы перехватываются ключом компоновщика --wrap (см CMakeLists.txt),
+ * поэтому копирования, которые компилятор встроил сам (короткие копии
+ * известного размера), не учитываются.
+ *
+ * Размер таблицы команд задается при сборке (BABBLER_BENCH_COMMANDS),
+ * для каждого размера собирается своя программа babbler_bench_N.
+ *
+ * Library benchmarks: ns/op, allocations/op and bytes copied by libc
+ * string/memory functions per op (intercepted with ld --wrap).
+ *
+ * Запуск / run:
+ *     babbler_bench_100 [--out results.jsonl] [--filter name_prefix]
+ *     python3 bench_compare.py old.jsonl new.jsonl
+ */
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_cobs.h"
+#include "babbler_len_prefix.h"
+#include "babbler_cmd_core.h"
+#include "babbler_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef BABBLER_BENCH_COMMANDS
+#define BABBLER_BENCH_COMMANDS 100
+#endif
+
+// Сколько длится один прогон замера и сколько прогонов делать
+// (берем лучший прогон - меньше всего помех от системы)
+#define BENCH_RUN_NS 50000000ULL
+#define BENCH_RUNS 5
+
+#define BUF_SIZE 4096
+
+/**************************************/
+// Счетчики выделений памяти и копирований (ld --wrap)
+
+static uint64_t _allocs = 0;
+static uint64_t _copied = 0;
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_memcpy(void* dest, const void* src, size_t n);
+void* __real_memmove(void* dest, const void* src, size_t n);
+char* __real_strcpy(char* dest, const char* src);
+char* __real_stpcpy(char* dest, const char* src);
+char* __real_strncpy(char* dest, const char* src, size_t n);
+char* __real_strcat(char* dest, const char* src);
+
+void* __wrap_malloc(size_t size) {
+    _allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size) {
+    _allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    _allocs++;
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_memcpy(void* dest, const void* src, size_t n) {
+    _copied += n;
+    return __real_memcpy(dest, src, n);
+}
+
+void* __wrap_memmove(void* dest, const void* src, size_t n) {
+    _copied += n;
+    return __real_memmove(dest, src, n);
+}
+
+char* __wrap_strcpy(char* dest, const char* src) {
+    _copied += strlen(src) + 1;
+    return __real_strcpy(dest, src);
+}
+
+char* __wrap_stpcpy(char* dest, const char* src) {
+    _copied += strlen(src) + 1;
+    return __real_stpcpy(dest, src);
+}
+
+char* __wrap_strncpy(char* dest, const char* src, size_t n) {
+    _copied += n;
+    return __real_strncpy(dest, src, n);
+}
+
+char* __wrap_strcat(char* dest, const char* src) {
+    _copied += strlen(src) + 1;
+    return __real_strcat(dest, src);
+}
+
+int __wrap_sprintf(char* str, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int res = vsprintf(str, format, args);
+    va_end(args);
+    if(res > 0) {
+        _copied += res + 1;
+    }
+    return res;
+}
+
+int __wrap_snprintf(char* str, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int res = vsnprintf(str, size, format, args);
+    va_end(args);
+    if(res > 0 && size > 0) {
+        _copied += (size_t)res < size ? res + 1 : size;
+    }
+    return res;
+}
+
+} // extern "C"
+
+/**************************************/
+// Таблица команд из BABBLER_BENCH_COMMANDS команд:
+// c000, c001, ... и последней командой ping
+
+/** Сколько аргументов получила команда в последний раз (см _check_argc) */
+static int _cmd_argc = 0;
+
+static int cmd_nop(char* reply_buffer, int reply_buf_size, int argc=0, char *argv[]=NULL) {
+    _cmd_argc = argc;
+    strcpy(reply_buffer, REPLY_OK);
+    return strlen(reply_buffer);
+}
+
+#define _CMD(a, b, c) {"c" #a #b #c, &cmd_nop, BABBLER_CMD_READONLY},
+#define _CMD10(a, b) _CMD(a, b, 0) _CMD(a, b, 1) _CMD(a, b, 2) _CMD(a, b, 3) _CMD(a, b, 4) \
+    _CMD(a, b, 5) _CMD(a, b, 6) _CMD(a, b, 7) _CMD(a, b, 8) _CMD(a, b, 9)
+#define _CMD100(a) _CMD10(a, 0) _CMD10(a, 1) _CMD10(a, 2) _CMD10(a, 3) _CMD10(a, 4) \
+    _CMD10(a, 5) _CMD10(a, 6) _CMD10(a, 7) _CMD10(a, 8) _CMD10(a, 9)
+
+/** Зарегистрированные команды */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+#if BABBLER_BENCH_COMMANDS == 10
+    _CMD(0, 0, 0) _CMD(0, 0, 1) _CMD(0, 0, 2) _CMD(0, 0, 3) _CMD(0, 0, 4)
+    _CMD(0, 0, 5) _CMD(0, 0, 6) _CMD(0, 0, 7) _CMD(0, 0, 8)
+#elif BABBLER_BENCH_COMMANDS == 100
+    _CMD10(0, 0) _CMD10(0, 1) _CMD10(0, 2) _CMD10(0, 3) _CMD10(0, 4)
+    _CMD10(0, 5) _CMD10(0, 6) _CMD10(0, 7) _CMD10(0, 8)
+    _CMD(0, 9, 0) _CMD(0, 9, 1) _CMD(0, 9, 2) _CMD(0, 9, 3) _CMD(0, 9, 4)
+    _CMD(0, 9, 5) _CMD(0, 9, 6) _CMD(0, 9, 7) _CMD(0, 9, 8)
+#elif BABBLER_BENCH_COMMANDS == 1000
+    _CMD100(0) _CMD100(1) _CMD100(2) _CMD100(3) _CMD100(4)
+    _CMD100(5) _CMD100(6) _CMD100(7) _CMD100(8)
+    _CMD10(9, 0) _CMD10(9, 1) _CMD10(9, 2) _CMD10(9, 3) _CMD10(9, 4)
+    _CMD10(9, 5) _CMD10(9, 6) _CMD10(9, 7) _CMD10(9, 8)
+    _CMD(9, 9, 0) _CMD(9, 9, 1) _CMD(9, 9, 2) _CMD(9, 9, 3) _CMD(9, 9, 4)
+    _CMD(9, 9, 5) _CMD(9, 9, 6) _CMD(9, 9, 7) _CMD(9, 9, 8)
+#else
+    #error "BABBLER_BENCH_COMMANDS: 10, 100 or 1000"
+#endif
+    CMD_PING
+};
+
+/** Количество зарегистрированных команд */
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+/** Руководства для зарегистрированных команд */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_PING
+};
+
+/** Количество руководств для зарегистрированных команд */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+/**************************************/
+// Замеры
+
+/** Входные данные замера: копируются в рабочий буфер перед каждой операцией */
+static char _input[BUF_SIZE];
+static int _input_len;
+
+static char _work[BUF_SIZE];
+static char _reply[BUF_SIZE];
+
+/** Аргументы для wrap_reply_json */
+static char* _argv[4];
+static int _argc;
+
+static FILE* _out = NULL;
+static const char* _filter = NULL;
+
+/** Результат последней операции, чтобы компилятор ее не выбросил */
+static volatile int _sink;
+
+static uint64_t _now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Задать входные данные замера.
+ */
+static void _set_input(const char* input, int input_len) {
+    __real_memcpy(_input, input, input_len);
+    _input[input_len] = 0;
+    _input_len = input_len;
+}
+
+static void _set_input_str(const char* input) {
+    _set_input(input, strlen(input));
+}
+
+/**
+ * Восстановить рабочий буфер: обработчики разбирают входные данные на месте.
+ */
+static inline void _reset_work() {
+    __real_memcpy(_work, _input, _input_len + 1);
+}
+
+static void _op_handle_command() {
+    _reset_work();
+    _sink = handle_command(_work, 1, _argv, _reply, BUF_SIZE);
+}
+
+static void _op_handle_command_simple() {
+    _reset_work();
+    _sink = handle_command_simple(_work, _reply, BUF_SIZE);
+}
+
+static void _op_handle_command_json() {
+    _reset_work();
+    _sink = handle_command_json(_work, _reply, BUF_SIZE);
+}
+
+static void _op_wrap_reply_json() {
+    __real_strcpy(_reply, "ok");
+    _sink = wrap_reply_json(_argv[0], _argc, _argv, _reply, BUF_SIZE);
+}
+
+static void _op_pack_reply_newline() {
+    __real_memcpy(_reply, _input, _input_len + 1);
+    _sink = pack_reply_newline(_reply, _input_len, BUF_SIZE);
+}
+
+static input_handler _handler;
+
+static void _op_handle_input() {
+    _reset_work();
+    _sink = _handler(_work, _input_len, _reply, BUF_SIZE);
+}
+
+/**
+ * Проверить, что команда получает все params параметров из входных данных: 
+ * иначе замер разбора меряет меньше, чем называется (см CMD_MAX_TOKENS 
+ * в CMakeLists.txt).
+ */
+static bool _check_argc(const char* name, void (*op)(), int params) {
+    _cmd_argc = 0;
+    op();
+    if(_cmd_argc != params + 1) {
+        fprintf(stderr, "%s: command got argc=%d, expected %d\n", name, _cmd_argc, params + 1);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Выполнить замер: подобрать количество операций на прогон,
+ * сделать BENCH_RUNS прогонов, взять лучший.
+ */
+static void _bench(const char* name, void (*op)()) {
+    if(_filter != NULL && strncmp(name, _filter, strlen(_filter)) != 0) {
+        return;
+    }
+    
+    // прогрев и проверка, что операция вообще работает
+    op();
+    
+    uint64_t iterations = 1;
+    while(true) {
+        uint64_t start = _now_ns();
+        for(uint64_t i = 0; i < iterations; i++) {
+            op();
+        }
+        if(_now_ns() - start >= BENCH_RUN_NS / 10) {
+            break;
+        }
+        iterations *= 2;
+    }
+    iterations *= 10;
+    
+    double best_ns = -1;
+    uint64_t allocs = 0;
+    uint64_t copied = 0;
+    for(int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t allocs_start = _allocs;
+        uint64_t copied_start = _copied;
+        uint64_t start = _now_ns();
+        for(uint64_t i = 0; i < iterations; i++) {
+            op();
+        }
+        double ns = (double)(_now_ns() - start) / iterations;
+        if(best_ns < 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+        allocs = _allocs - allocs_start;
+        copied = _copied - copied_start;
+    }
+    
+    // копирование входных данных в рабочий буфер делает сам замер (__real_memcpy),
+    // в счетчик оно не попадает
+    double allocs_per_op = (double)allocs / iterations;
+    double copied_per_op = (double)copied / iterations;
+    
+    printf("%-48s %12.1f ns/op %8.2f allocs/op %10.1f B/op\n",
+        name, best_ns, allocs_per_op, copied_per_op);
+    if(_out != NULL) {
+        fprintf(_out, "{\"name\": \"%s\", \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, "
+            "\"bytes_copied_per_op\": %.1f, \"iterations\": %llu}\n",
+            name, best_ns, allocs_per_op, copied_per_op, (unsigned long long)iterations);
+    }
+}
+
+/**
+ * Имя замера с размером таблицы команд.
+ */
+static const char* _name(const char* name) {
+    static char buf[128];
+    snprintf(buf, sizeof(buf), "%s/n=%d", name, BABBLER_COMMANDS_COUNT);
+    return buf;
+}
+
+/**
+ * Строка "cmd a0 a1 ..." с argc аргументами.
+ */
+static void _make_args_input(char* buf, int size, const char* cmd, int argc) {
+    int len = snprintf(buf, size, "%s", cmd);
+    for(int i = 0; i < argc && len < size; i++) {
+        len += snprintf(buf + len, size - len, " a%d", i);
+    }
+}
+
+/**
+ * Строка JSON {"cmd": "cmd", "params": ["a0", ...], "id": "id"} с argc параметрами.
+ */
+static void _make_json_input(char* buf, int size, const char* cmd, int argc, const char* id) {
+    int len = snprintf(buf, size, "{\"cmd\": \"%s\"", cmd);
+    if(argc > 0) {
+        len += snprintf(buf + len, size - len, ", \"params\": [");
+        for(int i = 0; i < argc && len < size; i++) {
+            len += snprintf(buf + len, size - len, "%s\"a%d\"", i > 0 ? ", " : "", i);
+        }
+        len += snprintf(buf + len, size - len, "]");
+    }
+    if(id != NULL) {
+        len += snprintf(buf + len, size - len, ", \"id\": \"%s\"", id);
+    }
+    snprintf(buf + len, size - len, "}");
+}
+
+int main(int argc, char* argv[]) {
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            // дописываем: результаты программ с разными таблицами - в один файл
+            _out = fopen(argv[++i], "a");
+            if(_out == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            _filter = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--out results.jsonl] [--filter name_prefix]\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    char buf[BUF_SIZE];
+    
+    // поиск команды в таблице
+    _set_input_str("c000");
+    _bench(_name("handle_command/first"), _op_handle_command);
+    _set_input_str("ping");
+    _bench(_name("handle_command/last"), _op_handle_command);
+    _set_input_str("nosuchcommand");
+    _bench(_name("handle_command/miss"), _op_handle_command);
+    
+    // разбор строки с параметрами (здесь и дальше - первая команда в таблице,
+    // чтобы поиск команды не заслонял остальное)
+    static const int simple_args[] = {0, 1, 10, 100};
+    for(unsigned i = 0; i < sizeof(simple_args)/sizeof(int); i++) {
+        char name[64];
+        _make_args_input(buf, sizeof(buf), "c000", simple_args[i]);
+        _set_input_str(buf);
+        snprintf(name, sizeof(name), "handle_command_simple/args=%d", simple_args[i]);
+        if(!_check_argc(name, _op_handle_command_simple, simple_args[i])) {
+            return 1;
+        }
+        _bench(_name(name), _op_handle_command_simple);
+    }
+    
+    // разбор JSON
+    _make_json_input(buf, sizeof(buf), "c000", 0, NULL);
+    _set_input_str(buf);
+    _bench(_name("handle_command_json/bare"), _op_handle_command_json);
+    _make_json_input(buf, sizeof(buf), "c000", 0, "42");
+    _set_input_str(buf);
+    _bench(_name("handle_command_json/id"), _op_handle_command_json);
+    static const int json_params[] = {10, 100};
+    for(unsigned i = 0; i < sizeof(json_params)/sizeof(int); i++) {
+        char name[64];
+        _make_json_input(buf, sizeof(buf), "c000", json_params[i], "42");
+        _set_input_str(buf);
+        snprintf(name, sizeof(name), "handle_command_json/params=%d", json_params[i]);
+        if(!_check_argc(name, _op_handle_command_json, json_params[i])) {
+            return 1;
+        }
+        _bench(_name(name), _op_handle_command_json);
+    }
+    
+    // оформление ответа
+    static char cmd_name[] = "c000";
+    static char cmd_arg[] = "a0";
+    _argv[0] = cmd_name;
+    _argv[1] = cmd_arg;
+    _argc = 2;
+    _bench(_name("wrap_reply_json"), _op_wrap_reply_json);
+    _set_input_str("ok");
+    _bench(_name("pack_reply_newline/short"), _op_pack_reply_newline);
+    memset(buf, 'x', 1000);
+    buf[1000] = 0;
+    _set_input_str(buf);
+    _bench(_name("pack_reply_newline/1000"), _op_pack_reply_newline);
+    
+    // обработчики входных данных целиком: распаковка, разбор, выполнение, упаковка
+    _set_input_str("c000 a0 a1\n");
+    _handler = handle_input_simple;
+    _bench(_name("handle_input_simple"), _op_handle_input);
+    
+    _make_json_input(buf, sizeof(buf), "c000", 2, "42");
+    strcat(buf, "\n");
+    _set_input_str(buf);
+    _handler = handle_input_json;
+    _bench(_name("handle_input_json"), _op_handle_input);
+    
+    strcpy(buf, "c000 a0 a1");
+    int len = pack_reply_cobs(buf, strlen(buf), sizeof(buf), babbler_cobs_get_crc());
+    _set_input(buf, len);
+    _handler = handle_input_simple_cobs;
+    _bench(_name("handle_input_simple_cobs"), _op_handle_input);
+    
+    _make_json_input(buf, sizeof(buf), "c000", 2, "42");
+    len = pack_reply_cobs(buf, strlen(buf), sizeof(buf), babbler_cobs_get_crc());
+    _set_input(buf, len);
+    _handler = handle_input_json_cobs;
+    _bench(_name("handle_input_json_cobs"), _op_handle_input);
+    
+    strcpy(buf, "c000 a0 a1");
+    len = pack_reply_len_prefix(buf, strlen(buf), sizeof(buf));
+    _set_input(buf, len);
+    _handler = handle_input_simple_len_prefix;
+    _bench(_name("handle_input_simple_len_prefix"), _op_handle_input);
+    
+    _make_json_input(buf, sizeof(buf), "c000", 2, "42");
+    len = pack_reply_len_prefix(buf, strlen(buf), sizeof(buf));
+    _set_input(buf, len);
+    _handler = handle_input_json_len_prefix;
+    _bench(_name("handle_input_json_len_prefix"), _op_handle_input);
+    
+    if(_out != NULL) {
+        fclose(_out);
+    }
+    return 0;
+}
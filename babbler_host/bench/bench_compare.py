@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+# Сравнить два файла с результатами замеров babbler_bench_N (--out):
+# показать изменения по каждому замеру и отметить ухудшения.
+# Код возврата 1, если есть ухудшения (удобно для CI).
+#
+# Compare two babbler_bench result files, mark regressions,
+# exit with code 1 if there are any.
+#
+#     python3 bench_compare.py old.jsonl new.jsonl [--threshold 10]
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line:
+                result = json.loads(line)
+                results[result["name"]] = result
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare babbler benchmark results")
+    parser.add_argument("old")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="time regression threshold, percent (default 10)")
+    args = parser.parse_args()
+
+    old = load(args.old)
+    new = load(args.new)
+
+    regressions = 0
+    print("%-48s %12s %12s %8s %14s %14s" % (
+        "benchmark", "old ns/op", "new ns/op", "change", "allocs/op", "B copied/op"))
+    for name in sorted(set(old) | set(new)):
+        if name not in old or name not in new:
+            print("%-48s %s" % (name, "only in " + (args.old if name in old else args.new)))
+            continue
+        o = old[name]
+        n = new[name]
+
+        change = (n["ns_per_op"] - o["ns_per_op"]) * 100.0 / o["ns_per_op"] if o["ns_per_op"] > 0 else 0.0
+        marks = []
+        # время шумит - ухудшение только больше порога;
+        # выделения и копирования считаются точно - любое увеличение
+        if change > args.threshold:
+            marks.append("SLOWER")
+        if n["allocs_per_op"] > o["allocs_per_op"]:
+            marks.append("MORE ALLOCS")
+        if n["bytes_copied_per_op"] > o["bytes_copied_per_op"]:
+            marks.append("MORE COPIES")
+        if marks:
+            regressions += 1
+
+        print("%-48s %12.1f %12.1f %+7.1f%% %6.2f->%-6.2f %6.0f->%-6.0f %s" % (
+            name, o["ns_per_op"], n["ns_per_op"], change,
+            o["allocs_per_op"], n["allocs_per_op"],
+            o["bytes_copied_per_op"], n["bytes_copied_per_op"],
+            " ".join(marks)))
+
+    if regressions:
+        print("\n%d regression(s)" % regressions)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
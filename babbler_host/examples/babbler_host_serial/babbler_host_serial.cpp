@@ -0,0 +1,186 @@
+/**
+ * Библиотека, собранная для Linux (см CMakeLists.txt): стандартный набор
+ * команд через модуль babbler_serial, порт Serial - stdin/stdout или
+ * псевдотерминал. Удобно для профилирования (perf, valgrind, санитайзеры).
+ *
+ * The library built for Linux: standard command set served by babbler_serial,
+ * Serial port is stdin/stdout or a pty. Handy for perf, valgrind, sanitizers.
+ *
+ * Запуск / run:
+ *     babbler_host_serial [--json] [--pty]
+ *
+ * Проверка / try:
+ *     printf 'ping\nhelp\n' | babbler_host_serial
+ *     babbler_host_serial --pty & screen /dev/pts/N
+ */
+
+#include "Arduino.h"
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_cmd_core.h"
+#include "babbler_cmd_devinfo.h"
+#include "babbler_serial.h"
+#include "babbler_footprint.h"
+
+#include <signal.h>
+
+// Размеры буферов для чтения команд и записи ответов
+// Read and write buffer size for communication modules
+#define SERIAL_READ_BUFFER_SIZE 128
+#define SERIAL_WRITE_BUFFER_SIZE 512
+
+// Буферы для обмена данными с компьютером через последовательный порт.
+// +1 байт в конце для завершающего нуля
+// Data exchange buffers to communicate with computer via serial port.
+// +1 extra byte at the end for terminating zero
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_read_buffer2[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+/** Зарегистрированные команды */
+/** Registered commands */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    CMD_HELP,
+    CMD_PING,
+    
+    // команды из babbler_cmd_devinfo.h
+    // commands from babbler_cmd_devinfo.h
+    CMD_NAME,
+    CMD_MODEL,
+    CMD_SERIAL_NUMBER,
+    CMD_DESCRIPTION,
+    CMD_VERSION,
+    CMD_MANUFACTURER,
+    CMD_URI,
+    CMD_DEVINFO,
+    
+#ifdef BABBLER_TRACE
+    // сборка с -DBABBLER_TRACE=ON (см CMakeLists.txt)
+    // build with -DBABBLER_TRACE=ON (see CMakeLists.txt)
+    CMD_TRACE,
+#endif
+#ifdef BABBLER_FOOTPRINT
+    // сборка с -DBABBLER_FOOTPRINT=ON (см CMakeLists.txt)
+    // build with -DBABBLER_FOOTPRINT=ON (see CMakeLists.txt)
+    CMD_FOOTPRINT
+#endif
+};
+
+/** Количество зарегистрированных команд */
+/** Number of registered commands*/
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+
+/** Руководства для зарегистрированных команд */
+/** Manuals for registered commands */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    MAN_HELP,
+    MAN_PING,
+    
+    // команды из babbler_cmd_devinfo.h
+    // commands from babbler_cmd_devinfo.h
+    MAN_NAME,
+    MAN_MODEL,
+    MAN_SERIAL_NUMBER,
+    MAN_DESCRIPTION,
+    MAN_VERSION,
+    MAN_MANUFACTURER,
+    MAN_URI,
+    MAN_DEVINFO,
+    
+#ifdef BABBLER_TRACE
+    MAN_TRACE,
+#endif
+#ifdef BABBLER_FOOTPRINT
+    MAN_FOOTPRINT
+#endif
+};
+
+/** Количество руководств для зарегистрированных команд */
+/** Number of manuals for registered commands */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+// Информация об устройстве для babbler_cmd_devinfo.h
+// Device info for babbler_cmd_devinfo.h
+const char* DEVICE_NAME = "Babbler host";
+const char* DEVICE_MODEL = "Linux host";
+const char* DEVICE_SERIAL_NUMBER = "00000001";
+const char* DEVICE_DESCRIPTION = "Babbler library built for Linux with Arduino Serial shim";
+const char* DEVICE_VERSION = "1.0";
+const char* DEVICE_MANUFACTURER = "sadr0b0t";
+const char* DEVICE_URI = "https://github.com/1i7/babbler_h";
+
+static volatile bool _running = true;
+
+static void _stop(int sig) {
+    _running = false;
+}
+
+int main(int argc, char* argv[]) {
+    signal(SIGINT, _stop);
+    signal(SIGTERM, _stop);
+    
+    // ответы команд devinfo - один раз, до первой команды
+    // build devinfo replies once, before the first command
+    babbler_devinfo_setup();
+    
+    // по умолчанию - простые текстовые команды с переносом строки
+    // simple newline-separated text commands by default
+    babbler_serial_set_packet_filter(packet_filter_newline);
+    babbler_serial_set_input_handler(handle_input_simple);
+    babbler_serial_set_error_handler(handle_input_error_simple);
+    
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--json") == 0) {
+            babbler_serial_set_input_handler(handle_input_json);
+            babbler_serial_set_error_handler(handle_input_error_json);
+        } else if(strcmp(argv[i], "--pty") == 0) {
+            char slave_name[64];
+            if(Serial.openPty(slave_name, sizeof(slave_name)) < 0) {
+                perror("openPty");
+                return 1;
+            }
+            fprintf(stderr, "Serving pty %s\n", slave_name);
+        } else {
+            fprintf(stderr, "Usage: %s [--json] [--pty]\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    // без --pty порт Serial работает через stdin/stdout
+    // Serial port uses stdin/stdout without --pty
+    babbler_serial_setup(
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE,
+        9600);
+    babbler_serial_set_double_buffer(serial_read_buffer2);
+    
+#ifdef BABBLER_TRACE
+    // время в журнале команд - в микросекундах
+    // command trace time is in microseconds
+    babbler_set_trace_clock(&micros);
+#endif
+    
+    while(_running) {
+        // выполняем команды, пока данных нет - спим в poll
+        // execute commands, sleep in poll while there is no input
+        unsigned long timeout = babbler_serial_tasks();
+        if(timeout == BABBLER_SERIAL_IDLE_FOREVER && Serial.eof()) {
+            // stdin закончился, все ответы отправлены
+            // stdin is over, all replies are sent
+            break;
+        }
+        // ждем не дольше 100мс, чтобы заметить сигнал остановки
+        // wait no longer than 100ms to notice stop signal
+        babbler_serial_idle(timeout > 100 ? 100 : timeout);
+    }
+    
+    Serial.end();
+    return 0;
+}
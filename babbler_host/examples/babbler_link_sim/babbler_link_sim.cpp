@@ -0,0 +1,438 @@
+/**
+ * Модель последовательной линии: клиент отправляет запросы устройству
+ * (модуль babbler_serial) через линию с заданной скоростью, FIFO, задержкой,
+ * разбросом задержки и потерями; программа работает в виртуальном времени
+ * и выводит распределение времени от отправки запроса до получения ответа.
+ *
+ * Serial link simulation: a client sends requests to the device (babbler_serial)
+ * over a link with given baud rate, FIFO depth, latency, jitter and drops,
+ * in virtual time, and prints the request round-trip time distribution.
+ *
+ * Запуск / run:
+ *     babbler_link_sim [--baud 115200] [--rx-fifo 64] [--tx-fifo 64]
+ *         [--latency US] [--jitter US] [--drop RATE] [--seed N]
+ *         [--requests 1000] [--pipeline 1] [--mix ping=3,version=1]
+ *         [--json] [--len-prefix] [--no-packet-filter] [--rx-queue FRAMES]
+ *         [--timeout MS] [--cpu-scale X]
+ *
+ *     --pipeline - сколько запросов клиент держит без ответа
+ *         (how many requests the client keeps in flight)
+ *     --cpu-scale - во сколько раз процессор устройства медленнее этой машины
+ *         (0 - команды выполняются мгновенно, результат полностью воспроизводим)
+ *         (how much slower device CPU is than this machine, 0 - instant)
+ *
+ * Клиент делит ответы по '\n' (или по заголовку для --len-prefix), поэтому
+ * многострочные ответы (help) без --json собьют сопоставление запросов.
+ * Client splits replies by '\n', so multi-line replies (help) need --json.
+ */
+
+#include "Arduino.h"
+#include "babbler_host.h"
+#include "babbler_link_sim.h"
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_len_prefix.h"
+#include "babbler_cmd_core.h"
+#include "babbler_cmd_devinfo.h"
+#include "babbler_serial.h"
+
+#include <time.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+
+#define SERIAL_READ_BUFFER_SIZE 128
+#define SERIAL_WRITE_BUFFER_SIZE 512
+
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+char serial_rx_queue[BABBLER_SERIAL_RX_QUEUE_SIZE(SERIAL_READ_BUFFER_SIZE, BABBLER_SERIAL_RX_QUEUE_MAX)];
+
+/** Канал устройства на модели линии */
+babbler_serial_t sim_port;
+
+/** Зарегистрированные команды */
+/** Registered commands */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    CMD_HELP,
+    CMD_PING,
+    
+    // команды из babbler_cmd_devinfo.h
+    // commands from babbler_cmd_devinfo.h
+    CMD_NAME,
+    CMD_MODEL,
+    CMD_SERIAL_NUMBER,
+    CMD_DESCRIPTION,
+    CMD_VERSION,
+    CMD_MANUFACTURER,
+    CMD_URI,
+    CMD_DEVINFO
+};
+
+/** Количество зарегистрированных команд */
+/** Number of registered commands*/
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+/** Руководства для зарегистрированных команд */
+/** Manuals for registered commands */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_HELP,
+    MAN_PING,
+    MAN_NAME,
+    MAN_MODEL,
+    MAN_SERIAL_NUMBER,
+    MAN_DESCRIPTION,
+    MAN_VERSION,
+    MAN_MANUFACTURER,
+    MAN_URI,
+    MAN_DEVINFO
+};
+
+/** Количество руководств для зарегистрированных команд */
+/** Number of manuals for registered commands */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+// Информация об устройстве для babbler_cmd_devinfo.h
+// Device info for babbler_cmd_devinfo.h
+const char* DEVICE_NAME = "Babbler link simulator";
+const char* DEVICE_MODEL = "Simulated device";
+const char* DEVICE_SERIAL_NUMBER = "00000001";
+const char* DEVICE_DESCRIPTION = "Babbler device on a simulated serial link";
+const char* DEVICE_VERSION = "1.0";
+const char* DEVICE_MANUFACTURER = "sadr0b0t";
+const char* DEVICE_URI = "https://github.com/1i7/babbler_h";
+
+/** Команда в смеси запросов с весом */
+typedef struct {
+    std::string cmd;
+    int weight;
+} _mix_entry_t;
+
+/** Запрос, на который еще не пришел ответ */
+typedef struct {
+    unsigned long id;
+    uint64_t sent_us;
+} _request_t;
+
+static uint64_t _real_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Разобрать смесь команд вида "ping=3,version=1".
+ */
+static bool _parse_mix(const char* str, std::vector<_mix_entry_t>* mix) {
+    mix->clear();
+    std::string s(str);
+    size_t pos = 0;
+    while(pos < s.size()) {
+        size_t end = s.find(',', pos);
+        if(end == std::string::npos) {
+            end = s.size();
+        }
+        std::string item = s.substr(pos, end - pos);
+        size_t eq = item.find('=');
+        _mix_entry_t entry;
+        entry.cmd = item.substr(0, eq);
+        entry.weight = eq == std::string::npos ? 1 : atoi(item.c_str() + eq + 1);
+        if(entry.cmd.empty() || entry.weight <= 0) {
+            return false;
+        }
+        mix->push_back(entry);
+        pos = end + 1;
+    }
+    return !mix->empty();
+}
+
+static uint64_t _percentile(const std::vector<uint64_t>& sorted, double p) {
+    if(sorted.empty()) {
+        return 0;
+    }
+    size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+int main(int argc, char* argv[]) {
+    babbler_link_sim_config_t config = babbler_link_sim_default_config();
+    unsigned long requests = 1000;
+    unsigned int pipeline = 1;
+    bool json = false;
+    bool len_prefix = false;
+    bool no_packet_filter = false;
+    int rx_queue = 1;
+    unsigned long timeout_ms = 1000;
+    double cpu_scale = 0;
+    std::vector<_mix_entry_t> mix;
+    _parse_mix("ping", &mix);
+    
+    for(int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        if(strcmp(arg, "--json") == 0) {
+            json = true;
+        } else if(strcmp(arg, "--len-prefix") == 0) {
+            len_prefix = true;
+        } else if(strcmp(arg, "--no-packet-filter") == 0) {
+            no_packet_filter = true;
+        } else if(val == NULL) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 1;
+        } else if(strcmp(arg, "--baud") == 0) {
+            config.baud = atol(argv[++i]);
+        } else if(strcmp(arg, "--rx-fifo") == 0) {
+            config.rx_fifo = atoi(argv[++i]);
+        } else if(strcmp(arg, "--tx-fifo") == 0) {
+            config.tx_fifo = atoi(argv[++i]);
+        } else if(strcmp(arg, "--latency") == 0) {
+            config.latency_us = atol(argv[++i]);
+        } else if(strcmp(arg, "--jitter") == 0) {
+            config.jitter_us = atol(argv[++i]);
+        } else if(strcmp(arg, "--drop") == 0) {
+            config.drop_rate = atof(argv[++i]);
+        } else if(strcmp(arg, "--seed") == 0) {
+            config.seed = atol(argv[++i]);
+        } else if(strcmp(arg, "--requests") == 0) {
+            requests = atol(argv[++i]);
+        } else if(strcmp(arg, "--pipeline") == 0) {
+            pipeline = atoi(argv[++i]);
+        } else if(strcmp(arg, "--mix") == 0) {
+            if(!_parse_mix(argv[++i], &mix)) {
+                fprintf(stderr, "Bad command mix: %s\n", argv[i]);
+                return 1;
+            }
+        } else if(strcmp(arg, "--rx-queue") == 0) {
+            rx_queue = atoi(argv[++i]);
+        } else if(strcmp(arg, "--timeout") == 0) {
+            timeout_ms = atol(argv[++i]);
+        } else if(strcmp(arg, "--cpu-scale") == 0) {
+            cpu_scale = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option %s, see source header for usage\n", arg);
+            return 1;
+        }
+    }
+    if(config.baud <= 0 || config.rx_fifo <= 0 || config.tx_fifo <= 0 || pipeline == 0 ||
+            rx_queue < 1 || rx_queue > BABBLER_SERIAL_RX_QUEUE_MAX || (len_prefix && no_packet_filter)) {
+        fprintf(stderr, "Bad options\n");
+        return 1;
+    }
+    
+    babbler_host_set_virtual_time(true);
+    
+    // ответы команд devinfo - один раз, до первой команды
+    // build devinfo replies once, before the first command
+    babbler_devinfo_setup();
+    
+    // устройство
+    // device
+    LinkSimSerial link(config);
+    babbler_serial_t& port = sim_port;
+    babbler_serial_port_setup(&port, link,
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE);
+    if(len_prefix) {
+        babbler_serial_port_set_packet_filter(&port, packet_filter_len_prefix);
+        babbler_serial_port_set_packet_size_hint(&port, packet_size_len_prefix);
+        babbler_serial_port_set_input_handler(&port,
+            json ? handle_input_json_len_prefix : handle_input_simple_len_prefix);
+        babbler_serial_port_set_error_handler(&port,
+            json ? handle_input_error_json_len_prefix : handle_input_error_simple_len_prefix);
+    } else {
+        babbler_serial_port_set_packet_filter(&port, no_packet_filter ? NULL : packet_filter_newline);
+        babbler_serial_port_set_packet_size_hint(&port, NULL);
+        babbler_serial_port_set_input_handler(&port, json ? handle_input_json : handle_input_simple);
+        babbler_serial_port_set_error_handler(&port, json ? handle_input_error_json : handle_input_error_simple);
+    }
+    if(rx_queue > 1) {
+        babbler_serial_port_set_rx_queue(&port, serial_rx_queue, rx_queue);
+    }
+    
+    // клиент
+    // client
+    int mix_total = 0;
+    for(size_t m = 0; m < mix.size(); m++) {
+        mix_total += mix[m].weight;
+    }
+    uint32_t mix_random = config.seed * 2654435761u + 1;
+    
+    std::deque<_request_t> inflight;
+    std::vector<uint64_t> rtts;
+    std::string client_rx;
+    unsigned long sent = 0;
+    unsigned long lost = 0;
+    uint64_t timeout_us = (uint64_t)timeout_ms * 1000;
+    uint64_t start_us = babbler_host_time_us();
+    uint64_t cpu_ns = 0;
+    
+    while(rtts.size() + lost < requests) {
+        uint64_t now = babbler_host_time_us();
+        
+        // отправляем запросы, пока их в работе меньше pipeline
+        // send requests while less than pipeline are in flight
+        while(inflight.size() < pipeline && sent < requests) {
+            mix_random = mix_random * 1103515245u + 12345u;
+            int pick = (mix_random >> 8) % mix_total;
+            size_t m = 0;
+            while(pick >= mix[m].weight) {
+                pick -= mix[m].weight;
+                m++;
+            }
+            
+            char request[SERIAL_READ_BUFFER_SIZE + LEN_PREFIX_HEADER_SIZE];
+            int request_len;
+            if(json) {
+                request_len = snprintf(request, sizeof(request),
+                    "{\"cmd\":\"%s\",\"id\":\"%lu\"}", mix[m].cmd.c_str(), sent);
+            } else {
+                request_len = snprintf(request, sizeof(request), "%s", mix[m].cmd.c_str());
+            }
+            if(len_prefix) {
+                request_len = pack_reply_len_prefix(request, request_len, sizeof(request));
+            } else if(!no_packet_filter) {
+                request[request_len++] = '\n';
+            }
+            link.clientWrite(request, request_len);
+            
+            _request_t req;
+            req.id = sent;
+            req.sent_us = now;
+            inflight.push_back(req);
+            sent++;
+        }
+        
+        // устройство
+        // device
+        uint64_t cpu_start = _real_ns();
+        unsigned long device_timeout = babbler_serial_port_tasks(&port);
+        uint64_t cpu = _real_ns() - cpu_start;
+        cpu_ns += cpu;
+        if(cpu_scale > 0) {
+            babbler_host_advance_time((uint64_t)(cpu * cpu_scale / 1000));
+        }
+        
+        // клиент принимает ответы: JSON сопоставляем по id, остальные - по порядку
+        // client receives replies: JSON matched by id, others in order
+        char buf[256];
+        int len;
+        while((len = link.clientRead(buf, sizeof(buf))) > 0) {
+            client_rx.append(buf, len);
+        }
+        now = babbler_host_time_us();
+        while(true) {
+            std::string reply;
+            if(len_prefix) {
+                long size = packet_size_len_prefix((char*)client_rx.data(), client_rx.size());
+                if(size < 0 || (size_t)size > client_rx.size()) {
+                    break;
+                }
+                reply = client_rx.substr(LEN_PREFIX_HEADER_SIZE, size - LEN_PREFIX_HEADER_SIZE);
+                client_rx.erase(0, size);
+            } else {
+                size_t nl = client_rx.find('\n');
+                if(nl == std::string::npos) {
+                    break;
+                }
+                reply = client_rx.substr(0, nl);
+                client_rx.erase(0, nl + 1);
+            }
+            
+            std::deque<_request_t>::iterator req = inflight.begin();
+            if(json) {
+                size_t id_pos = reply.find("\"id\":\"");
+                unsigned long id = id_pos == std::string::npos ?
+                    (unsigned long)-1 : strtoul(reply.c_str() + id_pos + 6, NULL, 10);
+                while(req != inflight.end() && req->id != id) {
+                    req++;
+                }
+            }
+            if(req != inflight.end()) {
+                rtts.push_back(now - req->sent_us);
+                inflight.erase(req);
+            }
+        }
+        
+        // запросы без ответа дольше timeout считаем потерянными
+        // requests without reply for longer than timeout are lost
+        while(!inflight.empty() && now - inflight.front().sent_us >= timeout_us) {
+            inflight.pop_front();
+            lost++;
+        }
+        
+        if(device_timeout == 0) {
+            // устройству есть чем заняться - сразу следующий круг
+            // device has work to do - next round right away
+            continue;
+        }
+        
+        // пропускаем время до ближайшего события
+        // skip time to the next event
+        uint64_t next = link.nextEventUs();
+        if(!inflight.empty() && inflight.front().sent_us + timeout_us < next) {
+            next = inflight.front().sent_us + timeout_us;
+        }
+        if(device_timeout != BABBLER_SERIAL_IDLE_FOREVER && now + device_timeout * 1000 < next) {
+            next = now + (uint64_t)device_timeout * 1000;
+        }
+        if(next == UINT64_MAX) {
+            if(inflight.empty() && sent >= requests) {
+                break;
+            }
+            next = now + 1;
+        }
+        babbler_host_advance_time(next > now ? next - now : 1);
+    }
+    
+    uint64_t elapsed_us = babbler_host_time_us() - start_us;
+    std::sort(rtts.begin(), rtts.end());
+    uint64_t sum = 0;
+    for(size_t i = 0; i < rtts.size(); i++) {
+        sum += rtts[i];
+    }
+    
+    printf("link: %ld baud, rx fifo %d, tx fifo %d, latency %u us, jitter %u us, drop %g\n",
+        config.baud, config.rx_fifo, config.tx_fifo, config.latency_us, config.jitter_us, config.drop_rate);
+    printf("requests: %lu sent, %lu replied, %lu lost (timeout %lu ms), pipeline %u\n",
+        sent, (unsigned long)rtts.size(), lost, timeout_ms, pipeline);
+    printf("link errors: %lu bytes dropped, %lu rx fifo overruns, %lu oversized packets\n",
+        link.dropped(), link.overruns(), babbler_serial_port_overflow_count(&port));
+    printf("virtual time: %.3f s, throughput %.1f req/s, device cpu (host) %.3f ms\n",
+        elapsed_us / 1e6, elapsed_us > 0 ? rtts.size() * 1e6 / elapsed_us : 0.0, cpu_ns / 1e6);
+    if(!rtts.empty()) {
+        printf("round trip, us: min %llu  p50 %llu  p90 %llu  p99 %llu  max %llu  mean %.1f\n",
+            (unsigned long long)rtts.front(),
+            (unsigned long long)_percentile(rtts, 50),
+            (unsigned long long)_percentile(rtts, 90),
+            (unsigned long long)_percentile(rtts, 99),
+            (unsigned long long)rtts.back(),
+            (double)sum / rtts.size());
+        
+        // гистограмма по степеням двойки
+        // power-of-two histogram
+        printf("histogram:\n");
+        size_t i = 0;
+        uint64_t bucket = 1;
+        while(i < rtts.size()) {
+            size_t count = 0;
+            while(i < rtts.size() && rtts[i] < bucket * 2) {
+                count++;
+                i++;
+            }
+            if(count > 0) {
+                int bar = (int)(count * 50 / rtts.size());
+                printf("  %8llu..%-8llu us %7lu %.*s\n",
+                    (unsigned long long)bucket, (unsigned long long)(bucket * 2 - 1),
+                    (unsigned long)count, bar > 0 ? bar : 1,
+                    "##################################################");
+            }
+            bucket *= 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# Статический расход памяти и флеша по модулям: размеры секций (size -A)
+# объектных файлов и библиотек (.o, .a) - с учетом безымянных строковых
+# констант (тексты руководств, ответы); --symbols добавит самые большие
+# символы (nm).
+# Для AVR: объектные файлы из папки сборки Arduino (Файл > Настройки >
+# подробный вывод покажет путь), avr-size и avr-nm; константы без PROGMEM (.rodata)
+# на AVR копируются в RAM, поэтому с --avr считаются и в RAM, и во флеше.
+# Размеры до сборки мусора компоновщиком (--gc-sections): функции, которые
+# нигде не вызываются, в прошивку не попадут. Для файлов, собранных с -flto,
+# size и nm размеров не видят - пересобрать с -fno-lto.
+#
+# Per-module static RAM/flash report from section sizes (size -A) of object
+# files and archives, biggest symbols from nm. With --avr .rodata counts
+# as RAM too (AVR copies it to RAM unless PROGMEM). Sizes are before linker garbage collection.
+#
+#     python3 footprint_report.py build/libbabbler.a build/libbabbler_host.a
+#     python3 footprint_report.py --avr --size avr-size --nm avr-nm /tmp/arduino_build_*/libraries/babbler_h/*.o
+#     python3 footprint_report.py --symbols 20 build/libbabbler.a
+
+import argparse
+import os
+import subprocess
+import sys
+
+
+# тип символа nm -> секция
+SECTIONS = {
+    "t": "text", "w": "text", "v": "data",
+    "r": "rodata",
+    "d": "data", "g": "data",
+    "b": "bss", "s": "bss", "c": "bss",
+}
+
+
+def module_name(name):
+    name = os.path.basename(name)
+    for ext in (".o", ".obj"):
+        if name.endswith(ext):
+            name = name[:-len(ext)]
+    for ext in (".cpp", ".c", ".cc", ".ino"):
+        if name.endswith(ext):
+            name = name[:-len(ext)]
+    return name
+
+
+def section_kind(name):
+    """Секция объектного файла -> text, rodata, data, bss или None (отладка и т.п.)."""
+    for prefix, kind in ((".text", "text"), (".progmem", "text"), (".init", "text"), (".fini", "text"),
+                         (".rodata", "rodata"), (".data", "data"), (".bss", "bss"), (".noinit", "bss")):
+        if name == prefix or name.startswith(prefix + "."):
+            return kind
+    return None
+
+
+def read_sections(size, path):
+    """Размеры секций (модуль, секция, размер) из файла path."""
+    out = subprocess.run([size, "-A", "-d", path],
+                         stdout=subprocess.PIPE, universal_newlines=True, check=True).stdout
+    module = module_name(path)
+    for line in out.splitlines():
+        parts = line.split()
+        if not parts:
+            continue
+        # в архивах перед секциями каждого модуля строка "имя.o   (ex libname.a):"
+        if line.endswith(":"):
+            module = module_name(parts[0].rstrip(":"))
+            continue
+        if len(parts) >= 2 and parts[1].isdigit():
+            kind = section_kind(parts[0])
+            if kind is not None:
+                yield module, kind, int(parts[1])
+
+
+def read_symbols(nm, path):
+    """Символы (модуль, секция, размер, имя) из файла path."""
+    out = subprocess.run([nm, "-S", "-C", "-t", "d", path],
+                         stdout=subprocess.PIPE, universal_newlines=True, check=True).stdout
+    module = module_name(path)
+    for line in out.splitlines():
+        line = line.rstrip()
+        if not line:
+            continue
+        # в архивах перед символами каждого модуля строка "имя.o:"
+        if line.endswith(":") and " " not in line:
+            module = module_name(line[:-1])
+            continue
+        parts = line.split(None, 3)
+        if len(parts) < 4 or not parts[1].isdigit():
+            # без размера: неопределенные символы и метки
+            continue
+        section = SECTIONS.get(parts[2].lower())
+        if section is None:
+            continue
+        yield module, section, int(parts[1]), parts[3]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-module static RAM and flash footprint")
+    parser.add_argument("files", nargs="+", help="object files or static libraries")
+    parser.add_argument("--size", default="size", help="size program (avr-size, arm-none-eabi-size)")
+    parser.add_argument("--nm", default="nm", help="nm program (avr-nm, arm-none-eabi-nm)")
+    parser.add_argument("--avr", action="store_true", help="count .rodata as RAM (AVR without PROGMEM)")
+    parser.add_argument("--symbols", type=int, default=0, help="also list N biggest symbols")
+    args = parser.parse_args()
+
+    modules = {}
+    symbols = []
+    for path in args.files:
+        for module, section, size in read_sections(args.size, path):
+            sizes = modules.setdefault(module, {"text": 0, "rodata": 0, "data": 0, "bss": 0})
+            sizes[section] += size
+        if args.symbols > 0:
+            symbols.extend((size, section, module, name)
+                           for module, section, size, name in read_symbols(args.nm, path))
+
+    def ram(s):
+        return s["data"] + s["bss"] + (s["rodata"] if args.avr else 0)
+
+    def flash(s):
+        # начальные значения .data хранятся во флеше
+        return s["text"] + s["rodata"] + s["data"]
+
+    print("%-28s %8s %8s %8s %8s %9s %9s" % ("module", "text", "rodata", "data", "bss", "flash", "RAM"))
+    total = {"text": 0, "rodata": 0, "data": 0, "bss": 0}
+    for module in sorted(modules, key=lambda m: -ram(modules[m]) * 65536 - flash(modules[m])):
+        s = modules[module]
+        for k in total:
+            total[k] += s[k]
+        print("%-28s %8d %8d %8d %8d %9d %9d" % (
+            module, s["text"], s["rodata"], s["data"], s["bss"], flash(s), ram(s)))
+    print("%-28s %8d %8d %8d %8d %9d %9d" % (
+        "total", total["text"], total["rodata"], total["data"], total["bss"], flash(total), ram(total)))
+
+    if args.symbols > 0:
+        print("\n%8s %-7s %-24s %s" % ("size", "section", "module", "symbol"))
+        for size, section, module, name in sorted(symbols, reverse=True)[:args.symbols]:
+            print("%8d %-7s %-24s %s" % (size, section, module, name))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
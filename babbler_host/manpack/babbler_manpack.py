@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+# Сжать руководства команд для BABBLER_PACKED_MANUALS (см babbler_manpack.h):
+# из текстового файла с руководствами получить заголовок с готовыми
+# babbler_man_t MAN_* и общим словарем. Сжатие - статический словарь частых
+# подстрок: байт 0x80..0xFE - ссылка на строку словаря, 0xFF - следующий
+# байт как есть, остальные байты - сами символы. Распаковка не требует
+# буфера-окна: символы сразу пишутся в буфер ответа.
+# Все руководства прошивки сжимать одним запуском: словарь общий,
+# заголовок подключать в один файл скетча. Кроме MAN_* заголовок объявляет
+# имена команд NAME_* во флеше - для полей babbler_cmd_t.name.
+#
+# Pack command manuals for BABBLER_PACKED_MANUALS: reads a manuals text
+# file, writes a header with babbler_man_t MAN_* entries and the shared
+# static dictionary (0x80..0xFE - dictionary reference, 0xFF - escape).
+# Pack all manuals of a firmware in one run, include the header once.
+# The header also defines NAME_* command names for babbler_cmd_t.name.
+#
+#     python3 babbler_manpack.py manuals.man -o manuals_packed.h
+#
+# Формат файла руководств / manuals file format:
+#
+#     # комментарий / comment
+#     @ledon turn led ON
+#     SYNOPSIS
+#         ledon
+#     DESCRIPTION
+#     Turn led ON.
+#     @ledoff turn led OFF
+#     ...
+#
+# Строка "@имя краткое описание" начинает руководство команды, следующие
+# строки до следующей "@" - текст руководства (пустые строки в конце
+# отбрасываются), строки с "#" в начале - комментарии.
+
+import argparse
+import re
+import sys
+from collections import Counter
+
+# совпадает с babbler_manpack.h
+MARKER = 0x01
+DICT_FIRST = 0x80
+ESCAPE = 0xFF
+DICT_MAX = ESCAPE - DICT_FIRST
+
+MIN_WORD = 2
+MAX_WORD = 24
+
+
+def parse(path):
+    """Список (имя, краткое описание, текст руководства)."""
+    manuals = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.rstrip("\r\n")
+            if line.startswith("@"):
+                head = line[1:].split(None, 1)
+                if not head:
+                    raise ValueError("%s: empty command name" % path)
+                manuals.append([head[0], head[1] if len(head) > 1 else "", []])
+            elif line.startswith("#"):
+                continue
+            elif manuals:
+                manuals[-1][2].append(line)
+            elif line.strip():
+                raise ValueError("%s: text before first @command line" % path)
+    result = []
+    for name, descr, lines in manuals:
+        while lines and not lines[-1].strip():
+            lines.pop()
+        result.append((name, descr, "\n".join(lines).encode("utf-8")))
+    return result
+
+
+def literal_runs(tokens):
+    """Участки без ссылок на словарь (словарь не вложенный)."""
+    run = []
+    for t in tokens:
+        if t < 256:
+            run.append(t)
+        else:
+            if run:
+                yield bytes(run)
+            run = []
+    if run:
+        yield bytes(run)
+
+
+def cost(b):
+    """Сколько байт займет символ в сжатом виде."""
+    return 2 if b >= DICT_FIRST or b == MARKER else 1
+
+
+def build_dict(texts):
+    """Жадно выбрать до DICT_MAX подстрок с наибольшей экономией."""
+    # тексты - списки токенов: <256 - байт, >=256 - ссылка на словарь
+    texts = [list(t) for t in texts]
+    words = []
+    while len(words) < DICT_MAX:
+        counts = Counter()
+        for tokens in texts:
+            for run in literal_runs(tokens):
+                for n in range(MIN_WORD, min(MAX_WORD, len(run)) + 1):
+                    for i in range(len(run) - n + 1):
+                        counts[run[i:i + n]] += 1
+        best = None
+        best_gain = 0
+        for word, count in counts.items():
+            if count < 2:
+                continue
+            size = sum(cost(b) for b in word)
+            # выигрыш: (размер - 1 байт ссылки) на каждое вхождение
+            # минус сама строка и 2 байта индекса в словаре
+            gain = count * (size - 1) - len(word) - 2
+            if gain > best_gain:
+                best, best_gain = word, gain
+        if best is None:
+            break
+        code = 256 + len(words)
+        words.append(best)
+        texts = [replace(tokens, best, code) for tokens in texts]
+    return words, texts
+
+
+def replace(tokens, word, code):
+    out = []
+    i = 0
+    n = len(word)
+    while i < len(tokens):
+        if tokens[i:i + n] == list(word):
+            out.append(code)
+            i += n
+        else:
+            out.append(tokens[i])
+            i += 1
+    return out
+
+
+def encode(tokens):
+    out = bytearray([MARKER])
+    for t in tokens:
+        if t >= 256:
+            out.append(DICT_FIRST + t - 256)
+        elif t >= DICT_FIRST or t == MARKER:
+            out += bytes([ESCAPE, t])
+        else:
+            out.append(t)
+    return bytes(out)
+
+
+def decode(packed, words):
+    """Распаковка как в babbler_man_unpack - для проверки."""
+    assert packed[0] == MARKER
+    out = bytearray()
+    i = 1
+    while i < len(packed):
+        c = packed[i]
+        i += 1
+        if c == ESCAPE:
+            out.append(packed[i])
+            i += 1
+        elif c >= DICT_FIRST:
+            out += words[c - DICT_FIRST]
+        else:
+            out.append(c)
+    return bytes(out)
+
+
+def c_string(data, indent="    "):
+    """Строка C (несколько строк по ~70 символов), восьмеричные escape для байт не ASCII."""
+    parts = []
+    cur = ""
+    for b in data:
+        ch = chr(b)
+        if ch == "\n":
+            cur += "\\n"
+            parts.append(cur)
+            cur = ""
+            continue
+        if ch in "\"\\?":
+            cur += "\\" + ch
+        elif 0x20 <= b < 0x7F:
+            cur += ch
+        else:
+            cur += "\\%03o" % b
+        if len(cur) >= 70:
+            parts.append(cur)
+            cur = ""
+    if cur or not parts:
+        parts.append(cur)
+    return "\n".join('%s"%s"' % (indent, p) for p in parts)
+
+
+def c_ident(name):
+    return re.sub(r"[^A-Za-z0-9_]", "_", name).upper()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack babbler command manuals")
+    parser.add_argument("manuals", help="manuals text file")
+    parser.add_argument("-o", "--output", help="output header (default stdout)")
+    args = parser.parse_args()
+
+    manuals = parse(args.manuals)
+    if not manuals:
+        sys.exit("%s: no manuals" % args.manuals)
+    words, texts = build_dict([m[2] for m in manuals])
+    packed = [encode(t) for t in texts]
+    for (name, descr, text), data in zip(manuals, packed):
+        if decode(data, words) != text:
+            sys.exit("internal error: %s does not unpack back" % name)
+
+    plain_size = sum(len(m[2]) + 1 for m in manuals)
+    dict_size = sum(len(w) for w in words) + 2 * (len(words) + 1)
+    packed_size = sum(len(p) + 1 for p in packed) + dict_size
+
+    out = []
+    out.append("// Сгенерировано babbler_manpack.py из %s, не редактировать." % args.manuals)
+    out.append("// Generated by babbler_manpack.py from %s, do not edit." % args.manuals)
+    out.append("// %d manuals: %d bytes plain, %d bytes packed (dictionary %d bytes, %d words)"
+               % (len(manuals), plain_size, packed_size, dict_size, len(words)))
+    out.append("")
+    out.append("#include \"babbler.h\"")
+    out.append("#include \"babbler_manpack.h\"")
+    out.append("")
+    out.append("#ifndef BABBLER_PACKED_MANUALS")
+    out.append("#error \"Enable BABBLER_PACKED_MANUALS in babbler_lib_config.h\"")
+    out.append("#endif")
+    out.append("")
+    out.append("// словарь: строки подряд и смещения, где начинается каждая")
+    out.append("// dictionary: strings one after another and their offsets")
+    offsets = [0]
+    for w in words:
+        offsets.append(offsets[-1] + len(w))
+    out.append("extern const uint16_t BABBLER_MAN_DICT_INDEX[] BABBLER_FLASH = {")
+    for i in range(0, len(offsets), 12):
+        out.append("    " + ", ".join(str(o) for o in offsets[i:i + 12]) + ",")
+    out.append("};")
+    out.append("extern const char BABBLER_MAN_DICT[] BABBLER_FLASH = ")
+    out.append(c_string(b"".join(words)) + ";")
+    for (name, descr, text), data in zip(manuals, packed):
+        ident = c_ident(name)
+        out.append("")
+        out.append("const char NAME_%s[] BABBLER_FLASH = %s;" % (ident, c_string(name.encode("utf-8"), "").strip()))
+        out.append("static const char _descr_%s[] BABBLER_FLASH = %s;" % (ident.lower(), c_string(descr.encode("utf-8"), "").strip()))
+        out.append("static const char _man_%s[] BABBLER_FLASH = " % ident.lower())
+        out.append(c_string(data) + ";")
+        out.append("const babbler_man_t MAN_%s = {" % ident)
+        out.append("    NAME_%s," % ident)
+        out.append("    _descr_%s," % ident.lower())
+        out.append("    _man_%s" % ident.lower())
+        out.append("};")
+    text = "\n".join(out) + "\n"
+
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+    sys.stderr.write("%d manuals: %d bytes plain, %d bytes packed\n" % (len(manuals), plain_size, packed_size))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,50 @@
+#ifndef BABBLER_HOST_PGMSPACE_H
+#define BABBLER_HOST_PGMSPACE_H
+
+// Замена avr/pgmspace.h для сборки под Linux с BABBLER_PROGMEM: строки
+// PROGMEM попадают в отдельную секцию babbler_progmem, а функции *_P
+// проверяют, что им передали адрес из этой секции. Так обычная строка
+// в RAM вместо BABBLER_FLASH (на AVR - мусор из флеша по тому же адресу)
+// сразу останавливает программу с сообщением.
+//
+// avr/pgmspace.h replacement for the Linux build with BABBLER_PROGMEM:
+// PROGMEM data goes to the babbler_progmem section and *_P functions abort
+// when given an address outside of it (a RAM string would read garbage
+// from flash on AVR).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM __attribute__((section("babbler_progmem"), used))
+
+// границы секции, их задает компоновщик
+extern "C" const char __start_babbler_progmem[] __attribute__((weak));
+extern "C" const char __stop_babbler_progmem[] __attribute__((weak));
+
+static inline const char* _pgm_check(const void* ptr) {
+    const char* p = (const char*)ptr;
+    if(p < __start_babbler_progmem || p >= __stop_babbler_progmem) {
+        fprintf(stderr, "pgmspace: %p is not a PROGMEM address\n", ptr);
+        abort();
+    }
+    return p;
+}
+
+#define PSTR(s) (__extension__({static const char __c[] PROGMEM = (s); &__c[0];}))
+
+#define pgm_read_byte(addr) (*(const uint8_t*)_pgm_check(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)_pgm_check(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)_pgm_check(addr))
+#define pgm_read_ptr(addr) (*(void* const*)_pgm_check(addr))
+
+#define strcmp_P(str, pstr) strcmp(str, _pgm_check(pstr))
+#define strncmp_P(str, pstr, n) strncmp(str, _pgm_check(pstr), n)
+#define strcpy_P(dst, pstr) strcpy(dst, _pgm_check(pstr))
+#define strncpy_P(dst, pstr, n) strncpy(dst, _pgm_check(pstr), n)
+#define strcat_P(dst, pstr) strcat(dst, _pgm_check(pstr))
+#define strlen_P(pstr) strlen(_pgm_check(pstr))
+#define memcpy_P(dst, psrc, n) memcpy(dst, _pgm_check(psrc), n)
+
+#endif // BABBLER_HOST_PGMSPACE_H
@@ -0,0 +1,137 @@
+// Отложенная команда вне babbler_serial (обработчик входных данных вызван
+// напрямую, как в babbler_posix) отвечает ошибкой и не занимает ячейку;
+// через канал babbler_serial в формате JSON ответ приходит позже, как обычно;
+// в формате без id (handle_input_simple) и с id, который не помещается
+// в BABBLER_ASYNC_ID_SIZE, команда не откладывается, а отвечает ошибкой.
+//
+// A deferring command outside babbler_serial (input handler called
+// directly, as babbler_posix does) replies with an error and keeps no
+// slot; through a babbler_serial port in JSON the reply arrives later as
+// usual; in the id-less format (handle_input_simple) and with an id too
+// long for BABBLER_ASYNC_ID_SIZE the command is not deferred and errors.
+
+#include "Arduino.h"
+#include "babbler_host.h"
+#include "babbler_link_sim.h"
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_async.h"
+#include "babbler_serial.h"
+
+#include <string>
+
+#define SERIAL_READ_BUFFER_SIZE 64
+#define SERIAL_WRITE_BUFFER_SIZE 128
+
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+babbler_serial_t test_port;
+
+// опросов до завершения команды wait
+static int wait_polls = 0;
+
+static int poll_wait(char* reply_buffer, int reply_buf_size, void* ctx) {
+    if(--wait_polls > 0) {
+        return REPLY_DEFERRED;
+    }
+    strcpy(reply_buffer, "done");
+    return strlen(reply_buffer);
+}
+
+static int cmd_wait(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    wait_polls = 3;
+    return babbler_async_defer(&poll_wait, NULL, reply_buffer, reply_buf_size);
+}
+
+static const char _name_wait[] BABBLER_FLASH = "wait";
+static const char _descr_wait[] BABBLER_FLASH = "deferred reply";
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    {_name_wait, &cmd_wait, BABBLER_CMD_READONLY}
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    {_name_wait, _descr_wait, _name_wait}
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+/**
+ * Отправить запрос request в канал, обслуживать канал 100 мс
+ * виртуального времени, вернуть все полученные ответы.
+ */
+static std::string _exchange(LinkSimSerial& link, const std::string& request) {
+    link.clientWrite(request.data(), request.size());
+    std::string rx;
+    char buf[64];
+    for(int i = 0; i < 1000; i++) {
+        babbler_serial_port_tasks(&test_port);
+        babbler_host_advance_time(100);
+        int len;
+        while((len = link.clientRead(buf, sizeof(buf))) > 0) {
+            rx.append(buf, len);
+        }
+    }
+    return rx;
+}
+
+int main() {
+    babbler_host_set_virtual_time(true);
+    
+    // напрямую: ответ - ошибка, отложенных команд нет
+    char input[SERIAL_READ_BUFFER_SIZE+1] = "wait\n";
+    char reply[SERIAL_WRITE_BUFFER_SIZE];
+    int reply_len = handle_input_simple(input, strlen(input), reply, sizeof(reply));
+    if(reply_len <= 0 || std::string(reply, reply_len) != std::string(REPLY_ERROR) + "\n") {
+        fprintf(stderr, "FAIL: direct call replied %d bytes, expected %s\n", reply_len, REPLY_ERROR);
+        return 1;
+    }
+    if(babbler_async_inflight(NULL) != 0) {
+        fprintf(stderr, "FAIL: direct call left %d deferred commands\n", babbler_async_inflight(NULL));
+        return 1;
+    }
+    
+    // через канал JSON: ответ приходит после опросов
+    LinkSimSerial link(babbler_link_sim_default_config());
+    babbler_serial_port_setup(&test_port, link,
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE);
+    babbler_serial_port_set_packet_filter(&test_port, packet_filter_newline);
+    babbler_serial_port_set_input_handler(&test_port, handle_input_json);
+    std::string rx = _exchange(link, "{\"cmd\":\"wait\",\"id\":\"1\"}\n");
+    if(rx != "{\"cmd\":\"wait\",\"id\":\"1\",\"reply\":\"done\"}\n") {
+        fprintf(stderr, "FAIL: port replied \"%s\", expected done\n", rx.c_str());
+        return 1;
+    }
+    
+    // id длиннее BABBLER_ASYNC_ID_SIZE-1: не откладываем
+    std::string long_id(BABBLER_ASYNC_ID_SIZE, 'x');
+    rx = _exchange(link, "{\"cmd\":\"wait\",\"id\":\"" + long_id + "\"}\n");
+    if(rx != "{\"cmd\":\"wait\",\"id\":\"" + long_id + "\",\"reply\":\"" + REPLY_REPLY_BUF_ERROR + "\"}\n" ||
+            babbler_async_inflight(NULL) != 0) {
+        fprintf(stderr, "FAIL: long id replied \"%s\", expected %s\n", rx.c_str(), REPLY_REPLY_BUF_ERROR);
+        return 1;
+    }
+    
+    // формат без id: не откладываем
+    babbler_serial_port_set_input_handler(&test_port, handle_input_simple);
+    rx = _exchange(link, "wait\n");
+    if(rx != std::string(REPLY_ERROR) + "\n" || babbler_async_inflight(NULL) != 0) {
+        fprintf(stderr, "FAIL: id-less format replied \"%s\", expected %s\n", rx.c_str(), REPLY_ERROR);
+        return 1;
+    }
+    
+    // после канала прямой вызов снова не откладывает команду
+    strcpy(input, "wait\n");
+    reply_len = handle_input_simple(input, strlen(input), reply, sizeof(reply));
+    if(babbler_async_inflight(NULL) != 0) {
+        fprintf(stderr, "FAIL: direct call after port left %d deferred commands\n",
+            babbler_async_inflight(NULL));
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
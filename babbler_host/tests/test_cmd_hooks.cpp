@@ -0,0 +1,119 @@
+// Обработчики вокруг команд (babbler_add_cmd_hook): порядок вызовов
+// before, блокировки и after, отмена команды в before, замена ответа
+// в after, удаление обработчиков, неизвестная команда без обработчиков.
+//
+// Command hooks (babbler_add_cmd_hook): call order of before, the lock
+// and after, a before hook cancelling the command, an after hook
+// replacing the reply, hook removal, no hooks for an unknown command.
+
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_simple.h"
+
+#include "stdio.h"
+#include "string.h"
+#include "ctype.h"
+
+#include <string>
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_PING
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_PING
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+// последовательность вызовов обработчиков
+static std::string calls;
+// первый обработчик before отменяет команду
+static bool deny = false;
+
+static bool before1(const babbler_cmd_t* cmd, int argc, char *argv[],
+        char* reply_buffer, int reply_buf_size, int* reply_len) {
+    calls += "b1 ";
+    if(deny) {
+        strcpy(reply_buffer, "denied");
+        *reply_len = strlen(reply_buffer);
+        return false;
+    }
+    return true;
+}
+
+static bool before2(const babbler_cmd_t* cmd, int argc, char *argv[],
+        char* reply_buffer, int reply_buf_size, int* reply_len) {
+    calls += "b2 ";
+    return true;
+}
+
+static void after1(const babbler_cmd_t* cmd, int argc, char *argv[],
+        char* reply_buffer, int reply_buf_size, int* reply_len) {
+    calls += "a1 ";
+}
+
+static void after2(const babbler_cmd_t* cmd, int argc, char *argv[],
+        char* reply_buffer, int reply_buf_size, int* reply_len) {
+    calls += "a2 ";
+    // ответ команды в верхнем регистре
+    for(int i = 0; i < *reply_len; i++) {
+        reply_buffer[i] = toupper(reply_buffer[i]);
+    }
+}
+
+static void lock(const babbler_cmd_t* cmd, bool acquire) {
+    calls += acquire ? "lock " : "unlock ";
+}
+
+static babbler_cmd_hook_t hook1 = {&before1, &after1};
+static babbler_cmd_hook_t hook2 = {&before2, &after2};
+
+/**
+ * Выполнить запрос input, сравнить ответ и последовательность
+ * вызовов обработчиков с ожидаемыми.
+ */
+static bool _check(const char* input, const char* expected_reply, const char* expected_calls) {
+    char input_buffer[64];
+    char reply_buffer[64];
+    strcpy(input_buffer, input);
+    calls = "";
+    int reply_len = handle_input_simple(input_buffer, strlen(input_buffer),
+        reply_buffer, sizeof(reply_buffer));
+    std::string reply = reply_len > 0 ? std::string(reply_buffer, reply_len) : "";
+    if(reply != std::string(expected_reply) + "\n" || calls != expected_calls) {
+        fprintf(stderr, "FAIL: %s\n  got:      %s / %s\n  expected: %s / %s\n",
+            input, reply.c_str(), calls.c_str(), expected_reply, expected_calls);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+    
+    babbler_add_cmd_hook(&hook1);
+    babbler_add_cmd_hook(&hook2);
+    babbler_set_cmd_lock(&lock);
+    ok &= _check("ping", "OK", "b1 b2 lock unlock a1 a2 ");
+    
+    // отмена в before: ни следующих before, ни команды, after - все
+    deny = true;
+    ok &= _check("ping", "DENIED", "b1 a1 a2 ");
+    deny = false;
+    
+    // неизвестная команда - обработчики не вызываются
+    ok &= _check("nosuchcmd", REPLY_DONTUNDERSTAND, "");
+    
+    babbler_set_cmd_lock(NULL);
+    babbler_remove_cmd_hook(&hook2);
+    ok &= _check("ping", "ok", "b1 a1 ");
+    babbler_remove_cmd_hook(&hook1);
+    ok &= _check("ping", "ok", "");
+    
+    if(!ok) {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,169 @@
+// Пакеты COBS и контрольные суммы: контрольные значения CRC-16/CCITT-FALSE
+// и CRC-32, упаковка и распаковка на границах блоков COBS (254 байта)
+// в буфере ровно на COBS_OVERHEAD, отказ на поврежденных пакетах.
+//
+// COBS frames and checksums: CRC-16/CCITT-FALSE and CRC-32 check values,
+// round trips at COBS block edges (254 bytes) in a buffer of exactly
+// COBS_OVERHEAD, rejection of corrupted frames.
+
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_cobs.h"
+#include "babbler_crc.h"
+#include "babbler_io.h"
+
+#include "stdio.h"
+#include "string.h"
+
+#include <string>
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_PING
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_PING
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+// байт за концом буфера: упаковка не должна его трогать
+#define CANARY ((char)0x5a)
+
+/**
+ * Данные длиной len: zeros - с нулями через каждые 7 байт,
+ * иначе без нулей (блоки COBS максимальной длины).
+ */
+static std::string _data(int len, bool zeros) {
+    std::string data(len, 'x');
+    for(int i = 0; i < len; i++) {
+        data[i] = zeros && i % 7 == 3 ? 0 : (char)(1 + i % 255);
+    }
+    return data;
+}
+
+/**
+ * Упаковать data в буфер размером ровно data.size()+COBS_OVERHEAD,
+ * распаковать обратно, сравнить. Буфером на байт меньше - отказ.
+ */
+static bool _round_trip(const std::string& data, int crc_mode) {
+    int len = data.size();
+    int buf_size = len + COBS_OVERHEAD(len, crc_mode);
+    std::string buffer(buf_size + 1, 0);
+    buffer[buf_size] = CANARY;
+    memcpy(&buffer[0], data.data(), len);
+    
+    int packed_len = pack_reply_cobs(&buffer[0], len, buf_size, crc_mode);
+    if(packed_len <= 0 || packed_len > buf_size || buffer[buf_size] != CANARY) {
+        fprintf(stderr, "FAIL: pack len=%d crc=%d returned %d\n", len, crc_mode, packed_len);
+        return false;
+    }
+    if(memchr(buffer.data(), 0, packed_len - 1) != NULL || buffer[packed_len-1] != 0) {
+        fprintf(stderr, "FAIL: pack len=%d crc=%d: zero inside the frame\n", len, crc_mode);
+        return false;
+    }
+    
+    int unpacked_len = unpack_input_cobs(&buffer[0], packed_len, crc_mode);
+    if(unpacked_len != len || std::string(buffer.data(), len) != data) {
+        fprintf(stderr, "FAIL: unpack len=%d crc=%d returned %d\n", len, crc_mode, unpacked_len);
+        return false;
+    }
+    
+    memcpy(&buffer[0], data.data(), len);
+    if(pack_reply_cobs(&buffer[0], len, buf_size - 1, crc_mode) != REPLY_BUF_ERROR) {
+        fprintf(stderr, "FAIL: pack len=%d crc=%d fits a short buffer\n", len, crc_mode);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Испортить упакованный пакет с контрольной суммой:
+ * каждый вариант должен быть отброшен.
+ */
+static bool _corrupted(int crc_mode) {
+    std::string data = _data(300, true);
+    int buf_size = data.size() + COBS_OVERHEAD(data.size(), crc_mode);
+    std::string packed(buf_size, 0);
+    memcpy(&packed[0], data.data(), data.size());
+    int packed_len = pack_reply_cobs(&packed[0], data.size(), buf_size, crc_mode);
+    packed.resize(packed_len);
+    
+    bool ok = true;
+    for(int pos = 0; pos < packed_len - 1; pos += 17) {
+        // один бит данных или служебного байта (ноль не подставляем -
+        // это другой пакет)
+        std::string frame = packed;
+        frame[pos] ^= frame[pos] == 0x01 ? 0x02 : 0x01;
+        if(unpack_input_cobs(&frame[0], frame.size(), crc_mode) != -1) {
+            fprintf(stderr, "FAIL: crc=%d accepted a flipped bit at %d\n", crc_mode, pos);
+            ok = false;
+        }
+    }
+    
+    // ноль внутри пакета, обрезанный пакет
+    std::string frame = packed;
+    frame[packed_len / 2] = 0;
+    if(unpack_input_cobs(&frame[0], frame.size(), crc_mode) != -1) {
+        fprintf(stderr, "FAIL: crc=%d accepted a zero inside the frame\n", crc_mode);
+        ok = false;
+    }
+    frame = packed.substr(0, packed_len / 2);
+    if(unpack_input_cobs(&frame[0], frame.size(), crc_mode) != -1) {
+        fprintf(stderr, "FAIL: crc=%d accepted a truncated frame\n", crc_mode);
+        ok = false;
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    
+    // контрольные значения для "123456789"
+    if(babbler_crc16("123456789", 9) != 0x29B1) {
+        fprintf(stderr, "FAIL: crc16 = 0x%04x, expected 0x29b1\n", babbler_crc16("123456789", 9));
+        ok = false;
+    }
+    if(babbler_crc32("123456789", 9) != 0xCBF43926) {
+        fprintf(stderr, "FAIL: crc32 = 0x%08lx, expected 0xcbf43926\n",
+            (unsigned long)babbler_crc32("123456789", 9));
+        ok = false;
+    }
+    
+    const int crc_modes[] = {BABBLER_CRC_NONE, BABBLER_CRC16, BABBLER_CRC32};
+    const int lens[] = {1, 2, 249, 250, 251, 252, 253, 254, 255, 256, 507, 508, 509, 1000};
+    for(int c = 0; c < 3; c++) {
+        for(unsigned int l = 0; l < sizeof(lens)/sizeof(lens[0]); l++) {
+            ok &= _round_trip(_data(lens[l], false), crc_modes[c]);
+            ok &= _round_trip(_data(lens[l], true), crc_modes[c]);
+            ok &= _round_trip(std::string(lens[l], 0), crc_modes[c]);
+        }
+    }
+    
+    ok &= _corrupted(BABBLER_CRC16);
+    ok &= _corrupted(BABBLER_CRC32);
+    
+    // команда через handle_input_simple_cobs, поврежденный запрос - без ответа
+    char input[64] = "ping";
+    int input_len = pack_reply_cobs(input, 4, sizeof(input), BABBLER_CRC16);
+    char reply[64];
+    int reply_len = handle_input_simple_cobs(input, input_len, reply, sizeof(reply));
+    if(reply_len <= 0 || unpack_input_cobs(reply, reply_len, BABBLER_CRC16) != 2 ||
+            strcmp(reply, "ok") != 0) {
+        fprintf(stderr, "FAIL: ping over cobs replied %d bytes\n", reply_len);
+        ok = false;
+    }
+    strcpy(input, "ping");
+    input_len = pack_reply_cobs(input, 4, sizeof(input), BABBLER_CRC16);
+    input[2] ^= 0x01;
+    if(handle_input_simple_cobs(input, input_len, reply, sizeof(reply)) != 0) {
+        fprintf(stderr, "FAIL: corrupted ping over cobs got a reply\n");
+        ok = false;
+    }
+    
+    if(!ok) {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,129 @@
+// Двойной буфер приема (babbler_serial_port_set_double_buffer): долгая
+// команда вызывает babbler_serial_receive, следующий пакет принимается
+// во второй буфер, пакет выполняемой команды при этом не затрагивается;
+// все пакеты выполняются по порядку.
+//
+// Double receive buffer (babbler_serial_port_set_double_buffer): a long
+// command calls babbler_serial_receive, the next frame is received into
+// the second buffer without touching the executing frame; every frame
+// is executed in order.
+
+#include "Arduino.h"
+#include "babbler_host.h"
+
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_simple.h"
+#include "babbler_serial.h"
+#include "babbler_io.h"
+#include "babbler_lib_config.h"
+
+#include <string>
+
+#define SERIAL_READ_BUFFER_SIZE 32
+#define SERIAL_WRITE_BUFFER_SIZE 64
+
+/**
+ * Поток в памяти: входные данные in, все записанное - в out.
+ */
+class MemStream : public Stream {
+public:
+    std::string in;
+    std::string out;
+    
+    int available() {
+        return in.size();
+    }
+    int read() {
+        if(in.empty()) {
+            return -1;
+        }
+        int c = (unsigned char)in[0];
+        in.erase(0, 1);
+        return c;
+    }
+    int peek() {
+        return in.empty() ? -1 : (unsigned char)in[0];
+    }
+    size_t write(uint8_t c) {
+        out += (char)c;
+        return 1;
+    }
+    using Print::write;
+};
+
+char read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char read_buffer2[SERIAL_READ_BUFFER_SIZE+1];
+char write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+babbler_serial_t test_port;
+
+// пакетов в очереди после приема изнутри первой команды long
+static int queued_inside = 0;
+
+/**
+ * Долгая команда: принимает следующие пакеты, пока выполняется,
+ * отвечает своими аргументами - они не должны измениться.
+ */
+static int cmd_long(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    babbler_serial_receive();
+    if(queued_inside == 0) {
+        queued_inside = test_port.rx_count;
+    }
+    const char* reply = argc == 2 ? argv[1] : REPLY_ERROR;
+    if(strlen(reply) >= (unsigned int)reply_buf_size) {
+        return REPLY_BUF_ERROR;
+    }
+    strcpy(reply_buffer, reply);
+    return strlen(reply_buffer);
+}
+
+static const char _name_long[] BABBLER_FLASH = "long";
+static const char _descr_long[] BABBLER_FLASH = "receive input while running";
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_PING,
+    {_name_long, &cmd_long, BABBLER_CMD_READONLY}
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_PING,
+    {_name_long, _descr_long, _name_long}
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+int main() {
+    babbler_host_set_virtual_time(true);
+    
+    MemStream stream;
+    babbler_serial_port_setup(&test_port, stream,
+        read_buffer, SERIAL_READ_BUFFER_SIZE, write_buffer, SERIAL_WRITE_BUFFER_SIZE);
+    babbler_serial_port_set_packet_filter(&test_port, packet_filter_newline);
+    babbler_serial_port_set_input_handler(&test_port, handle_input_simple);
+    babbler_serial_port_set_blocking_write(&test_port, true);
+    babbler_serial_port_set_double_buffer(&test_port, read_buffer2);
+    
+    // первый пакет принят, остальные еще в потоке
+    stream.in = "long abcdefgh\n";
+    babbler_serial_port_receive(&test_port);
+    stream.in += "ping\nlong 12345678\n";
+    for(int i = 0; i < 10; i++) {
+        babbler_serial_port_tasks(&test_port);
+    }
+    
+    // при BABBLER_SERIAL_RX_QUEUE_MAX=1 второго буфера нет - следующий
+    // пакет ждет в потоке, порядок тот же
+    int expected_queued = BABBLER_SERIAL_RX_QUEUE_MAX < 2 ? 1 : 2;
+    if(queued_inside != expected_queued) {
+        fprintf(stderr, "FAIL: %d frames queued inside the command, expected %d\n",
+            queued_inside, expected_queued);
+        return 1;
+    }
+    if(stream.out != "abcdefgh\nok\n12345678\n") {
+        fprintf(stderr, "FAIL: replies \"%s\"\n", stream.out.c_str());
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Управление потоком канала babbler_serial: XON/XOFF - XOFF при заполнении
+// очереди приема до flow_high_water, XON после освобождения, все пакеты
+// выполняются; BUSY - на каждый пакет сверх flow_high_water ответ busy,
+// прием не останавливается, следующие пакеты снова выполняются.
+//
+// babbler_serial flow control: XON/XOFF - XOFF when the receive queue
+// fills up to flow_high_water, XON once it drains, every frame is executed;
+// BUSY - every frame above flow_high_water gets a busy reply, receiving
+// never stops, later frames are executed again.
+
+#include "Arduino.h"
+#include "babbler_host.h"
+
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_simple.h"
+#include "babbler_serial.h"
+
+#include <string>
+
+#define SERIAL_READ_BUFFER_SIZE 32
+#define SERIAL_WRITE_BUFFER_SIZE 64
+#define RX_QUEUE_FRAMES 4
+
+#define XON "\x11"
+#define XOFF "\x13"
+
+/**
+ * Поток в памяти: входные данные in, все записанное - в out.
+ */
+class MemStream : public Stream {
+public:
+    std::string in;
+    std::string out;
+    
+    int available() {
+        return in.size();
+    }
+    int read() {
+        if(in.empty()) {
+            return -1;
+        }
+        int c = (unsigned char)in[0];
+        in.erase(0, 1);
+        return c;
+    }
+    int peek() {
+        return in.empty() ? -1 : (unsigned char)in[0];
+    }
+    size_t write(uint8_t c) {
+        out += (char)c;
+        return 1;
+    }
+    using Print::write;
+};
+
+char read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+char rx_queue[BABBLER_SERIAL_RX_QUEUE_SIZE(SERIAL_READ_BUFFER_SIZE, RX_QUEUE_FRAMES)];
+
+babbler_serial_t test_port;
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_PING
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_PING
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+int main() {
+    babbler_host_set_virtual_time(true);
+    
+    MemStream stream;
+    babbler_serial_port_setup(&test_port, stream,
+        read_buffer, SERIAL_READ_BUFFER_SIZE, write_buffer, SERIAL_WRITE_BUFFER_SIZE);
+    babbler_serial_port_set_packet_filter(&test_port, packet_filter_newline);
+    babbler_serial_port_set_input_handler(&test_port, handle_input_simple);
+    babbler_serial_port_set_error_handler(&test_port, handle_input_error_simple);
+    babbler_serial_port_set_blocking_write(&test_port, true);
+    babbler_serial_port_set_rx_queue(&test_port, rx_queue, RX_QUEUE_FRAMES);
+    babbler_serial_port_set_flow_control(&test_port, BABBLER_SERIAL_FLOW_XONXOFF, 2);
+    
+    // пакеты пришли, пока loop был занят: очередь заполнена, XOFF сразу
+    stream.in = "ping\nping\nping\nping\n";
+    babbler_serial_port_receive(&test_port);
+    if(stream.out != XOFF) {
+        fprintf(stderr, "FAIL: got \"%s\" after filling the queue, expected XOFF\n", stream.out.c_str());
+        return 1;
+    }
+    
+    for(int i = 0; i < 20; i++) {
+        babbler_serial_port_tasks(&test_port);
+    }
+    // XON - когда в очереди остался один пакет (flow_high_water/2)
+    if(stream.out != XOFF "ok\nok\nok\n" XON "ok\n" &&
+            stream.out != XOFF "ok\nok\n" XON "ok\nok\n") {
+        fprintf(stderr, "FAIL: got \"%s\", expected XOFF, four ok and XON\n", stream.out.c_str());
+        return 1;
+    }
+    
+    // BUSY: из шести пакетов выполняются два, остальные четыре отклонены
+    // и дочитаны до конца, ответы на них - первыми
+    babbler_serial_port_set_flow_control(&test_port, BABBLER_SERIAL_FLOW_BUSY, 2);
+    stream.out = "";
+    stream.in = "ping\nping\nping\nping\nping\nping\n";
+    babbler_serial_port_receive(&test_port);
+    if(!stream.in.empty()) {
+        fprintf(stderr, "FAIL: %d bytes left unread with a full queue\n", (int)stream.in.size());
+        return 1;
+    }
+    for(int i = 0; i < 20; i++) {
+        babbler_serial_port_tasks(&test_port);
+    }
+    if(stream.out != "busy\nbusy\nbusy\nbusy\nok\nok\n") {
+        fprintf(stderr, "FAIL: got \"%s\", expected four busy and two ok\n", stream.out.c_str());
+        return 1;
+    }
+    
+    // очередь освободилась - пакеты снова выполняются
+    stream.out = "";
+    stream.in = "ping\nping\n";
+    for(int i = 0; i < 20; i++) {
+        babbler_serial_port_tasks(&test_port);
+    }
+    if(stream.out != "ok\nok\n") {
+        fprintf(stderr, "FAIL: got \"%s\" after the queue drained, expected two ok\n", stream.out.c_str());
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Поле reply в ответах handle_input_json: объект JSON без кавычек только
+// у команд с флагом BABBLER_CMD_REPLY_JSON (devinfo --json), ответ
+// остальных команд, даже если он начинается с '{', - строка. Параметры
+// сверх CMD_MAX_TOKENS отбрасываются, а не пишутся за конец argv.
+// Ответы devinfo одинаковы до и после babbler_devinfo_setup.
+//
+// The reply field of handle_input_json: an unquoted JSON object only for
+// BABBLER_CMD_REPLY_JSON commands (devinfo --json); replies of other
+// commands stay strings even when they start with '{'. Params beyond
+// CMD_MAX_TOKENS are dropped instead of overrunning argv. devinfo replies
+// are the same before and after babbler_devinfo_setup.
+
+#include "babbler.h"
+#include "babbler_cmd_devinfo.h"
+#include "babbler_json.h"
+#include "babbler_io.h"
+
+#include "stdio.h"
+#include "string.h"
+
+#include <string>
+
+// как в babbler_json.cpp
+#ifndef CMD_MAX_TOKENS
+#define CMD_MAX_TOKENS 20
+#endif
+
+const char* DEVICE_NAME = "test";
+const char* DEVICE_MODEL = "host";
+const char* DEVICE_SERIAL_NUMBER = "1";
+const char* DEVICE_DESCRIPTION = "json reply test";
+const char* DEVICE_VERSION = "1.0";
+const char* DEVICE_MANUFACTURER = "babbler";
+const char* DEVICE_URI = "-";
+
+static int cmd_brace(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    strcpy(reply_buffer, "{x}");
+    return strlen(reply_buffer);
+}
+
+static int cmd_argc(char* reply_buffer, int reply_buf_size, int argc, char *argv[]) {
+    sprintf(reply_buffer, "%d", argc);
+    return strlen(reply_buffer);
+}
+
+static const char _name_brace[] BABBLER_FLASH = "brace";
+static const char _descr_brace[] BABBLER_FLASH = "reply starting with {";
+static const char _name_argc[] BABBLER_FLASH = "argc";
+static const char _descr_argc[] BABBLER_FLASH = "reply with argc";
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_DEVINFO,
+    {_name_brace, &cmd_brace, BABBLER_CMD_READONLY | BABBLER_CMD_PURE},
+    {_name_argc, &cmd_argc, BABBLER_CMD_READONLY}
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_DEVINFO,
+    {_name_brace, _descr_brace, _name_brace},
+    {_name_argc, _descr_argc, _name_argc}
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+/**
+ * Выполнить запрос input в формате JSON, сравнить ответ с expected.
+ */
+static bool _check(const char* input, const std::string& expected) {
+    char input_buffer[1024];
+    char reply_buffer[256];
+    strcpy(input_buffer, input);
+    int reply_len = handle_input_json(input_buffer, strlen(input_buffer),
+        reply_buffer, sizeof(reply_buffer));
+    std::string reply = reply_len > 0 ? std::string(reply_buffer, reply_len) : "";
+    if(reply != expected + "\n") {
+        fprintf(stderr, "FAIL: %s\n  got:      %s\n  expected: %s\n",
+            input, reply.c_str(), expected.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Ответы devinfo и свойств устройства, в том числе в буфер, в который 
+ * они не помещаются.
+ */
+static bool _check_devinfo() {
+    bool ok = true;
+    ok &= _check("{\"cmd\":\"devinfo\",\"params\":[\"--json\"],\"id\":\"1\"}",
+        "{\"cmd\":\"devinfo\",\"id\":\"1\",\"reply\":"
+        "{\"name\":\"test\",\"model\":\"host\",\"serial_number\":\"1\","
+        "\"description\":\"json reply test\",\"version\":\"1.0\","
+        "\"manufacturer\":\"babbler\",\"uri\":\"-\"}}");
+    ok &= _check("{\"cmd\":\"devinfo\"}",
+        "{\"cmd\":\"devinfo\",\"reply\":\"name=test;model=host;serial_number=1;"
+        "description=json reply test;version=1.0;manufacturer=babbler;uri=-\"}");
+    
+    char reply_buffer[16];
+    if(cmd_name(reply_buffer, 5) != 4 || strcmp(reply_buffer, "test") != 0 ||
+            cmd_name(reply_buffer, 4) != REPLY_BUF_ERROR ||
+            cmd_devinfo(reply_buffer, sizeof(reply_buffer)) != REPLY_BUF_ERROR) {
+        fprintf(stderr, "FAIL: devinfo replies are not bounded by reply_buf_size\n");
+        ok = false;
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    // ответы собираются при каждом вызове, затем готовые из babbler_devinfo_setup
+    ok &= _check_devinfo();
+    if(babbler_devinfo_setup() != 0) {
+        fprintf(stderr, "FAIL: babbler_devinfo_setup\n");
+        ok = false;
+    }
+    ok &= _check_devinfo();
+    
+    ok &= _check("{\"cmd\":\"brace\",\"id\":\"2\"}",
+        "{\"cmd\":\"brace\",\"id\":\"2\",\"reply\":\"{x}\"}");
+    ok &= _check("{\"cmd\":\"brace\"}",
+        "{\"cmd\":\"brace\",\"reply\":\"{x}\"}");
+    
+    // 100 параметров: команда получает первые CMD_MAX_TOKENS-1
+    std::string params;
+    for(int i = 0; i < 100; i++) {
+        params += i == 0 ? "\"p\"" : ",\"p\"";
+    }
+    char argc_reply[64];
+    sprintf(argc_reply, "{\"cmd\":\"argc\",\"reply\":\"%d\"}", CMD_MAX_TOKENS);
+    ok &= _check(("{\"cmd\":\"argc\",\"params\":[" + params + "]}").c_str(), argc_reply);
+    if(!ok) {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Кэш ответов не меняет ответы: запросы с табуляцией (handle_command_simple
+// делит параметры только по ' ') получают тот же ответ, что и без кэша,
+// даже если в кэше уже есть ответ на запрос с пробелом. Запросы
+// handle_input_simple, которые отличаются только пробелами ' ', получают
+// один ответ из кэша; запросы JSON - только байт в байт.
+//
+// The reply cache does not change replies: tab-separated requests
+// (handle_command_simple splits only on ' ') get the same reply as without
+// the cache, even when the space-separated request is already cached.
+// handle_input_simple requests that differ only in runs of ' ' share one
+// cached reply; JSON requests match only byte for byte.
+
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_reply_cache.h"
+
+#include "stdio.h"
+#include "string.h"
+
+#include <string>
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_HELP,
+    CMD_PING
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_HELP,
+    MAN_PING
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+/**
+ * Выполнить запрос обработчиком handle_input: с кэшем - так же, как
+ * babbler_serial (lookup, обработчик, store), без кэша - только обработчик.
+ */
+static std::string _request(const char* input, bool cache,
+        input_handler handle_input = handle_input_simple) {
+    char input_buffer[128];
+    char reply_buffer[512];
+    int input_len = strlen(input);
+    memcpy(input_buffer, input, input_len + 1);
+    
+    int reply_len = -1;
+    if(cache) {
+        reply_len = babbler_reply_cache_lookup(handle_input, input_buffer, input_len,
+            reply_buffer, sizeof(reply_buffer));
+    }
+    if(reply_len == -1) {
+        reply_len = handle_input(input_buffer, input_len, reply_buffer, sizeof(reply_buffer));
+        if(cache) {
+            babbler_reply_cache_store(reply_buffer, reply_len);
+        }
+    }
+    return reply_len > 0 ? std::string(reply_buffer, reply_len) : "";
+}
+
+int main() {
+    const char* requests[] = {
+        "ping\n", "ping\t\n", "ping \n",
+        "help ping\n", "help\tping\n", "help  ping\n", "help\t ping\n"
+    };
+    const int count = sizeof(requests)/sizeof(requests[0]);
+    
+    std::string expected[count];
+    for(int i = 0; i < count; i++) {
+        expected[i] = _request(requests[i], false);
+    }
+    
+    // два прохода: первый заполняет кэш, второй отвечает из кэша
+    bool ok = true;
+    for(int pass = 0; pass < 2; pass++) {
+        for(int i = 0; i < count; i++) {
+            std::string reply = _request(requests[i], true);
+            if(reply != expected[i]) {
+                fprintf(stderr, "FAIL: pass %d, request \"%s\"\n  got:      %s\n  expected: %s\n",
+                    pass, requests[i], reply.c_str(), expected[i].c_str());
+                ok = false;
+            }
+        }
+    }
+    if(babbler_reply_cache_hits() == 0) {
+        fprintf(stderr, "FAIL: no replies were served from the cache\n");
+        ok = false;
+    }
+    
+    // лишние пробелы - тот же ключ, табуляция и JSON - свои ключи
+    struct {
+        const char* input;
+        input_handler handle_input;
+        bool hit;
+    } keys[] = {
+        {"help ping\n", handle_input_simple, false},
+        {"help  ping\n", handle_input_simple, true},
+        {"  help ping \n", handle_input_simple, true},
+        {"help ping", handle_input_simple, true},
+        {"help\tping\n", handle_input_simple, false},
+        {"help\t ping\n", handle_input_simple, false},
+        {"{\"cmd\":\"ping\"}", handle_input_json, false},
+        {"{\"cmd\":\"ping\"}", handle_input_json, true},
+        {"{\"cmd\": \"ping\"}", handle_input_json, false}
+    };
+    babbler_reply_cache_invalidate(NULL);
+    for(unsigned int i = 0; i < sizeof(keys)/sizeof(keys[0]); i++) {
+        unsigned long hits = babbler_reply_cache_hits();
+        std::string reply = _request(keys[i].input, true, keys[i].handle_input);
+        bool hit = babbler_reply_cache_hits() != hits;
+        if(hit != keys[i].hit || reply != _request(keys[i].input, false, keys[i].handle_input)) {
+            fprintf(stderr, "FAIL: request \"%s\": %s, reply %s\n",
+                keys[i].input, hit ? "hit" : "miss", reply.c_str());
+            ok = false;
+        }
+    }
+    if(!ok) {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
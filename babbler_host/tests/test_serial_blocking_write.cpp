@@ -0,0 +1,109 @@
+// Поток без availableForWrite (Print::availableForWrite всегда 0, как
+// у SoftwareSerial): с babbler_serial_port_set_blocking_write ответ уходит
+// сразу, без настройки - после BABBLER_SERIAL_WRITE_STALL_TIMEOUT, канал
+// не останавливается навсегда.
+//
+// A stream without availableForWrite (always 0, like SoftwareSerial): with
+// babbler_serial_port_set_blocking_write the reply goes out at once,
+// without it - after BABBLER_SERIAL_WRITE_STALL_TIMEOUT; the channel never
+// stalls for good.
+
+#include "Arduino.h"
+#include "babbler_host.h"
+
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_simple.h"
+#include "babbler_serial.h"
+
+#include <string>
+
+#define SERIAL_READ_BUFFER_SIZE 32
+#define SERIAL_WRITE_BUFFER_SIZE 64
+
+/**
+ * Поток в памяти, availableForWrite не переопределен.
+ */
+class MemStream : public Stream {
+public:
+    std::string in;
+    std::string out;
+    
+    int available() {
+        return in.size();
+    }
+    int read() {
+        if(in.empty()) {
+            return -1;
+        }
+        int c = (unsigned char)in[0];
+        in.erase(0, 1);
+        return c;
+    }
+    int peek() {
+        return in.empty() ? -1 : (unsigned char)in[0];
+    }
+    size_t write(uint8_t c) {
+        out += (char)c;
+        return 1;
+    }
+    using Print::write;
+};
+
+char read_buffer1[SERIAL_READ_BUFFER_SIZE+1];
+char write_buffer1[SERIAL_WRITE_BUFFER_SIZE];
+char read_buffer2[SERIAL_READ_BUFFER_SIZE+1];
+char write_buffer2[SERIAL_WRITE_BUFFER_SIZE];
+
+babbler_serial_t blocking_port;
+babbler_serial_t detect_port;
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_PING
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_PING
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+int main() {
+    babbler_host_set_virtual_time(true);
+    
+    MemStream stream1;
+    MemStream stream2;
+    babbler_serial_port_setup(&blocking_port, stream1,
+        read_buffer1, SERIAL_READ_BUFFER_SIZE, write_buffer1, SERIAL_WRITE_BUFFER_SIZE);
+    babbler_serial_port_set_packet_filter(&blocking_port, packet_filter_newline);
+    babbler_serial_port_set_input_handler(&blocking_port, handle_input_simple);
+    babbler_serial_port_set_blocking_write(&blocking_port, true);
+    
+    babbler_serial_port_setup(&detect_port, stream2,
+        read_buffer2, SERIAL_READ_BUFFER_SIZE, write_buffer2, SERIAL_WRITE_BUFFER_SIZE);
+    babbler_serial_port_set_packet_filter(&detect_port, packet_filter_newline);
+    babbler_serial_port_set_input_handler(&detect_port, handle_input_simple);
+    
+    // с блокирующей записью - ответ за один вызов
+    stream1.in = "ping\nping\n";
+    babbler_serial_port_tasks(&blocking_port);
+    if(stream1.out != "ok\n") {
+        fprintf(stderr, "FAIL: blocking port replied \"%s\" after one call\n", stream1.out.c_str());
+        return 1;
+    }
+    
+    // без настройки: ответ после таймаута, следующие пакеты тоже выполняются
+    stream2.in = "ping\nping\n";
+    for(int i = 0; i < 2 * BABBLER_SERIAL_WRITE_STALL_TIMEOUT; i++) {
+        babbler_serial_port_tasks(&blocking_port);
+        babbler_serial_port_tasks(&detect_port);
+        babbler_host_advance_time(1000);
+    }
+    if(stream1.out != "ok\nok\n" || stream2.out != "ok\nok\n") {
+        fprintf(stderr, "FAIL: replies \"%s\" and \"%s\", expected two ok each\n",
+            stream1.out.c_str(), stream2.out.c_str());
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Пакеты с длиной в заголовке без подсказки размера: пакет, который не
+// помещается в буфер чтения, получает ответ inputoverflow, следующий пакет
+// выполняется как обычно.
+//
+// Length-prefixed frames without a size hint: an oversized frame gets
+// inputoverflow, the next frame is handled as usual.
+
+#include "Arduino.h"
+#include "babbler_host.h"
+#include "babbler_link_sim.h"
+
+#include "babbler.h"
+#include "babbler_len_prefix.h"
+#include "babbler_cmd_core.h"
+#include "babbler_serial.h"
+
+#include <string>
+
+#define SERIAL_READ_BUFFER_SIZE 32
+#define SERIAL_WRITE_BUFFER_SIZE 128
+
+char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+char serial_write_buffer[SERIAL_WRITE_BUFFER_SIZE];
+
+babbler_serial_t test_port;
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_PING
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_PING
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+/**
+ * Отправить пакет с длиной в заголовке.
+ */
+static void _send(LinkSimSerial& link, const std::string& data) {
+    char frame[512];
+    memcpy(frame, data.data(), data.size());
+    int len = pack_reply_len_prefix(frame, data.size(), sizeof(frame));
+    link.clientWrite(frame, len);
+}
+
+int main() {
+    babbler_host_set_virtual_time(true);
+    
+    LinkSimSerial link(babbler_link_sim_default_config());
+    // setup задает все поля канала, мусор в структуре не мешает
+    memset(&test_port, 0xaa, sizeof(test_port));
+    babbler_serial_port_setup(&test_port, link,
+        serial_read_buffer, SERIAL_READ_BUFFER_SIZE,
+        serial_write_buffer, SERIAL_WRITE_BUFFER_SIZE);
+    babbler_serial_port_set_packet_filter(&test_port, packet_filter_len_prefix);
+    babbler_serial_port_set_packet_size_hint(&test_port, NULL);
+    babbler_serial_port_set_input_handler(&test_port, handle_input_simple_len_prefix);
+    babbler_serial_port_set_error_handler(&test_port, handle_input_error_simple_len_prefix);
+    
+    _send(link, "ping " + std::string(100, 'x'));
+    _send(link, "ping");
+    
+    // 100 мс виртуального времени хватит на оба пакета и ответы
+    std::string rx;
+    char buf[64];
+    for(int i = 0; i < 1000; i++) {
+        babbler_serial_port_tasks(&test_port);
+        babbler_host_advance_time(100);
+        int len;
+        while((len = link.clientRead(buf, sizeof(buf))) > 0) {
+            rx.append(buf, len);
+        }
+    }
+    
+    std::string expected;
+    char frame[64];
+    strcpy(frame, "inputoverflow");
+    expected.append(frame, pack_reply_len_prefix(frame, strlen(frame), sizeof(frame)));
+    strcpy(frame, "ok");
+    expected.append(frame, pack_reply_len_prefix(frame, strlen(frame), sizeof(frame)));
+    if(rx != expected) {
+        fprintf(stderr, "FAIL: got %d bytes \"%s\", expected inputoverflow then ok\n",
+            (int)rx.size(), rx.c_str());
+        return 1;
+    }
+    if(babbler_serial_port_overflow_count(&test_port) != 1) {
+        fprintf(stderr, "FAIL: overflow count %lu, expected 1\n",
+            babbler_serial_port_overflow_count(&test_port));
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Журнал команд (BABBLER_TRACE): последние BABBLER_TRACE_DEPTH вызовов
+// handle_command по порядку, номера подряд, индекс команды (-1 - не найдена),
+// количество параметров, результат, время по часам babbler_set_trace_clock;
+// очистка журнала.
+//
+// Command trace (BABBLER_TRACE): the last BABBLER_TRACE_DEPTH handle_command
+// calls in order, consecutive numbers, command index (-1 - not found),
+// argument count, result, time by the babbler_set_trace_clock clock;
+// clearing the trace.
+
+#include "babbler.h"
+#include "babbler_cmd_core.h"
+#include "babbler_simple.h"
+
+#include "stdio.h"
+#include "string.h"
+
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    CMD_HELP,
+    CMD_PING
+};
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    MAN_HELP,
+    MAN_PING
+};
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+// часы: каждый вызов - следующий тик
+static unsigned long ticks = 0;
+
+static unsigned long clock_ticks() {
+    return ++ticks;
+}
+
+/**
+ * Выполнить запрос input в формате handle_input_simple.
+ */
+static void _request(const char* input) {
+    char input_buffer[64];
+    char reply_buffer[512];
+    strcpy(input_buffer, input);
+    handle_input_simple(input_buffer, strlen(input_buffer), reply_buffer, sizeof(reply_buffer));
+}
+
+int main() {
+    bool ok = true;
+    babbler_set_trace_clock(&clock_ticks);
+    
+    // журнал переполняется: остаются последние BABBLER_TRACE_DEPTH записей
+    const int calls = BABBLER_TRACE_DEPTH + 3;
+    for(int i = 0; i < calls - 2; i++) {
+        _request("ping");
+    }
+    _request("help ping");
+    _request("nosuchcmd 1 2");
+    
+    babbler_trace_entry_t entries[BABBLER_TRACE_DEPTH + 1];
+    int count = babbler_trace_read(entries, BABBLER_TRACE_DEPTH + 1);
+    if(count != BABBLER_TRACE_DEPTH) {
+        fprintf(stderr, "FAIL: read %d entries, expected %d\n", count, BABBLER_TRACE_DEPTH);
+        return 1;
+    }
+    for(int i = 0; i < count; i++) {
+        if(entries[i].seq != (unsigned int)(calls - count + i) || entries[i].duration != 1) {
+            fprintf(stderr, "FAIL: entry %d: seq %u, duration %lu\n",
+                i, entries[i].seq, entries[i].duration);
+            ok = false;
+        }
+    }
+    const babbler_trace_entry_t& ping = entries[count - 3];
+    const babbler_trace_entry_t& help = entries[count - 2];
+    const babbler_trace_entry_t& unknown = entries[count - 1];
+    if(ping.cmd != 1 || ping.argc != 1 || ping.result != 2) {
+        fprintf(stderr, "FAIL: ping entry: cmd %d, argc %d, result %d\n",
+            ping.cmd, ping.argc, ping.result);
+        ok = false;
+    }
+    if(help.cmd != 0 || help.argc != 2 || help.result <= 0) {
+        fprintf(stderr, "FAIL: help entry: cmd %d, argc %d, result %d\n",
+            help.cmd, help.argc, help.result);
+        ok = false;
+    }
+    if(unknown.cmd != -1 || unknown.argc != 3) {
+        fprintf(stderr, "FAIL: unknown command entry: cmd %d, argc %d\n",
+            unknown.cmd, unknown.argc);
+        ok = false;
+    }
+    
+    // только последние записи
+    count = babbler_trace_read(entries, 2);
+    if(count != 2 || entries[1].cmd != -1 || entries[0].cmd != 0) {
+        fprintf(stderr, "FAIL: read of 2 entries returned %d\n", count);
+        ok = false;
+    }
+    
+    babbler_trace_clear();
+    count = babbler_trace_read(entries, BABBLER_TRACE_DEPTH);
+    if(count != 0) {
+        fprintf(stderr, "FAIL: %d entries after clear\n", count);
+        ok = false;
+    }
+    _request("ping");
+    count = babbler_trace_read(entries, BABBLER_TRACE_DEPTH);
+    if(count != 1 || entries[0].seq != (unsigned int)calls) {
+        fprintf(stderr, "FAIL: %d entries after clear and ping\n", count);
+        ok = false;
+    }
+    
+    if(!ok) {
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -2,6 +2,10 @@
 
 #include "babbler.h"
 #include "babbler_simple.h"
+#include "babbler_cobs.h"
+#include "babbler_len_prefix.h"
+#include "babbler_async.h"
+#include "babbler_footprint.h"
 #include "utility/json.h"
 #include "stdio.h"
 
@@ -48,7 +52,9 @@ int wrap_reply_json(char* cmd, int argc, char* argv[], char* reply_buffer, int r
  * здесь значение 
  *     cmd_name - имя команды
  *     cmd_id - клиентский идентификатор команды (пришел с командой)
- *     reply_value - ответ выполненной команды (исходное содержимое reply_buffer)
+ *     reply_value - ответ выполненной команды (исходное содержимое reply_buffer);
+ *         у команд с флагом BABBLER_CMD_REPLY_JSON ответ, который 
+ *         начинается с '{', вставляется без кавычек
  *
  * Новое значение перезаписывается в reply_buffer, его размера должно достаточно,
  * чтобы вместить новую строку.
@@ -73,39 +79,54 @@ int wrap_reply_with_id_json(char* cmd, char* cmd_id, int argc, char* argv[], cha
     // и добавить нужные данные слева и справа
     char cmd_reply_buffer[SERIAL_WRITE_BUFFER_SIZE];
     
+    // ответ начинается с открывающейся фигурной скобки { и команда
+    // отвечает объектом JSON (BABBLER_CMD_REPLY_JSON) - не будем брать 
+    // его в кавычки; ответы остальных команд - всегда строка
+    bool reply_object = false;
+    if(reply_buffer[0] == '{') {
+        int i = babbler_find_cmd(cmd);
+        reply_object = i != -1 && (BABBLER_COMMANDS[i].flags & BABBLER_CMD_REPLY_JSON);
+    }
+    int len;
     if(cmd_id != NULL) {
-        if(strlen(reply_buffer) > 0 && reply_buffer[0] == '{') {
-            // ответ начинается с открывающейся фигурной скобки { - 
-            // будем считать, что там объект JSON и не будем брать его
-            // в кавычки
-            sprintf(cmd_reply_buffer, 
-                "{\"cmd\":\"%s\",\"id\":\"%s\",\"reply\":\"%s\"}", 
-                cmd, cmd_id, reply_buffer);
-        } else {
-            sprintf(cmd_reply_buffer, 
+        len = snprintf(cmd_reply_buffer, sizeof(cmd_reply_buffer),
+            reply_object ? "{\"cmd\":\"%s\",\"id\":\"%s\",\"reply\":%s}" :
                 "{\"cmd\":\"%s\",\"id\":\"%s\",\"reply\":\"%s\"}", 
-                cmd, cmd_id, reply_buffer);
-        }
+            cmd, cmd_id, reply_buffer);
     } else {
         // нет cmd_id - нет поля
-        if(strlen(reply_buffer) > 0 && reply_buffer[0] == '{') {
-            // ответ начинается с открывающейся фигурной скобки { - 
-            // будем считать, что там объект JSON и не будем брать его
-            // в кавычки
-            sprintf(cmd_reply_buffer, 
+        len = snprintf(cmd_reply_buffer, sizeof(cmd_reply_buffer),
+            reply_object ? "{\"cmd\":\"%s\",\"reply\":%s}" :
                 "{\"cmd\":\"%s\",\"reply\":\"%s\"}", 
-                cmd, reply_buffer);
-        } else {
-            sprintf(cmd_reply_buffer, 
-                "{\"cmd\":\"%s\",\"reply\":\"%s\"}", 
-                cmd, reply_buffer);
-        }
+            cmd, reply_buffer);
     }
-        
+    
+    if(len < 0 || len >= (int)sizeof(cmd_reply_buffer) || len >= reply_buf_size) {
+        // обернутый ответ не помещается в буфер
+        return -1;
+    }
+    
     strcpy(reply_buffer, cmd_reply_buffer);
     return strlen(reply_buffer);
 }
 
+#ifdef BABBLER_FOOTPRINT
+/**
+ * Распределитель памяти для json_parse_ex с учетом в статистике babbler_footprint.
+ */
+static void* _footprint_json_alloc(size_t size, int zero, void* user_data) {
+    void* ptr = babbler_footprint_malloc(size);
+    if(ptr != NULL && zero) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+static void _footprint_json_free(void* ptr, void* user_data) {
+    babbler_footprint_free(ptr);
+}
+#endif // BABBLER_FOOTPRINT
+
 
 /**
  * Найти команду по имени в input_buffer, выполнить, записать ответ в reply_buffer,
@@ -147,7 +168,7 @@ int handle_command_json(char* buffer, char* reply_buffer, int reply_buf_size,
     // даже с учетом завершающих нулей (на каждую строку
     // в JSON будет минимум 2 лишних символа - открывающая 
     // и закрывающая кавычки)
-    char* argv_mem = (char*)malloc(strlen(buffer));
+    char* argv_mem = (char*)BABBLER_MALLOC(strlen(buffer));
     if(argv_mem == NULL) {
         // совсем плохо - не хватило динамической памяти
         strcpy(reply_buffer, REPLY_ERROR);
@@ -170,8 +191,16 @@ int handle_command_json(char* buffer, char* reply_buffer, int reply_buf_size,
     //         строка (необязательное поле)
     
     // распарсим json по кусочкам
-    json_value* value = json_parse((json_char*)buffer, strlen(buffer));
-
+    #ifdef BABBLER_FOOTPRINT
+        // память под разбор тоже в статистику
+        json_settings settings = { 0 };
+        settings.mem_alloc = &_footprint_json_alloc;
+        settings.mem_free = &_footprint_json_free;
+        json_value* value = json_parse_ex(&settings, (json_char*)buffer, strlen(buffer), 0);
+    #else
+        json_value* value = json_parse((json_char*)buffer, strlen(buffer));
+    #endif // BABBLER_FOOTPRINT
+    
     // и сформируем список параметров вида:
     // tokes[0]=cmd_name
     // tokens[1]=param1
@@ -206,7 +235,8 @@ int handle_command_json(char* buffer, char* reply_buffer, int reply_buf_size,
                     // значение должно быть массив строк
                     if(paramsValue->type == json_array) {
                         // пройдемся по каждому параметру
-                        for (int p = 0; p < paramsValue->u.array.length; p++) {
+                        // (лишние параметры отбрасываем, как handle_command_simple)
+                        for (int p = 0; p < paramsValue->u.array.length && argc < CMD_MAX_TOKENS; p++) {
                             json_value* paramValue = paramsValue->u.array.values[p];
                             if(paramValue->type == json_string) {
                                 char* paramStr = paramValue->u.string.ptr;
@@ -248,8 +278,12 @@ int handle_command_json(char* buffer, char* reply_buffer, int reply_buf_size,
     int reply_len = 0;
     
     if(foundCmd) {
-        // выполнить команду
+        // выполнить команду; если команда отложит ответ, имя команды 
+        // и id запроса попадут в ответ, который оформит обработчик 
+        // входных данных (см babbler_async.h)
+        babbler_async_bind(argv[0], cmd_id);
         reply_len = handle_command(argv[0], argc, argv, reply_buffer, reply_buf_size);
+        babbler_async_bind(NULL, NULL);
     } else  {
         // скорее всего некорректный JSON или нет нужного поля cmd,
         // отвечаем ошибкой
@@ -257,7 +291,7 @@ int handle_command_json(char* buffer, char* reply_buffer, int reply_buf_size,
         reply_len = strlen(reply_buffer);
     }
     
-    if(wrap_reply != NULL) {
+    if(wrap_reply != NULL && reply_len != REPLY_DEFERRED) {
         if(foundCmd) {
             reply_len = wrap_reply(argv[0], cmd_id, argc, argv, reply_buffer, reply_buf_size);
         } else {
@@ -268,17 +302,67 @@ int handle_command_json(char* buffer, char* reply_buffer, int reply_buf_size,
             // http://stackoverflow.com/questions/7724448/simple-json-string-escape-for-c
             // пока просто оставляем пустым
             //_wrap_reply(buffer, cmd_id, reply_buffer);
-            reply_len = wrap_reply("", cmd_id, argc, argv, reply_buffer, reply_buf_size);
+            char empty_cmd[] = "";
+            reply_len = wrap_reply(empty_cmd, cmd_id, argc, argv, reply_buffer, reply_buf_size);
         }
     }
     
     // почистим ресурсы
-    free(argv_mem);
-    json_value_free(value);
+    BABBLER_FREE(argv_mem);
+    #ifdef BABBLER_FOOTPRINT
+        json_value_free_ex(&settings, value);
+    #else
+        json_value_free(value);
+    #endif // BABBLER_FOOTPRINT
     
     return reply_len;
 }
 
+/**
+ * Обернуть результат отложенной команды в JSON с именем команды и id запроса 
+ * (как handle_command_json с wrap_reply_with_id_json), проверить на ошибку.
+ * @param cmd_buf_size - размер буфера без места для упаковки пакета
+ */
+static int _wrap_deferred_json(char* cmd, char* cmd_id, char* reply_buffer, int reply_len, int cmd_buf_size) {
+    if(reply_len >= 0) {
+        reply_len = wrap_reply_with_id_json(cmd, cmd_id, 0, NULL, reply_buffer, cmd_buf_size);
+    }
+    if(reply_len < 0) {
+        reply_len = write_reply_error(reply_buffer, reply_len, cmd_buf_size);
+    }
+    return reply_len;
+}
+
+/**
+ * Оформить ответ отложенной команды в формате handle_input_json, 
+ * см {module:babbler_async.h~babbler_async_finish}
+ */
+static int _finish_json(char* cmd, char* cmd_id, char* reply_buffer, int reply_len, int reply_buf_size) {
+    reply_len = _wrap_deferred_json(cmd, cmd_id, reply_buffer, reply_len, reply_buf_size-2);
+    return pack_reply_newline(reply_buffer, reply_len, reply_buf_size);
+}
+
+/**
+ * Оформить ответ отложенной команды в формате handle_input_json_cobs, 
+ * см {module:babbler_async.h~babbler_async_finish}
+ */
+static int _finish_json_cobs(char* cmd, char* cmd_id, char* reply_buffer, int reply_len, int reply_buf_size) {
+    int crc_mode = babbler_cobs_get_crc();
+    int cmd_buf_size = reply_buf_size - COBS_OVERHEAD(reply_buf_size, crc_mode);
+    reply_len = _wrap_deferred_json(cmd, cmd_id, reply_buffer, reply_len, cmd_buf_size);
+    return pack_reply_cobs(reply_buffer, reply_len, reply_buf_size, crc_mode);
+}
+
+/**
+ * Оформить ответ отложенной команды в формате handle_input_json_len_prefix, 
+ * см {module:babbler_async.h~babbler_async_finish}
+ */
+static int _finish_json_len_prefix(char* cmd, char* cmd_id, char* reply_buffer, int reply_len, int reply_buf_size) {
+    int cmd_buf_size = reply_buf_size - LEN_PREFIX_HEADER_SIZE;
+    reply_len = _wrap_deferred_json(cmd, cmd_id, reply_buffer, reply_len, cmd_buf_size);
+    return pack_reply_len_prefix(reply_buffer, reply_len, reply_buf_size);
+}
+
 /**
  * Обработать входные данные: разобрать строку, выполнить одну или 
  * несколько команд, записать ответ.
@@ -322,6 +406,13 @@ int handle_input_json(char* input_buffer, int input_len, char* reply_buffer, int
     // execute command (reply_buf_size-2 - place for newline and terminating zero)
     int reply_len = handle_command_json(input_buffer, reply_buffer, reply_buf_size-2, wrap_reply_with_id_json);
     
+    // команда отложила ответ (см babbler_async.h) - отправим его позже
+    // command deferred its reply (see babbler_async.h) - will send it later
+    if(reply_len == REPLY_DEFERRED) {
+        babbler_async_set_finish(_finish_json, 2);
+        return 0;
+    }
+    
     // проверить на ошибку
     // check for error
     if(reply_len < 0) {
@@ -335,3 +426,171 @@ int handle_input_json(char* input_buffer, int input_len, char* reply_buffer, int
     return reply_len;
 }
 
+
+/**
+ * Обработать входные данные в пакете COBS (см babbler_cobs.h): распаковать пакет, 
+ * выполнить команду JSON (см handle_command_json), упаковать ответ в пакет COBS.
+ * Тип контрольной суммы задается babbler_cobs_set_crc.
+ * Поврежденные пакеты отбрасываются без ответа.
+ * @param input_buffer - входные данные, пакет COBS
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_json_cobs(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size) {
+    int crc_mode = babbler_cobs_get_crc();
+    
+    // "распакуем" пакет: раскодируем, проверим контрольную сумму, 
+    // добавим завершающий ноль
+    // "unpack" package: decode, check crc, add terminating zero
+    if(unpack_input_cobs(input_buffer, input_len, crc_mode) < 0) {
+        // пакет поврежден - не отвечаем
+        // corrupted packet - no reply
+        return 0;
+    }
+    
+    // выполняем команду (оставим место для контрольной суммы и служебных байт COBS)
+    // execute command (leave space for checksum and COBS overhead)
+    int cmd_buf_size = reply_buf_size - COBS_OVERHEAD(reply_buf_size, crc_mode);
+    int reply_len = handle_command_json(input_buffer, reply_buffer, cmd_buf_size, wrap_reply_with_id_json);
+    
+    // команда отложила ответ (см babbler_async.h) - отправим его позже
+    // command deferred its reply (see babbler_async.h) - will send it later
+    if(reply_len == REPLY_DEFERRED) {
+        babbler_async_set_finish(_finish_json_cobs, reply_buf_size - cmd_buf_size);
+        return 0;
+    }
+    
+    // проверить на ошибку
+    // check for error
+    if(reply_len < 0) {
+        reply_len = write_reply_error(reply_buffer, reply_len, cmd_buf_size);
+    }
+    
+    // "упаковать" пакет для отправки
+    // "pack" reply to send
+    reply_len = pack_reply_cobs(reply_buffer, reply_len, reply_buf_size, crc_mode);
+    
+    return reply_len;
+}
+
+/**
+ * Обработать входные данные в пакете с длиной в заголовке (см babbler_len_prefix.h):
+ * распаковать пакет, выполнить команду JSON (см handle_command_json), 
+ * упаковать ответ в пакет с длиной.
+ * @param input_buffer - входные данные, пакет с длиной в заголовке
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_json_len_prefix(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size) {
+    // "распакуем" пакет: срежем заголовок, добавим завершающий ноль
+    // "unpack" package: cut header, add terminating zero
+    if(unpack_input_len_prefix(input_buffer, input_len) < 0) {
+        // длина не совпадает (например, пакет обрезан) - не отвечаем
+        // length mismatch (e.g. truncated packet) - no reply
+        return 0;
+    }
+    
+    // выполняем команду (оставим место для заголовка)
+    // execute command (leave space for header)
+    int cmd_buf_size = reply_buf_size - LEN_PREFIX_HEADER_SIZE;
+    int reply_len = handle_command_json(input_buffer, reply_buffer, cmd_buf_size, wrap_reply_with_id_json);
+    
+    // команда отложила ответ (см babbler_async.h) - отправим его позже
+    // command deferred its reply (see babbler_async.h) - will send it later
+    if(reply_len == REPLY_DEFERRED) {
+        babbler_async_set_finish(_finish_json_len_prefix, LEN_PREFIX_HEADER_SIZE);
+        return 0;
+    }
+    
+    // проверить на ошибку
+    // check for error
+    if(reply_len < 0) {
+        reply_len = write_reply_error(reply_buffer, reply_len, cmd_buf_size);
+    }
+    
+    // "упаковать" пакет для отправки - добавить заголовок
+    // "pack" reply to send - add header
+    reply_len = pack_reply_len_prefix(reply_buffer, reply_len, reply_buf_size);
+    
+    return reply_len;
+}
+
+/**
+ * Записать в буфер сообщение об ошибке (см write_reply_error), 
+ * обернутое в JSON с пустым полем cmd.
+ * @return длина ответа в байтах или код ошибки
+ */
+static int _write_reply_error_json(int error_code, char* reply_buffer, int reply_buf_size) {
+    int reply_len = write_reply_error(reply_buffer, error_code, reply_buf_size);
+    if(reply_len > 0) {
+        reply_len = wrap_reply_json((char*)"", 0, NULL, reply_buffer, reply_buf_size);
+    }
+    return reply_len;
+}
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_json: текст ошибки 
+ * (см write_reply_error), обернутый в JSON с пустым полем cmd, и перенос строки.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_json(int error_code, char* reply_buffer, int reply_buf_size) {
+    int reply_len = _write_reply_error_json(error_code, reply_buffer, reply_buf_size-2);
+    return pack_reply_newline(reply_buffer, reply_len, reply_buf_size);
+}
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_json_cobs: текст ошибки, 
+ * обернутый в JSON с пустым полем cmd, в пакете COBS.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_json_cobs(int error_code, char* reply_buffer, int reply_buf_size) {
+    int crc_mode = babbler_cobs_get_crc();
+    int cmd_buf_size = reply_buf_size - COBS_OVERHEAD(reply_buf_size, crc_mode);
+    int reply_len = _write_reply_error_json(error_code, reply_buffer, cmd_buf_size);
+    return pack_reply_cobs(reply_buffer, reply_len, reply_buf_size, crc_mode);
+}
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_json_len_prefix: текст ошибки, 
+ * обернутый в JSON с пустым полем cmd, в пакете с длиной.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_json_len_prefix(int error_code, char* reply_buffer, int reply_buf_size) {
+    int cmd_buf_size = reply_buf_size - LEN_PREFIX_HEADER_SIZE;
+    int reply_len = _write_reply_error_json(error_code, reply_buffer, cmd_buf_size);
+    return pack_reply_len_prefix(reply_buffer, reply_len, reply_buf_size);
+}
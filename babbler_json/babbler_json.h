@@ -115,5 +115,81 @@ int handle_command_json(char* input_buffer, char* reply_buffer, int reply_buf_si
  */
 int handle_input_json(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size);
 
+/**
+ * Обработать входные данные в пакете COBS (см babbler_cobs.h): распаковать пакет, 
+ * выполнить команду JSON (см handle_command_json), упаковать ответ в пакет COBS.
+ * Тип контрольной суммы задается babbler_cobs_set_crc.
+ * Поврежденные пакеты отбрасываются без ответа.
+ * @param input_buffer - входные данные, пакет COBS
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_json_cobs(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Обработать входные данные в пакете с длиной в заголовке (см babbler_len_prefix.h):
+ * распаковать пакет, выполнить команду JSON (см handle_command_json), 
+ * упаковать ответ в пакет с длиной.
+ * @param input_buffer - входные данные, пакет с длиной в заголовке
+ * @param input_len - размер входных данных
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_json_len_prefix(char* input_buffer, int input_len, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_json: текст ошибки 
+ * (см write_reply_error), обернутый в JSON с пустым полем cmd, и перенос строки.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_json(int error_code, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_json_cobs: текст ошибки, 
+ * обернутый в JSON с пустым полем cmd, в пакете COBS.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_json_cobs(int error_code, char* reply_buffer, int reply_buf_size);
+
+/**
+ * Сформировать ответ с сообщением об ошибке приема входных данных 
+ * в формате handle_input_json_len_prefix: текст ошибки, 
+ * обернутый в JSON с пустым полем cmd, в пакете с длиной.
+ * См {module:babbler_io.h~input_error_handler}
+ * @param error_code - код ошибки < 0
+ * @param reply_buffer - буфер для записи ответа
+ * @param reply_buf_size - размер буфера reply_buffer - максимальная длина ответа.
+ * @return длина ответа в байтах или код ошибки
+ *     >0, <=reply_buf_size: количество байт, записанных в reply_buffer
+ *     0: не отправлять ответ
+ *    -1: ошибка при формировании ответа (не хватило места в буфере)
+ */
+int handle_input_error_json_len_prefix(int error_code, char* reply_buffer, int reply_buf_size);
+
 #endif // BABBLER_JSON_H
 
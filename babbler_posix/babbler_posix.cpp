@@ -0,0 +1,1240 @@
+#include "babbler_posix.h"
+
+#include "babbler.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+// Сколько байт читать из дескриптора за один вызов read
+#define READ_CHUNK_SIZE 512
+// Сколько событий забирать за один вызов epoll_wait
+#define MAX_EVENTS 64
+
+// Размер очередей заданий рабочих потоков (степень двойки)
+#define JOB_QUEUE_SIZE 256
+
+// Тип дескриптора
+#define CONN_LISTENER 0
+#define CONN_CLIENT 1
+// eventfd для уведомлений от рабочих потоков
+#define CONN_NOTIFY 2
+
+struct _conn_t;
+
+/**
+ * Задание для рабочего потока: входной пакет соединения conn
+ * и место для ответа. Память задания (входные данные и ответ) принадлежит
+ * заданию, рабочий поток не трогает буферы соединения.
+ */
+typedef struct _job_t {
+    struct _conn_t* conn;
+    /** Порядковый номер запроса в соединении */
+    unsigned long seq;
+    /** <0 - вместо выполнения пакета ответить сообщением об ошибке */
+    int error_code;
+    
+    char* input;
+    int input_len;
+    char* reply;
+    int reply_size;
+    /** Длина ответа (результат input_handler или input_error_handler) */
+    int reply_len;
+    
+    /** Размер памяти под input и reply */
+    int capacity;
+    /** Следующее задание в списке свободных или готовых заданий */
+    struct _job_t* next;
+} _job_t;
+
+/**
+ * Очередь заданий без блокировок для одного писателя и одного читателя:
+ * head меняет только читатель, tail - только писатель.
+ */
+typedef struct {
+    _job_t* items[JOB_QUEUE_SIZE];
+    unsigned int head __attribute__((aligned(64)));
+    unsigned int tail __attribute__((aligned(64)));
+} _job_queue_t;
+
+/**
+ * Рабочий поток: очередь входящих заданий от потока ввода-вывода
+ * и очередь выполненных заданий обратно.
+ */
+typedef struct {
+    pthread_t thread;
+    _job_queue_t in;
+    _job_queue_t out;
+    /** eventfd, на котором рабочий поток спит, когда заданий нет */
+    int wake_fd;
+    /** Рабочий поток спит (или собирается уснуть) на wake_fd */
+    int sleeping __attribute__((aligned(64)));
+} _worker_t;
+
+/**
+ * Слушающий сокет или клиентское соединение.
+ */
+typedef struct _conn_t {
+    int fd;
+    int type;
+    /** Сокет (send) или другой дескриптор (write) */
+    bool is_socket;
+    /** Подчиненное устройство pty, держим открытым, чтобы не получать HUP */
+    int pty_slave_fd;
+    /** Путь к файлу UNIX-сокета (удалить при закрытии) */
+    char* unix_path;
+    /** Текущие события epoll */
+    unsigned int events;
+    
+    // Обработчики и размеры буферов (слушающий сокет передает
+    // их новым соединениям)
+    packet_filter is_packet;
+    input_handler handle_input;
+    input_error_handler handle_error;
+    int read_buffer_size;
+    int write_buffer_size;
+    
+    // Буферы соединения, +1 байт в конце буфера чтения для завершающего нуля
+    char* read_buffer;
+    int read_len;
+    char* write_buffer;
+    /** Отправляемый ответ: write_buffer или ответ задания tx_job */
+    char* write_data;
+    /** Размер ответа в буфере write_data */
+    int write_size;
+    /** Количество уже отправленных байт ответа */
+    int write_pos;
+    
+    // Прочитанные, но еще не разобранные на пакеты данные
+    char in_buf[READ_CHUNK_SIZE];
+    int in_pos;
+    int in_len;
+    
+    /** Пакет не поместился в буфер, пропускаем остаток до разделителя */
+    bool rx_overflow;
+    
+    // Выполнение в рабочих потоках (см babbler_posix_set_workers)
+    /** Номер следующего отправляемого на выполнение запроса */
+    unsigned long seq_next;
+    /** Номер запроса, ответ на который отправляется следующим */
+    unsigned long seq_reply;
+    /** Количество заданий, отправленных рабочим потокам и еще не вернувшихся */
+    int inflight;
+    /** Выполненные задания, ожидающие своей очереди на отправку (по seq) */
+    _job_t* done;
+    /** Задание, ответ которого сейчас отправляется */
+    _job_t* tx_job;
+    /** Дескриптор закрыт, структура ждет возвращения заданий */
+    bool closed;
+    /** Новые пакеты не принимаются, пока не освободится место в очередях */
+    bool stalled;
+    /** Клиент закончил передачу, закрыть после отправки всех ответов */
+    bool eof;
+    /** 
+     * Клиент отключился (EPOLLHUP): принятые данные выполняем, ответы 
+     * отбрасываем; дескриптор уже убран из цикла событий 
+     */
+    bool hup;
+    /** 
+     * Не хватило памяти под задание: пакет остается в буфере чтения 
+     * и отправляется снова, когда вернутся задания соединения 
+     */
+    bool submit_pending;
+    /** Код ошибки отложенного пакета (см _submit) */
+    int submit_error;
+    
+    struct _conn_t* prev;
+    struct _conn_t* next;
+} _conn_t;
+
+// Настройки для новых соединений
+static packet_filter _is_packet = NULL;
+static input_handler _handle_input = NULL;
+static input_error_handler _handle_error = NULL;
+static int _read_buffer_size = BABBLER_POSIX_READ_BUFFER_SIZE;
+static int _write_buffer_size = BABBLER_POSIX_WRITE_BUFFER_SIZE;
+
+// Цикл событий и список дескрипторов
+static int _epoll_fd = -1;
+static _conn_t* _conns = NULL;
+static int _client_count = 0;
+
+// Рабочие потоки
+static _worker_t* _workers = NULL;
+static int _worker_count = 0;
+/** Следующий рабочий поток для распределения заданий по кругу */
+static int _worker_next = 0;
+/** Флаг завершения рабочих потоков */
+static int _workers_stop = 0;
+/** eventfd, через который рабочие потоки сообщают о выполненных заданиях */
+static int _done_fd = -1;
+static _conn_t _done_conn;
+/** Поток ввода-вывода ждет уведомлений о выполненных заданиях */
+static int _done_waiting __attribute__((aligned(64))) = 0;
+/** Список свободных заданий (используется только потоком ввода-вывода) */
+static _job_t* _free_jobs = NULL;
+/** Есть соединения с флагом stalled */
+static bool _have_stalled = false;
+
+/**
+ * Настроить фильтр пакетов для новых соединений.
+ */
+void babbler_posix_set_packet_filter(packet_filter is_packet) {
+    _is_packet = is_packet;
+}
+
+/**
+ * Настроить обработчик входных данных для новых соединений.
+ */
+void babbler_posix_set_input_handler(input_handler handle_input) {
+    _handle_input = handle_input;
+}
+
+/**
+ * Настроить обработчик ошибок приема для новых соединений.
+ */
+void babbler_posix_set_error_handler(input_error_handler handle_error) {
+    _handle_error = handle_error;
+}
+
+/**
+ * Размеры буферов чтения и записи для новых соединений.
+ */
+void babbler_posix_set_buffer_size(int read_buffer_size, int write_buffer_size) {
+    _read_buffer_size = read_buffer_size;
+    _write_buffer_size = write_buffer_size;
+}
+
+/**
+ * Добавить задание в очередь (вызывает только писатель).
+ * @return true - задание добавлено, false - очередь заполнена
+ */
+static bool _queue_push(_job_queue_t* q, _job_t* job) {
+    unsigned int tail = q->tail;
+    if(tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == JOB_QUEUE_SIZE) {
+        return false;
+    }
+    q->items[tail % JOB_QUEUE_SIZE] = job;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Забрать задание из очереди (вызывает только читатель).
+ * @return задание или NULL, если очередь пуста
+ */
+static _job_t* _queue_pop(_job_queue_t* q) {
+    unsigned int head = q->head;
+    if(head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    _job_t* job = q->items[head % JOB_QUEUE_SIZE];
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return job;
+}
+
+/**
+ * Есть ли место в очереди (вызывает только писатель).
+ */
+static bool _queue_has_room(_job_queue_t* q) {
+    return q->tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) < JOB_QUEUE_SIZE;
+}
+
+/**
+ * Разбудить поток, который спит на eventfd fd (если он спит или собирается
+ * уснуть). Вызывать после добавления задания в очередь.
+ */
+static void _wake(int fd, int* sleeping) {
+    // барьер в паре с барьером в _wait: либо спящий поток увидит
+    // новое задание в очереди, либо мы увидим флаг sleeping
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(sleeping, __ATOMIC_RELAXED)) {
+        uint64_t one = 1;
+        ssize_t res = write(fd, &one, sizeof(one));
+        (void)res;
+    }
+}
+
+/**
+ * Выполнить задание: ответить сообщением об ошибке или выполнить пакет.
+ * Вызывается в рабочем потоке или в потоке ввода-вывода (без рабочих потоков).
+ */
+static void _job_exec(_job_t* job) {
+    job->reply_len = 0;
+    if(job->error_code < 0) {
+        if(job->conn->handle_error) {
+            job->reply_len = job->conn->handle_error(job->error_code,
+                job->reply, job->reply_size);
+        }
+    } else if(job->conn->handle_input) {
+        job->reply_len = job->conn->handle_input(job->input, job->input_len,
+            job->reply, job->reply_size);
+    }
+}
+
+/**
+ * Рабочий поток: выполнять задания из очереди in, выполненные
+ * возвращать в очередь out.
+ */
+static void* _worker_run(void* arg) {
+    _worker_t* worker = (_worker_t*)arg;
+    while(true) {
+        _job_t* job = _queue_pop(&worker->in);
+        if(job == NULL) {
+            // заданий нет - спим на wake_fd; флаг ставим до повторной
+            // проверки очереди, чтобы не пропустить уведомление
+            __atomic_store_n(&worker->sleeping, 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            job = _queue_pop(&worker->in);
+            if(job == NULL && !__atomic_load_n(&_workers_stop, __ATOMIC_ACQUIRE)) {
+                uint64_t count;
+                ssize_t res = read(worker->wake_fd, &count, sizeof(count));
+                (void)res;
+            }
+            __atomic_store_n(&worker->sleeping, 0, __ATOMIC_RELAXED);
+            if(job == NULL) {
+                if(__atomic_load_n(&_workers_stop, __ATOMIC_ACQUIRE)) {
+                    break;
+                }
+                continue;
+            }
+        }
+        
+        _job_exec(job);
+        
+        // поток ввода-вывода забирает выполненные задания быстрее,
+        // чем мы их выполняем, так что ждать здесь почти не придется
+        while(!_queue_push(&worker->out, job)) {
+            sched_yield();
+        }
+        _wake(_done_fd, &_done_waiting);
+    }
+    return NULL;
+}
+
+// Блокировки для выполнения команд в рабочих потоках: команды
+// BABBLER_CMD_READONLY выполняются параллельно (общая блокировка),
+// BABBLER_CMD_MUTATING - параллельно с ними, но по одной (плюс мьютекс),
+// остальные - в одиночестве (исключительная блокировка)
+static pthread_rwlock_t _cmd_rwlock;
+static pthread_mutex_t _cmd_mutating_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Блокировка для выполнения команды, см {module:babbler.h~babbler_cmd_lock}
+ */
+static void _cmd_lock(const babbler_cmd_t* cmd, bool lock) {
+    if(cmd->flags & BABBLER_CMD_EXCLUSIVE || 
+            !(cmd->flags & (BABBLER_CMD_READONLY | BABBLER_CMD_MUTATING))) {
+        if(lock) {
+            pthread_rwlock_wrlock(&_cmd_rwlock);
+        } else {
+            pthread_rwlock_unlock(&_cmd_rwlock);
+        }
+    } else if(cmd->flags & BABBLER_CMD_MUTATING) {
+        if(lock) {
+            pthread_rwlock_rdlock(&_cmd_rwlock);
+            pthread_mutex_lock(&_cmd_mutating_lock);
+        } else {
+            pthread_mutex_unlock(&_cmd_mutating_lock);
+            pthread_rwlock_unlock(&_cmd_rwlock);
+        }
+    } else {
+        if(lock) {
+            pthread_rwlock_rdlock(&_cmd_rwlock);
+        } else {
+            pthread_rwlock_unlock(&_cmd_rwlock);
+        }
+    }
+}
+
+/**
+ * Взять задание из списка свободных (или выделить новое) с местом
+ * для input_len байт входных данных и ответа размером reply_size.
+ */
+static _job_t* _job_alloc(int input_len, int reply_size) {
+    int capacity = input_len + 1 + reply_size;
+    _job_t* job = _free_jobs;
+    if(job != NULL && job->capacity >= capacity) {
+        _free_jobs = job->next;
+    } else {
+        job = (_job_t*)malloc(sizeof(_job_t) + capacity);
+        if(job == NULL) {
+            return NULL;
+        }
+        job->capacity = capacity;
+    }
+    job->input = (char*)(job + 1);
+    job->input_len = input_len;
+    job->reply = job->input + input_len + 1;
+    job->reply_size = reply_size;
+    job->next = NULL;
+    return job;
+}
+
+/**
+ * Вернуть задание в список свободных.
+ */
+static void _job_free(_job_t* job) {
+    job->next = _free_jobs;
+    _free_jobs = job;
+}
+
+/**
+ * Создать структуру для дескриптора fd, скопировать настройки
+ * слушающего сокета listener (NULL - текущие настройки модуля),
+ * добавить в цикл событий.
+ */
+static _conn_t* _conn_add(int fd, int type, bool is_socket, const _conn_t* listener) {
+    _conn_t* conn = (_conn_t*)calloc(1, sizeof(_conn_t));
+    if(conn == NULL) {
+        return NULL;
+    }
+    
+    conn->fd = fd;
+    conn->type = type;
+    conn->is_socket = is_socket;
+    conn->pty_slave_fd = -1;
+    if(listener != NULL) {
+        conn->is_packet = listener->is_packet;
+        conn->handle_input = listener->handle_input;
+        conn->handle_error = listener->handle_error;
+        conn->read_buffer_size = listener->read_buffer_size;
+        conn->write_buffer_size = listener->write_buffer_size;
+    } else {
+        conn->is_packet = _is_packet;
+        conn->handle_input = _handle_input;
+        conn->handle_error = _handle_error;
+        conn->read_buffer_size = _read_buffer_size;
+        conn->write_buffer_size = _write_buffer_size;
+    }
+    
+    if(type == CONN_CLIENT) {
+        conn->read_buffer = (char*)malloc(conn->read_buffer_size + 1);
+        conn->write_buffer = (char*)malloc(conn->write_buffer_size);
+        conn->write_data = conn->write_buffer;
+        if(conn->read_buffer == NULL || conn->write_buffer == NULL) {
+            free(conn->read_buffer);
+            free(conn->write_buffer);
+            free(conn);
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    if(epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        free(conn->read_buffer);
+        free(conn->write_buffer);
+        free(conn);
+        return NULL;
+    }
+    conn->events = EPOLLIN;
+    
+    conn->next = _conns;
+    if(_conns != NULL) {
+        _conns->prev = conn;
+    }
+    _conns = conn;
+    if(type == CONN_CLIENT) {
+        _client_count++;
+    }
+    
+    return conn;
+}
+
+/**
+ * Освободить память соединения.
+ */
+static void _conn_free(_conn_t* conn) {
+    while(conn->done != NULL) {
+        _job_t* job = conn->done;
+        conn->done = job->next;
+        _job_free(job);
+    }
+    if(conn->tx_job != NULL) {
+        _job_free(conn->tx_job);
+    }
+    free(conn->read_buffer);
+    free(conn->write_buffer);
+    free(conn);
+}
+
+/**
+ * Убрать дескриптор из цикла событий, закрыть, освободить ресурсы.
+ * Если у соединения есть задания в рабочих потоках, память освобождается
+ * после их возвращения (см _jobs_complete).
+ */
+static void _conn_close(_conn_t* conn) {
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    if(conn->pty_slave_fd >= 0) {
+        close(conn->pty_slave_fd);
+    }
+    if(conn->unix_path != NULL) {
+        unlink(conn->unix_path);
+        free(conn->unix_path);
+    }
+    
+    if(conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        _conns = conn->next;
+    }
+    if(conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    if(conn->type == CONN_CLIENT) {
+        _client_count--;
+    }
+    
+    conn->closed = true;
+    if(conn->inflight == 0) {
+        _conn_free(conn);
+    }
+}
+
+/**
+ * Ждать от дескриптора только события events (EPOLLIN или EPOLLOUT).
+ */
+static void _conn_set_events(_conn_t* conn, unsigned int events) {
+    if(conn->hup) {
+        // дескриптор не в цикле событий (см babbler_posix_tasks)
+        return;
+    }
+    if(conn->events != events) {
+        struct epoll_event ev;
+        ev.events = events;
+        ev.data.ptr = conn;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+        conn->events = events;
+    }
+}
+
+/**
+ * Отправить столько ответа, сколько примет дескриптор.
+ * @return 0 - ответ отправлен целиком или отправка продолжится
+ *     по событию EPOLLOUT, -1 - ошибка, соединение нужно закрыть
+ */
+static int _transmit(_conn_t* conn) {
+    while(conn->write_pos < conn->write_size) {
+        ssize_t n;
+        if(conn->is_socket) {
+            n = send(conn->fd, conn->write_data + conn->write_pos,
+                conn->write_size - conn->write_pos, MSG_NOSIGNAL);
+        } else {
+            n = write(conn->fd, conn->write_data + conn->write_pos,
+                conn->write_size - conn->write_pos);
+        }
+        
+        if(n > 0) {
+            conn->write_pos += n;
+        } else if(n < 0 && errno == EINTR) {
+            continue;
+        } else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+    
+    // ответ отправлен целиком
+    conn->write_size = 0;
+    conn->write_pos = 0;
+    if(conn->tx_job != NULL) {
+        _job_free(conn->tx_job);
+        conn->tx_job = NULL;
+        conn->write_data = conn->write_buffer;
+    }
+    return 0;
+}
+
+/**
+ * Рабочий поток, в очереди которого есть место, или -1, если все очереди
+ * заполнены.
+ */
+static int _worker_pick() {
+    for(int i = 0; i < _worker_count; i++) {
+        int w = (_worker_next + i) % _worker_count;
+        if(_queue_has_room(&_workers[w].in)) {
+            _worker_next = w;
+            return w;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Может ли соединение принять следующий пакет: без рабочих потоков -
+ * если предыдущий ответ отправлен, с рабочими потоками - если не превышено
+ * количество запросов в обработке и есть место в очередях.
+ */
+static bool _conn_can_accept(_conn_t* conn) {
+    if(_worker_count == 0) {
+        return conn->write_size == 0;
+    } else if(conn->submit_pending) {
+        // пакету не хватило памяти - ждем, пока вернутся все задания 
+        // соединения (их память освободится) и уйдет текущий ответ
+        return conn->inflight == 0 && conn->write_size == 0 && _worker_pick() >= 0;
+    } else {
+        return conn->inflight < BABBLER_POSIX_MAX_INFLIGHT && _worker_pick() >= 0;
+    }
+}
+
+/**
+ * Выполнить принятый пакет (error_code == 0) или ответить сообщением 
+ * об ошибке (error_code < 0) сразу в потоке ввода-вывода, ответ - в буфер 
+ * записи соединения.
+ */
+static void _exec_now(_conn_t* conn, int error_code) {
+    _job_t job;
+    job.conn = conn;
+    job.error_code = error_code;
+    job.input = conn->read_buffer;
+    job.input_len = conn->read_len;
+    job.reply = conn->write_buffer;
+    job.reply_size = conn->write_buffer_size;
+    _job_exec(&job);
+    conn->read_len = 0;
+    
+    if(job.reply_len > 0) {
+        conn->write_size = job.reply_len;
+        conn->write_pos = 0;
+    }
+}
+
+/**
+ * Выполнить принятый целиком пакет (error_code == 0) или ответить
+ * сообщением об ошибке (error_code < 0). Без рабочих потоков пакет
+ * выполняется сразу и ответ ставится на отправку, иначе пакет
+ * копируется в задание для рабочего потока.
+ */
+static void _submit(_conn_t* conn, int error_code) {
+    if(_worker_count == 0) {
+        _exec_now(conn, error_code);
+        return;
+    }
+    
+    int input_len = error_code < 0 ? 0 : conn->read_len;
+    
+    // место в очереди проверено в _conn_can_accept
+    _job_t* job = _job_alloc(input_len, conn->write_buffer_size);
+    if(job == NULL) {
+        if(conn->inflight > 0 || conn->write_size > 0) {
+            // памяти нет: пакет остается в буфере чтения, новые данные 
+            // не читаем, пока не вернутся задания соединения и не уйдет 
+            // текущий ответ (см _conn_process)
+            conn->submit_pending = true;
+            conn->submit_error = error_code;
+        } else {
+            // ждать нечего - отвечаем отказом INPUT_BUSY_ERROR без выделения 
+            // памяти: ответов перед ним в очереди соединения нет
+            _exec_now(conn, INPUT_BUSY_ERROR);
+        }
+        return;
+    }
+    conn->read_len = 0;
+    job->conn = conn;
+    job->seq = conn->seq_next++;
+    job->error_code = error_code;
+    memcpy(job->input, conn->read_buffer, input_len);
+    
+    _worker_t* worker = &_workers[_worker_pick()];
+    _queue_push(&worker->in, job);
+    _worker_next = (_worker_next + 1) % _worker_count;
+    conn->inflight++;
+    _wake(worker->wake_fd, &worker->sleeping);
+}
+
+/**
+ * Разобрать прочитанные данные на пакеты, пока соединение может
+ * принимать новые пакеты.
+ */
+static void _conn_parse(_conn_t* conn) {
+    while(conn->in_pos < conn->in_len) {
+        char ch = conn->in_buf[conn->in_pos];
+        conn->in_pos++;
+        
+        if(conn->rx_overflow) {
+            // пропускаем остаток слишком длинного пакета до разделителя
+            // (фильтру передаем только последний байт)
+            if(conn->is_packet(&ch, 1)) {
+                conn->rx_overflow = false;
+                _submit(conn, INPUT_OVERFLOW_ERROR);
+                if(!_conn_can_accept(conn)) {
+                    break;
+                }
+            }
+            continue;
+        }
+        
+        conn->read_buffer[conn->read_len] = ch;
+        conn->read_len++;
+        
+        if(conn->is_packet(conn->read_buffer, conn->read_len)) {
+            _submit(conn, 0);
+            if(!_conn_can_accept(conn)) {
+                break;
+            }
+        } else if(conn->read_len == conn->read_buffer_size) {
+            conn->read_len = 0;
+            conn->rx_overflow = true;
+        }
+    }
+}
+
+/**
+ * Обслужить клиентское соединение: отправить ответ, прочитать и выполнить
+ * новые пакеты, пока дескриптор не перестанет принимать или отдавать данные.
+ * @return 0 - соединение открыто, -1 - соединение закрыто
+ */
+static int _conn_process(_conn_t* conn) {
+    conn->stalled = false;
+    while(true) {
+        if(conn->write_size > 0) {
+            if(conn->hup) {
+                // клиент отключился - ответ отбрасываем
+                conn->write_pos = conn->write_size;
+            }
+            if(_transmit(conn) < 0) {
+                _conn_close(conn);
+                return -1;
+            }
+            if(conn->write_size > 0) {
+                // ответ отправлен не целиком - ждем, когда дескриптор
+                // будет готов принять данные, новые пакеты не читаем
+                _conn_set_events(conn, EPOLLOUT);
+                return 0;
+            }
+        }
+        
+        if(conn->done != NULL && conn->done->seq == conn->seq_reply) {
+            // следующий по порядку ответ из рабочего потока
+            _job_t* job = conn->done;
+            conn->done = job->next;
+            conn->seq_reply++;
+            if(job->reply_len > 0) {
+                conn->tx_job = job;
+                conn->write_data = job->reply;
+                conn->write_size = job->reply_len;
+                conn->write_pos = 0;
+            } else {
+                _job_free(job);
+            }
+            continue;
+        }
+        
+        if(!_conn_can_accept(conn)) {
+            // ждем ответов от рабочих потоков (см _jobs_complete),
+            // новые данные пока не читаем
+            conn->stalled = true;
+            _have_stalled = true;
+            _conn_set_events(conn, 0);
+            return 0;
+        }
+        
+        if(conn->submit_pending) {
+            // задания вернулись - повторяем пакет, которому не хватило памяти
+            conn->submit_pending = false;
+            _submit(conn, conn->submit_error);
+            continue;
+        }
+        
+        if(conn->in_pos < conn->in_len) {
+            _conn_parse(conn);
+            continue;
+        }
+        
+        if(conn->eof) {
+            if(conn->hup || (conn->inflight == 0 && conn->done == NULL)) {
+                // (после отключения клиента ответы не нужны: задания 
+                // в рабочих потоках выполнятся, их память освободит _job_return)
+                _conn_close(conn);
+                return -1;
+            }
+            // ждем ответов от рабочих потоков
+            _conn_set_events(conn, 0);
+            return 0;
+        }
+        
+        // без фильтра пакетов пакетом считаем всё, что вернул один вызов read
+        char* buf = conn->is_packet ? conn->in_buf : conn->read_buffer;
+        int size = conn->is_packet ? READ_CHUNK_SIZE : conn->read_buffer_size;
+        ssize_t n = read(conn->fd, buf, size);
+        if(n > 0) {
+            if(conn->is_packet) {
+                conn->in_pos = 0;
+                conn->in_len = n;
+            } else {
+                conn->read_len = n;
+                _submit(conn, 0);
+            }
+        } else if(n < 0 && errno == EINTR) {
+            continue;
+        } else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if(conn->hup) {
+                // клиент отключился, новых данных не будет
+                conn->eof = true;
+                continue;
+            }
+            _conn_set_events(conn, EPOLLIN);
+            return 0;
+        } else if(n == 0) {
+            // клиент закончил передачу - отправим ответы на уже
+            // принятые запросы и закроем соединение
+            conn->eof = true;
+        } else {
+            // ошибка чтения
+            _conn_close(conn);
+            return -1;
+        }
+    }
+}
+
+/**
+ * Принять все ожидающие подключения к слушающему сокету.
+ */
+static void _accept(_conn_t* listener) {
+    while(true) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            // EAGAIN - больше подключений нет, прочие ошибки
+            // (EMFILE и т.п.) - попробуем в следующий раз
+            return;
+        }
+        
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        
+        // новое соединение получает настройки слушающего сокета
+        if(_conn_add(fd, CONN_CLIENT, true, listener) == NULL) {
+            close(fd);
+        }
+    }
+}
+
+/**
+ * Предварительная настройка модуля: создать цикл событий epoll.
+ * @return 0 - успех, -1 - ошибка (см errno)
+ */
+int babbler_posix_setup() {
+    if(_epoll_fd >= 0) {
+        return 0;
+    }
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return _epoll_fd < 0 ? -1 : 0;
+}
+
+/**
+ * Настроить сокет fd на прослушивание и добавить в цикл событий.
+ */
+static int _listen(int fd, char* unix_path) {
+    if(listen(fd, SOMAXCONN) < 0) {
+        int err = errno;
+        close(fd);
+        free(unix_path);
+        errno = err;
+        return -1;
+    }
+    
+    _conn_t* conn = _conn_add(fd, CONN_LISTENER, true, NULL);
+    if(conn == NULL) {
+        int err = errno;
+        close(fd);
+        free(unix_path);
+        errno = err;
+        return -1;
+    }
+    conn->unix_path = unix_path;
+    return fd;
+}
+
+/**
+ * Принимать подключения по TCP.
+ * @param host - адрес для прослушивания (NULL - все адреса)
+ * @param port - номер порта
+ * @return дескриптор слушающего сокета или -1 при ошибке (см errno)
+ */
+int babbler_posix_listen_tcp(const char* host, int port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    
+    struct addrinfo* addrs;
+    if(getaddrinfo(host, service, &hints, &addrs) != 0) {
+        errno = EADDRNOTAVAIL;
+        return -1;
+    }
+    
+    int fd = -1;
+    for(struct addrinfo* addr = addrs; addr != NULL; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+            addr->ai_protocol);
+        if(fd < 0) {
+            continue;
+        }
+        
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if(bind(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+            break;
+        }
+        
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addrs);
+    
+    if(fd < 0) {
+        return -1;
+    }
+    return _listen(fd, NULL);
+}
+
+/**
+ * Принимать подключения через UNIX-сокет.
+ * @param path - путь к файлу сокета (существующий файл будет удален)
+ * @return дескриптор слушающего сокета или -1 при ошибке (см errno)
+ */
+int babbler_posix_listen_unix(const char* path) {
+    struct sockaddr_un addr;
+    if(strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        return -1;
+    }
+    
+    unlink(path);
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return _listen(fd, strdup(path));
+}
+
+/**
+ * Создать псевдотерминал и обслуживать его как последовательный порт.
+ * @param slave_name - буфер для имени подчиненного устройства (может быть NULL)
+ * @param slave_name_size - размер буфера slave_name
+ * @return дескриптор ведущего устройства или -1 при ошибке (см errno)
+ */
+int babbler_posix_open_pty(char* slave_name, int slave_name_size) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(fd < 0) {
+        return -1;
+    }
+    
+    char name[64];
+    int slave_fd = -1;
+    if(grantpt(fd) < 0 || unlockpt(fd) < 0 || ptsname_r(fd, name, sizeof(name)) != 0 ||
+            (slave_fd = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    
+    // сырой режим: без эха, без обработки переводов строк и управляющих символов
+    struct termios tio;
+    if(tcgetattr(slave_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(slave_fd, TCSANOW, &tio);
+    }
+    
+    _conn_t* conn = _conn_add(fd, CONN_CLIENT, false, NULL);
+    if(conn == NULL) {
+        int err = errno;
+        close(slave_fd);
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    conn->pty_slave_fd = slave_fd;
+    
+    if(slave_name != NULL && slave_name_size > 0) {
+        strncpy(slave_name, name, slave_name_size);
+        slave_name[slave_name_size - 1] = 0;
+    }
+    return fd;
+}
+
+/**
+ * Обслуживать уже открытый дескриптор fd.
+ * @return 0 - успех, -1 - ошибка (см errno)
+ */
+int babbler_posix_add_fd(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+    
+    int type;
+    socklen_t len = sizeof(type);
+    bool is_socket = getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0;
+    
+    return _conn_add(fd, CONN_CLIENT, is_socket, NULL) == NULL ? -1 : 0;
+}
+
+/**
+ * Количество открытых клиентских соединений.
+ */
+int babbler_posix_connection_count() {
+    return _client_count;
+}
+
+/**
+ * Вернуть выполненное задание соединению: поставить ответ в очередь
+ * на отправку по порядку номеров запросов.
+ */
+static void _job_return(_job_t* job) {
+    _conn_t* conn = job->conn;
+    conn->inflight--;
+    if(conn->closed) {
+        _job_free(job);
+        if(conn->inflight == 0) {
+            _conn_free(conn);
+        }
+        return;
+    }
+    
+    // задания разных рабочих потоков возвращаются в произвольном
+    // порядке - держим список готовых ответов отсортированным по seq
+    _job_t** pos = &conn->done;
+    while(*pos != NULL && (*pos)->seq < job->seq) {
+        pos = &(*pos)->next;
+    }
+    job->next = *pos;
+    *pos = job;
+    
+    if(conn->done->seq == conn->seq_reply && conn->write_size == 0) {
+        _conn_process(conn);
+    }
+}
+
+/**
+ * Забрать выполненные задания у рабочих потоков, разложить ответы
+ * по соединениям (по порядку номеров запросов), отправить.
+ */
+static void _jobs_complete() {
+    for(int w = 0; w < _worker_count; w++) {
+        _job_t* job;
+        while((job = _queue_pop(&_workers[w].out)) != NULL) {
+            _job_return(job);
+        }
+    }
+    
+    // в очередях освободилось место - продолжаем разбирать
+    // пакеты соединений, которые ждали
+    if(_have_stalled) {
+        _have_stalled = false;
+        _conn_t* conn = _conns;
+        while(conn != NULL) {
+            _conn_t* next = conn->next;
+            if(conn->type == CONN_CLIENT && conn->stalled) {
+                _conn_process(conn);
+            }
+            conn = next;
+        }
+    }
+}
+
+/**
+ * Постоянные задачи модуля: дождаться событий ввода-вывода, принять
+ * новые подключения, прочитать входные данные, выполнить команды,
+ * отправить ответы.
+ * @param timeout - максимальное время ожидания событий в миллисекундах
+ * @return количество обработанных событий или -1 при ошибке (см errno)
+ */
+int babbler_posix_tasks(int timeout) {
+    if(_worker_count > 0) {
+        // рабочие потоки будят нас через _done_fd, только пока мы
+        // ждем в epoll_wait; перед сном проверяем, не вернулось ли
+        // что-то раньше (барьер в паре с барьером в _wake)
+        __atomic_store_n(&_done_waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        for(int w = 0; w < _worker_count; w++) {
+            if(_workers[w].out.head != __atomic_load_n(&_workers[w].out.tail, __ATOMIC_ACQUIRE)) {
+                timeout = 0;
+                break;
+            }
+        }
+    }
+    
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(_epoll_fd, events, MAX_EVENTS, timeout);
+    __atomic_store_n(&_done_waiting, 0, __ATOMIC_RELAXED);
+    if(n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    
+    for(int i = 0; i < n; i++) {
+        _conn_t* conn = (_conn_t*)events[i].data.ptr;
+        if(conn->type == CONN_LISTENER) {
+            _accept(conn);
+        } else if(conn->type == CONN_NOTIFY) {
+            // выполненные задания заберем ниже
+            uint64_t count;
+            ssize_t res = read(_done_fd, &count, sizeof(count));
+            (void)res;
+        } else if(events[i].events & (EPOLLHUP | EPOLLERR)) {
+            // клиент отключился: ответы отправить уже не получится, но 
+            // команды, которые он успел передать, выполняем (они могут 
+            // менять состояние устройства). Дескриптор убираем из цикла 
+            // событий (иначе HUP приходил бы снова, пока соединение ждет 
+            // рабочие потоки), дочитываем и закрываем (см _conn_process)
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+            conn->hup = true;
+            _conn_process(conn);
+        } else {
+            _conn_process(conn);
+        }
+    }
+    
+    if(_worker_count > 0) {
+        _jobs_complete();
+    }
+    return n;
+}
+
+/**
+ * Выполнять команды в count рабочих потоках.
+ * @return 0 - успех, -1 - ошибка (см errno)
+ */
+int babbler_posix_set_workers(int count) {
+    if(_worker_count > 0 || count <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    
+    _done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_done_fd < 0) {
+        return -1;
+    }
+    _done_conn.fd = _done_fd;
+    _done_conn.type = CONN_NOTIFY;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &_done_conn;
+    if(epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _done_fd, &ev) < 0) {
+        int err = errno;
+        close(_done_fd);
+        _done_fd = -1;
+        errno = err;
+        return -1;
+    }
+    // команды с флагами BABBLER_CMD_* выполняются параллельно по правилам
+    // _cmd_lock; писатели (исключительные команды) имеют приоритет,
+    // чтобы поток команд только для чтения их не задерживал
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&_cmd_rwlock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    babbler_set_cmd_lock(_cmd_lock);
+    
+    _workers = (_worker_t*)calloc(count, sizeof(_worker_t));
+    if(_workers == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    _workers_stop = 0;
+    for(int i = 0; i < count; i++) {
+        _workers[i].wake_fd = eventfd(0, EFD_CLOEXEC);
+        if(_workers[i].wake_fd < 0 ||
+                pthread_create(&_workers[i].thread, NULL, _worker_run, &_workers[i]) != 0) {
+            int err = errno;
+            if(_workers[i].wake_fd >= 0) {
+                close(_workers[i].wake_fd);
+            }
+            errno = err;
+            break;
+        }
+        _worker_count++;
+    }
+    return _worker_count == count ? 0 : -1;
+}
+
+/**
+ * Остановить рабочие потоки, вернуть все задания соединениям.
+ */
+static void _workers_shutdown() {
+    __atomic_store_n(&_workers_stop, 1, __ATOMIC_RELEASE);
+    for(int i = 0; i < _worker_count; i++) {
+        uint64_t one = 1;
+        ssize_t res = write(_workers[i].wake_fd, &one, sizeof(one));
+        (void)res;
+        pthread_join(_workers[i].thread, NULL);
+        close(_workers[i].wake_fd);
+    }
+    
+    // соединения уже закрыты, задания возвращаем только для того,
+    // чтобы освободить память
+    for(int w = 0; w < _worker_count; w++) {
+        _job_t* job;
+        while((job = _queue_pop(&_workers[w].in)) != NULL) {
+            _job_return(job);
+        }
+        while((job = _queue_pop(&_workers[w].out)) != NULL) {
+            _job_return(job);
+        }
+    }
+    
+    free(_workers);
+    _workers = NULL;
+    _worker_count = 0;
+    babbler_set_cmd_lock(NULL);
+    pthread_rwlock_destroy(&_cmd_rwlock);
+    close(_done_fd);
+    _done_fd = -1;
+}
+
+/**
+ * Закрыть все соединения и слушающие сокеты, освободить ресурсы модуля.
+ */
+void babbler_posix_close() {
+    while(_conns != NULL) {
+        _conn_close(_conns);
+    }
+    if(_worker_count > 0) {
+        _workers_shutdown();
+    }
+    while(_free_jobs != NULL) {
+        _job_t* job = _free_jobs;
+        _free_jobs = job->next;
+        free(job);
+    }
+    if(_epoll_fd >= 0) {
+        close(_epoll_fd);
+        _epoll_fd = -1;
+    }
+}
+
@@ -0,0 +1,152 @@
+#ifndef BABBLER_POSIX_H
+#define BABBLER_POSIX_H
+
+/**
+ * Модуль ввода-вывода для Linux: обслуживает те же таблицы команд
+ * BABBLER_COMMANDS и обработчики входных данных (handle_input_simple,
+ * handle_input_json и т.п.), что и babbler_serial, но в обычном процессе -
+ * для симуляторов устройств и шлюзов.
+ *
+ * Клиенты подключаются через псевдотерминал (pty), UNIX-сокет или TCP;
+ * все соединения обслуживаются одним циклом событий epoll, у каждого
+ * соединения собственные буферы чтения и записи.
+ *
+ * Linux I/O module: serve the same command tables and input handlers
+ * as babbler_serial from a regular process over a pty, UNIX socket or TCP,
+ * using a single epoll event loop with per-connection buffers.
+ */
+
+#include "babbler_io.h"
+
+/** Размер буфера чтения по умолчанию (максимальный размер пакета) */
+#define BABBLER_POSIX_READ_BUFFER_SIZE 1024
+/** Размер буфера записи по умолчанию (максимальный размер ответа) */
+#define BABBLER_POSIX_WRITE_BUFFER_SIZE 4096
+
+/**
+ * Сколько запросов одного соединения может одновременно находиться
+ * в рабочих потоках (см babbler_posix_set_workers); пока лимит исчерпан,
+ * новые данные из соединения не читаются.
+ */
+#ifndef BABBLER_POSIX_MAX_INFLIGHT
+#define BABBLER_POSIX_MAX_INFLIGHT 32
+#endif
+
+/**
+ * Настроить фильтр пакетов для новых соединений
+ * (вызывать до babbler_posix_listen_* / babbler_posix_open_pty),
+ * см {module:babbler_io.h~packet_filter}.
+ * Если фильтр не задан, пакетом считается всё, что вернул один вызов read.
+ */
+void babbler_posix_set_packet_filter(packet_filter is_packet);
+
+/**
+ * Настроить обработчик входных данных для новых соединений
+ * (вызывать до babbler_posix_listen_* / babbler_posix_open_pty),
+ * см {module:babbler_io.h~input_handler}.
+ */
+void babbler_posix_set_input_handler(input_handler handle_input);
+
+/**
+ * Настроить обработчик ошибок приема для новых соединений
+ * (вызывать до babbler_posix_listen_* / babbler_posix_open_pty),
+ * см {module:babbler_io.h~input_error_handler}.
+ */
+void babbler_posix_set_error_handler(input_error_handler handle_error);
+
+/**
+ * Размеры буферов чтения и записи для новых соединений
+ * (по умолчанию BABBLER_POSIX_READ_BUFFER_SIZE и BABBLER_POSIX_WRITE_BUFFER_SIZE).
+ * Буферы выделяются для каждого соединения при подключении.
+ */
+void babbler_posix_set_buffer_size(int read_buffer_size, int write_buffer_size);
+
+/**
+ * Предварительная настройка модуля: создать цикл событий epoll.
+ * @return 0 - успех, -1 - ошибка (см errno)
+ */
+int babbler_posix_setup();
+
+/**
+ * Принимать подключения по TCP.
+ * @param host - адрес для прослушивания (NULL - все адреса)
+ * @param port - номер порта
+ * @return дескриптор слушающего сокета или -1 при ошибке (см errno)
+ */
+int babbler_posix_listen_tcp(const char* host, int port);
+
+/**
+ * Принимать подключения через UNIX-сокет.
+ * @param path - путь к файлу сокета (существующий файл будет удален)
+ * @return дескриптор слушающего сокета или -1 при ошибке (см errno)
+ */
+int babbler_posix_listen_unix(const char* path);
+
+/**
+ * Создать псевдотерминал и обслуживать его как последовательный порт
+ * устройства: клиент открывает подчиненное устройство (/dev/pts/N)
+ * так же, как настоящий последовательный порт.
+ * @param slave_name - буфер для имени подчиненного устройства (может быть NULL)
+ * @param slave_name_size - размер буфера slave_name
+ * @return дескриптор ведущего устройства или -1 при ошибке (см errno)
+ */
+int babbler_posix_open_pty(char* slave_name, int slave_name_size);
+
+/**
+ * Обслуживать уже открытый двунаправленный дескриптор fd (сокет,
+ * последовательный порт, socketpair и т.п.): запросы читаются из fd,
+ * ответы пишутся в него же. Дескриптор переводится в неблокирующий режим
+ * и закрывается вместе с соединением.
+ * @return 0 - успех, -1 - ошибка (см errno)
+ */
+int babbler_posix_add_fd(int fd);
+
+/**
+ * Выполнять команды в count рабочих потоках (вызывать один раз после
+ * babbler_posix_setup). Поток, вызывающий babbler_posix_tasks, только
+ * принимает подключения, разбирает входные данные на пакеты и отправляет
+ * ответы; пакеты передаются рабочим потоками через очереди без блокировок,
+ * у каждого задания собственные буферы для входных данных и ответа.
+ * Ответы отправляются клиенту в том же порядке, в котором пришли запросы.
+ *
+ * Обработчики входных данных в этом режиме вызываются одновременно
+ * из нескольких потоков. Команды выполняются параллельно в соответствии
+ * с флагами babbler_cmd_t.flags: BABBLER_CMD_READONLY - одновременно
+ * друг с другом, BABBLER_CMD_MUTATING - по одной (параллельно с READONLY),
+ * команды без флагов и BABBLER_CMD_EXCLUSIVE - в одиночестве
+ * (см babbler_set_cmd_lock).
+ *
+ * По умолчанию (без рабочих потоков) команды выполняются в потоке
+ * babbler_posix_tasks.
+ *
+ * Run commands in count worker threads; the event loop thread only frames
+ * requests and sends replies, replies keep request order per connection.
+ * Read-only commands run concurrently, mutating ones are serialized
+ * (see babbler_cmd_t.flags).
+ *
+ * @return 0 - успех, -1 - ошибка (см errno)
+ */
+int babbler_posix_set_workers(int count);
+
+/**
+ * Количество открытых клиентских соединений.
+ */
+int babbler_posix_connection_count();
+
+/**
+ * Постоянные задачи модуля: дождаться событий ввода-вывода (не дольше timeout
+ * миллисекунд), принять новые подключения, прочитать входные данные,
+ * выполнить команды, отправить ответы. Вызывать в цикле.
+ * @param timeout - максимальное время ожидания событий в миллисекундах
+ *     (-1 - ждать бесконечно, 0 - не ждать)
+ * @return количество обработанных событий или -1 при ошибке (см errno)
+ */
+int babbler_posix_tasks(int timeout);
+
+/**
+ * Закрыть все соединения и слушающие сокеты, освободить ресурсы модуля.
+ */
+void babbler_posix_close();
+
+#endif // BABBLER_POSIX_H
+
@@ -0,0 +1,157 @@
+/**
+ * Сервер команд babbler для Linux: те же таблицы команд, что и на устройстве,
+ * доступны через псевдотерминал, UNIX-сокет и TCP.
+ *
+ * Babbler command server for Linux: the same command tables as on device,
+ * served over a pty, UNIX socket and TCP.
+ *
+ * Запуск / run:
+ *     babbler_posix_server [--workers N] [--json] [--tcp PORT] [--unix PATH] [--pty]
+ *
+ * Проверка / try:
+ *     echo ping | nc localhost 3000
+ *     echo help | socat - UNIX-CONNECT:/tmp/babbler.sock
+ *     screen /dev/pts/N
+ */
+
+#include "babbler.h"
+#include "babbler_simple.h"
+#include "babbler_json.h"
+#include "babbler_cmd_core.h"
+#include "babbler_cmd_devinfo.h"
+#include "babbler_posix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+/** Зарегистрированные команды */
+/** Registered commands */
+extern const babbler_cmd_t BABBLER_COMMANDS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    CMD_HELP,
+    CMD_PING,
+    
+    // команды из babbler_cmd_devinfo.h
+    // commands from babbler_cmd_devinfo.h
+    CMD_NAME,
+    CMD_MODEL,
+    CMD_SERIAL_NUMBER,
+    CMD_MANUFACTURER,
+    CMD_VERSION
+};
+
+/** Количество зарегистрированных команд */
+/** Number of registered commands*/
+extern const int BABBLER_COMMANDS_COUNT = sizeof(BABBLER_COMMANDS)/sizeof(babbler_cmd_t);
+
+
+/** Руководства для зарегистрированных команд */
+/** Manuals for registered commands */
+extern const babbler_man_t BABBLER_MANUALS[] = {
+    // команды из babbler_cmd_core.h
+    // commands from babbler_cmd.core.h
+    MAN_HELP,
+    MAN_PING,
+    
+    // команды из babbler_cmd_devinfo.h
+    // commands from babbler_cmd_devinfo.h
+    MAN_NAME,
+    MAN_MODEL,
+    MAN_SERIAL_NUMBER,
+    MAN_MANUFACTURER,
+    MAN_VERSION
+};
+
+/** Количество руководств для зарегистрированных команд */
+/** Number of manuals for registered commands */
+extern const int BABBLER_MANUALS_COUNT = sizeof(BABBLER_MANUALS)/sizeof(babbler_man_t);
+
+// Информация об устройстве для babbler_cmd_devinfo.h
+// Device info for babbler_cmd_devinfo.h
+const char* DEVICE_NAME = "Babbler simulator";
+const char* DEVICE_MODEL = "Linux host";
+const char* DEVICE_SERIAL_NUMBER = "00000001";
+const char* DEVICE_DESCRIPTION = "Babbler command tables served from a Linux process";
+const char* DEVICE_VERSION = "1.0";
+const char* DEVICE_MANUFACTURER = "sadr0b0t";
+const char* DEVICE_URI = "https://github.com/1i7/babbler_h";
+
+static volatile bool _running = true;
+
+static void _stop(int sig) {
+    _running = false;
+}
+
+int main(int argc, char* argv[]) {
+    signal(SIGINT, _stop);
+    signal(SIGTERM, _stop);
+    
+    // ответы команд devinfo - один раз, до запуска рабочих потоков
+    // build devinfo replies once, before worker threads start
+    babbler_devinfo_setup();
+    
+    if(babbler_posix_setup() < 0) {
+        perror("babbler_posix_setup");
+        return 1;
+    }
+    
+    // по умолчанию - простые текстовые команды с переносом строки
+    // simple newline-separated text commands by default
+    babbler_posix_set_packet_filter(packet_filter_newline);
+    babbler_posix_set_input_handler(handle_input_simple);
+    babbler_posix_set_error_handler(handle_input_error_simple);
+    
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            // выполнять команды в рабочих потоках
+            // execute commands in worker threads
+            if(babbler_posix_set_workers(atoi(argv[++i])) < 0) {
+                perror("babbler_posix_set_workers");
+                return 1;
+            }
+        } else if(strcmp(argv[i], "--json") == 0) {
+            // настройки применяются к соединениям, открытым после них
+            // settings apply to connections opened after them
+            babbler_posix_set_input_handler(handle_input_json);
+            babbler_posix_set_error_handler(handle_input_error_json);
+        } else if(strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+            int port = atoi(argv[++i]);
+            if(babbler_posix_listen_tcp(NULL, port) < 0) {
+                perror("babbler_posix_listen_tcp");
+                return 1;
+            }
+            printf("Listening on TCP port %d\n", port);
+        } else if(strcmp(argv[i], "--unix") == 0 && i + 1 < argc) {
+            const char* path = argv[++i];
+            if(babbler_posix_listen_unix(path) < 0) {
+                perror("babbler_posix_listen_unix");
+                return 1;
+            }
+            printf("Listening on UNIX socket %s\n", path);
+        } else if(strcmp(argv[i], "--pty") == 0) {
+            char slave_name[64];
+            if(babbler_posix_open_pty(slave_name, sizeof(slave_name)) < 0) {
+                perror("babbler_posix_open_pty");
+                return 1;
+            }
+            printf("Serving pty %s\n", slave_name);
+        } else {
+            fprintf(stderr, "Usage: %s [--workers N] [--json] [--tcp PORT] [--unix PATH] [--pty]\n", argv[0]);
+            return 1;
+        }
+    }
+    fflush(stdout);
+    
+    while(_running) {
+        // ждем входные данные, выполняем команды, отправляем ответы
+        // wait for input data, execute commands, send replies
+        babbler_posix_tasks(1000);
+    }
+    
+    babbler_posix_close();
+    return 0;
+}
+
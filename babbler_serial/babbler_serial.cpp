@@ -5,23 +5,575 @@
 
 #include "babbler_serial.h"
 #include "babbler_io.h"
+#include "babbler_async.h"
+#include "babbler_len_prefix.h"
+#include "babbler_footprint.h"
+#include "babbler_reply_cache.h"
 
-// Буферы для обмена данными с компьютером через последовательный порт
-// +1 байт в конце для завершающего нуля
-static char* _read_buffer;
-static int _read_buffer_size;
-static char* _write_buffer;
-static int _write_buffer_size;
+#ifdef BABBLER_HOST_ARDUINO_H
+#include "babbler_host.h"
+#endif
 
-static int _write_size;
+#ifdef __AVR__
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#endif // __AVR__
 
-/** см module:babbler_io.h~packet_filter */
-// указатель на функцию - фильтр пакетов
-static packet_filter _is_packet;
+// Символы программного управления потоком
+#define XON 0x11
+#define XOFF 0x13
 
-// указатель на функцию - обработчик входящих пакетов
-/** см module:babbler_io.h~input_handler */
-static input_handler _handle_input;
+// Канал связи по умолчанию - порт Serial (см babbler_serial_setup)
+static babbler_serial_t _default_port;
+
+// Зарегистрированные каналы связи, обслуживаются в babbler_serial_tasks
+static babbler_serial_t* _ports = NULL;
+
+/**
+ * Предварительная настройка канала связи через поток stream, 
+ * выполнить один раз в setup. Порт должен быть инициализирован 
+ * отдельно (например, Serial1.begin(9600)).
+ * 
+ * Канал регистрируется в модуле и далее обслуживается вызовом 
+ * babbler_serial_tasks вместе с остальными каналами.
+ * 
+ * Все поля port получают значения по умолчанию (структура может быть 
+ * неинициализированной, например, локальной переменной), поэтому 
+ * фильтр пакетов, обработчики и прочие настройки канала задаются 
+ * функциями babbler_serial_port_set_* после вызова setup.
+ * 
+ * @param port - канал связи
+ * @param stream - поток для обмена данными (Serial, Serial1 и т.п.)
+ */
+void babbler_serial_port_setup(babbler_serial_t* port, Stream& stream,
+        char* read_buffer, int read_buffer_size,
+        char* write_buffer, int write_buffer_size) {
+    port->stream = &stream;
+    
+    port->read_buffer = read_buffer;
+    port->read_buffer_size = read_buffer_size;
+    port->write_buffer = write_buffer;
+    port->write_buffer_size = write_buffer_size;
+    port->write_size = 0;
+    port->write_pos = 0;
+    #ifdef BABBLER_SERIAL_BLOCKING_WRITE
+        port->write_blocking = true;
+    #else
+        port->write_blocking = false;
+    #endif // BABBLER_SERIAL_BLOCKING_WRITE
+    port->write_avail_seen = false;
+    port->write_waiting = false;
+    
+    port->rx_frames[0] = read_buffer;
+    port->rx_queue_len = 1;
+    port->rx_frame_len[0] = 0;
+    port->rx_head = 0;
+    port->rx_count = 0;
+    port->rx_skip = 0;
+    port->rx_overflow = false;
+    
+    port->time_budget = 0;
+    port->overflow_count = 0;
+    
+    port->flow_mode = BABBLER_SERIAL_FLOW_NONE;
+    port->flow_high_water = 1;
+    port->flow_stopped = false;
+    port->flow_pending = 0;
+    port->flow_busy = 0;
+    
+    // фильтр пакетов и обработчики настраиваются после setup 
+    // функциями babbler_serial_port_set_*
+    port->is_packet = NULL;
+    port->packet_size = NULL;
+    port->handle_input = NULL;
+    port->handle_error = NULL;
+    
+    // регистрируем канал, если он еще не в списке
+    babbler_serial_t* registered = _ports;
+    while(registered != NULL && registered != port) {
+        registered = registered->next;
+    }
+    if(registered == NULL) {
+        port->next = _ports;
+        _ports = port;
+    }
+}
+
+/**
+ * Настроить фильтр пакетов для канала port, 
+ * см babbler_serial_set_packet_filter.
+ */
+void babbler_serial_port_set_packet_filter(babbler_serial_t* port, packet_filter is_packet) {
+    port->is_packet = is_packet;
+}
+
+/**
+ * Настроить определение размера пакета для канала port, 
+ * см babbler_serial_set_packet_size_hint.
+ */
+void babbler_serial_port_set_packet_size_hint(babbler_serial_t* port, packet_size_hint packet_size) {
+    port->packet_size = packet_size;
+}
+
+/**
+ * Настроить обработчик пакетов входных данных для канала port, 
+ * см babbler_serial_set_input_handler.
+ */
+void babbler_serial_port_set_input_handler(babbler_serial_t* port, input_handler handle_input) {
+    port->handle_input = handle_input;
+}
+
+/**
+ * Настроить обработчик ошибок приема для канала port, 
+ * см babbler_serial_set_error_handler.
+ */
+void babbler_serial_port_set_error_handler(babbler_serial_t* port, input_error_handler handle_error) {
+    port->handle_error = handle_error;
+}
+
+/**
+ * Количество входных пакетов канала port, отброшенных из-за того, 
+ * что они не поместились в буфер чтения.
+ */
+unsigned long babbler_serial_port_overflow_count(babbler_serial_t* port) {
+    return port->overflow_count;
+}
+
+/**
+ * Настроить управление потоком для канала port (вызывать после 
+ * babbler_serial_port_set_rx_queue), см babbler_serial_set_flow_control.
+ */
+void babbler_serial_port_set_flow_control(babbler_serial_t* port, int flow_mode, int high_water) {
+    // для приема отклоняемых пакетов в очереди должна оставаться свободная ячейка
+    int max_high_water = flow_mode == BABBLER_SERIAL_FLOW_BUSY ? 
+        port->rx_queue_len - 1 : port->rx_queue_len;
+    if(high_water > max_high_water) {
+        high_water = max_high_water;
+    }
+    if(high_water < 1) {
+        high_water = 1;
+    }
+    
+    port->flow_mode = flow_mode;
+    port->flow_high_water = high_water;
+    port->flow_stopped = false;
+    port->flow_pending = 0;
+    port->flow_busy = 0;
+}
+
+/**
+ * Настроить очередь приема для канала port (вызывать после babbler_serial_port_setup), 
+ * см babbler_serial_set_rx_queue.
+ */
+void babbler_serial_port_set_rx_queue(babbler_serial_t* port, char* rx_queue_buffer, int frames_count) {
+    if(frames_count > BABBLER_SERIAL_RX_QUEUE_MAX) {
+        frames_count = BABBLER_SERIAL_RX_QUEUE_MAX;
+    }
+    
+    port->rx_queue_len = frames_count;
+    for(int i = 0; i < frames_count; i++) {
+        port->rx_frames[i] = rx_queue_buffer + i * (port->read_buffer_size + 1);
+        port->rx_frame_len[i] = 0;
+    }
+    port->rx_head = 0;
+    port->rx_count = 0;
+    port->rx_skip = 0;
+    port->rx_overflow = false;
+}
+
+/**
+ * Включить двойной буфер приема для канала port (вызывать после 
+ * babbler_serial_port_setup), см babbler_serial_set_double_buffer.
+ */
+void babbler_serial_port_set_double_buffer(babbler_serial_t* port, char* read_buffer2) {
+    char* frames[2] = {port->read_buffer, read_buffer2};
+    // с очередью на одну ячейку (BABBLER_SERIAL_RX_QUEUE_MAX=1) второй 
+    // буфер не используется, прием - как без двойного буфера
+    int frames_count = BABBLER_SERIAL_RX_QUEUE_MAX < 2 ? BABBLER_SERIAL_RX_QUEUE_MAX : 2;
+    
+    port->rx_queue_len = frames_count;
+    for(int i = 0; i < frames_count; i++) {
+        port->rx_frames[i] = frames[i];
+        port->rx_frame_len[i] = 0;
+    }
+    port->rx_head = 0;
+    port->rx_count = 0;
+    port->rx_skip = 0;
+    port->rx_overflow = false;
+}
+
+/**
+ * Писать ответы канала port без проверки availableForWrite, 
+ * см babbler_serial_set_blocking_write.
+ */
+void babbler_serial_port_set_blocking_write(babbler_serial_t* port, bool blocking) {
+    port->write_blocking = blocking;
+    port->write_waiting = false;
+}
+
+/**
+ * Ограничение по времени на обработку пакетов для канала port, 
+ * см babbler_serial_set_time_budget.
+ */
+void babbler_serial_port_set_time_budget(babbler_serial_t* port, unsigned long time_budget) {
+    port->time_budget = time_budget;
+}
+
+/**
+ * Указатель на ячейку очереди приема канала port с индексом frame.
+ */
+static char* _rx_frame(babbler_serial_t* port, int frame) {
+    return port->rx_frames[frame];
+}
+
+/**
+ * Сколько байт из write_len можно записать в поток канала port, 
+ * не блокируя loop: столько, сколько помещается в буфер отправки порта 
+ * (availableForWrite), или все write_len с блокирующей записью.
+ * 
+ * Поток, который ни разу не сообщил о свободном месте (availableForWrite 
+ * не переопределен и всегда возвращает 0, например SoftwareSerial), 
+ * после BABBLER_SERIAL_WRITE_STALL_TIMEOUT миллисекунд ожидания 
+ * переводит канал на блокирующую запись - иначе ответ не отправится никогда.
+ */
+static int _write_avail(babbler_serial_t* port, int write_len) {
+    if(port->write_blocking) {
+        return write_len;
+    }
+    
+    int write_avail = port->stream->availableForWrite();
+    if(write_avail > 0) {
+        port->write_avail_seen = true;
+        port->write_waiting = false;
+        return write_len < write_avail ? write_len : write_avail;
+    }
+    
+    if(!port->write_waiting) {
+        port->write_waiting = true;
+        port->write_wait_start = millis();
+    } else if(!port->write_avail_seen && 
+            millis() - port->write_wait_start >= BABBLER_SERIAL_WRITE_STALL_TIMEOUT) {
+        port->write_blocking = true;
+        port->write_waiting = false;
+        return write_len;
+    }
+    return 0;
+}
+
+/**
+ * Программное управление потоком XON/XOFF: отправить клиенту XOFF, 
+ * когда очередь приема заполнится до flow_high_water пакетов, 
+ * и XON, когда освободится до flow_high_water/2 пакетов.
+ * Символ отправляется в обход буфера ответа; если в буфере отправки 
+ * порта нет места, символ будет отправлен при следующем вызове.
+ */
+static void _flow_control(babbler_serial_t* port) {
+    if(port->flow_mode != BABBLER_SERIAL_FLOW_XONXOFF) {
+        return;
+    }
+    
+    if(!port->flow_stopped && port->rx_count >= port->flow_high_water) {
+        port->flow_stopped = true;
+        port->flow_pending = XOFF;
+    } else if(port->flow_stopped && port->rx_count <= port->flow_high_water / 2) {
+        port->flow_stopped = false;
+        port->flow_pending = XON;
+    }
+    
+    if(port->flow_pending && _write_avail(port, 1) > 0) {
+        port->stream->write(port->flow_pending);
+        port->flow_pending = 0;
+    }
+}
+
+/**
+ * Поставить в очередь приема вместо пакета, который не поместился в буфер,
+ * отметку о переполнении: на нее будет отправлен ответ с сообщением об ошибке.
+ */
+static void _rx_commit_overflow(babbler_serial_t* port, int frame) {
+    port->rx_frame_len[frame] = INPUT_OVERFLOW_ERROR;
+    port->rx_count++;
+}
+
+/**
+ * Подсказка размера пакета для канала: заданная babbler_serial_port_set_packet_size_hint,
+ * а для фильтра packet_filter_len_prefix без подсказки - packet_size_len_prefix:
+ * конец такого пакета нельзя узнать по последнему байту, без размера остаток 
+ * слишком длинного пакета не отличить от следующих пакетов.
+ */
+static packet_size_hint _packet_size(babbler_serial_t* port) {
+    if(port->packet_size == NULL && port->is_packet == packet_filter_len_prefix) {
+        return packet_size_len_prefix;
+    }
+    return port->packet_size;
+}
+
+/**
+ * Забрать доступные входные данные канала port в очередь приема, 
+ * разложить на пакеты при помощи фильтра пакетов. Сами пакеты не обрабатываются.
+ */
+void babbler_serial_port_receive(babbler_serial_t* port) {
+    Stream* stream = port->stream;
+    
+    // берем из порта по одному символу до тех пор, пока 
+    // - есть данные
+    // - и в очереди есть свободная ячейка
+    // пакет считается принятым, когда его определит фильтр пакетов 
+    // (или когда количество символов достигнет лимита, если фильтра нет)
+    packet_size_hint packet_size = _packet_size(port);
+    while(port->rx_count < port->rx_queue_len && stream->available() > 0) {
+        int tail = (port->rx_head + port->rx_count) % port->rx_queue_len;
+        char* frame = _rx_frame(port, tail);
+        
+        if(port->rx_skip > 0) {
+            // пропускаем остаток пакета, который не поместится в буфер
+            stream->read();
+            port->rx_skip--;
+            if(port->rx_skip == 0) {
+                _rx_commit_overflow(port, tail);
+            }
+            continue;
+        }
+        
+        if(port->rx_overflow) {
+            // пропускаем остаток пакета, который не поместился в буфер, 
+            // до разделителя: фильтру пакетов показываем только последний 
+            // принятый байт (пакеты с размером в заголовке сюда не попадают - 
+            // их пропускает rx_skip по размеру, см _packet_size)
+            frame[0] = stream->read();
+            if(port->is_packet(frame, 1)) {
+                port->rx_overflow = false;
+                _rx_commit_overflow(port, tail);
+            }
+            continue;
+        }
+        
+        frame[port->rx_frame_len[tail]] = stream->read();
+        port->rx_frame_len[tail]++;
+        
+        if(packet_size) {
+            // размер пакета известен заранее - можно сразу проверить, 
+            // поместится ли он в буфер, и дочитать его одним блоком
+            long size = packet_size(frame, port->rx_frame_len[tail]);
+            if(size > port->read_buffer_size) {
+                // пакет не поместится в буфер - пропускаем его целиком
+                port->overflow_count++;
+                port->rx_skip = size - port->rx_frame_len[tail];
+                port->rx_frame_len[tail] = 0;
+                continue;
+            } else if(size > port->rx_frame_len[tail]) {
+                int read_len = (int)(size - port->rx_frame_len[tail]);
+                if(read_len > stream->available()) {
+                    read_len = stream->available();
+                }
+                port->rx_frame_len[tail] += 
+                    stream->readBytes(frame + port->rx_frame_len[tail], read_len);
+            }
+        }
+        
+        if(!port->is_packet && port->rx_frame_len[tail] == 1) {
+            // хак: без этой задержки при вводе команд в окно mpide Tools/Serial monitor
+            // первый символ введенной строки отделяется от остальных и воспринимается
+            // этим кодом как отдельная строка
+            // (нужно только без фильтра пакетов: с фильтром пакет дожидается
+            // своего окончания в очереди)
+            delay(100);
+        }
+        
+        if(port->is_packet && port->is_packet(frame, port->rx_frame_len[tail])) {
+            if(port->flow_mode == BABBLER_SERIAL_FLOW_BUSY && 
+                    port->rx_count >= port->flow_high_water) {
+                // очередь заполнена - пакет не выполняем и ячейку им не занимаем: 
+                // отбрасываем, как остаток слишком длинного пакета, и только 
+                // считаем ответы REPLY_BUSY (их отправит babbler_serial_port_tasks), 
+                // прием продолжается в ту же свободную ячейку
+                port->rx_frame_len[tail] = 0;
+                port->flow_busy++;
+            } else {
+                // пакет принят целиком, следующие данные - в следующую ячейку
+                port->rx_count++;
+            }
+        } else if(port->rx_frame_len[tail] >= port->read_buffer_size) {
+            if(port->is_packet) {
+                // пакет не поместился в буфер: не выполняем обрезанное начало, 
+                // пропускаем остаток до разделителя (иначе остаток будет 
+                // принят за отдельную команду)
+                port->overflow_count++;
+                port->rx_overflow = true;
+                port->rx_frame_len[tail] = 0;
+            } else {
+                // без фильтра пакетов пакетом считаем заполненный буфер
+                port->rx_count++;
+            }
+        }
+    }
+    
+    if(!port->is_packet && port->rx_count < port->rx_queue_len && stream->available() == 0) {
+        // без фильтра пакетов пакетом считаем всё, что успело прийти
+        int tail = (port->rx_head + port->rx_count) % port->rx_queue_len;
+        if(port->rx_frame_len[tail] > 0) {
+            port->rx_count++;
+        }
+    }
+    
+    _flow_control(port);
+}
+
+/**
+ * Отправить очередную порцию ответа из буфера write_buffer канала port: 
+ * ровно столько, сколько поместится в буфер отправки порта, 
+ * чтобы не блокировать выполнение основного цикла loop.
+ * Остаток ответа будет отправлен при следующих вызовах.
+ */
+static void _transmit(babbler_serial_t* port) {
+    if(port->write_pos < port->write_size) {
+        int write_len = _write_avail(port, port->write_size - port->write_pos);
+        if(write_len > 0) {
+            // пишем данные
+            port->stream->write(port->write_buffer + port->write_pos, write_len);
+            port->write_pos += write_len;
+        }
+    }
+    
+    if(port->write_pos >= port->write_size) {
+        // ответ отправлен целиком
+        port->write_size = 0;
+        port->write_pos = 0;
+    }
+}
+
+/**
+ * Постоянные задачи для одного канала port, 
+ * см babbler_serial_tasks.
+ * @return через сколько миллисекунд канал снова потребует внимания
+ */
+unsigned long babbler_serial_port_tasks(babbler_serial_t* port) {
+    babbler_serial_port_receive(port);
+    
+    // продолжаем отправлять предыдущий ответ
+    _transmit(port);
+    
+    unsigned long start_time = millis();
+    bool did_work = false;
+    
+    // ответы REPLY_BUSY на пакеты, отклоненные при заполненной очереди 
+    // (BABBLER_SERIAL_FLOW_BUSY), - раньше пакетов из очереди: клиент 
+    // должен как можно скорее узнать, что команда не выполнена
+    while(port->flow_busy > 0 && port->write_size == 0) {
+        port->flow_busy--;
+        did_work = true;
+        if(port->handle_error) {
+            int writeSize = port->handle_error(INPUT_BUSY_ERROR, 
+                port->write_buffer, port->write_buffer_size);
+            if(writeSize > 0) {
+                port->write_size = writeSize;
+                port->write_pos = 0;
+                _transmit(port);
+            }
+        }
+    }
+    
+    // обрабатываем пакеты из очереди, пока они есть и пока 
+    // не вышли за ограничение по времени;
+    // новый пакет не обрабатываем, пока не отправлен ответ на предыдущий
+    while(port->rx_count > 0 && port->write_size == 0) {
+        char* frame = _rx_frame(port, port->rx_head);
+        int readSize = port->rx_frame_len[port->rx_head];
+        int writeSize = 0;
+        did_work = true;
+        
+        if(readSize < 0) {
+            // пакет был отброшен (не поместился в буфер INPUT_OVERFLOW_ERROR) - 
+            // отвечаем сообщением об ошибке
+            if(port->handle_error) {
+                writeSize = port->handle_error(readSize, 
+                    port->write_buffer, port->write_buffer_size);
+            }
+        } else {
+            #ifdef DEBUG_SERIAL
+                Serial.print("Read: ");
+                Serial.write(frame, readSize);
+                Serial.print(" (size=");
+                Serial.print(readSize);
+                Serial.println(")");
+            #endif // DEBUG_SERIAL
+            
+            // теперь можно выполнить команду, ответ попадет в write_buffer
+            // (ответ отложенной команды получит этот же канал, см babbler_async.h)
+            babbler_async_set_owner(port);
+            #ifdef BABBLER_FOOTPRINT
+                babbler_footprint_begin();
+            #endif // BABBLER_FOOTPRINT
+            #ifdef BABBLER_REPLY_CACHE
+                // готовый ответ из кэша или выполнить запрос и сохранить ответ
+                writeSize = babbler_reply_cache_lookup(port->handle_input, frame, readSize,
+                    port->write_buffer, port->write_buffer_size);
+                if(writeSize == -1) {
+                    writeSize = port->handle_input(frame, readSize, port->write_buffer, port->write_buffer_size);
+                    babbler_reply_cache_store(port->write_buffer, writeSize);
+                }
+            #else
+                writeSize = port->handle_input(frame, readSize, port->write_buffer, port->write_buffer_size);
+            #endif // BABBLER_REPLY_CACHE
+            #ifdef BABBLER_FOOTPRINT
+                babbler_footprint_end();
+            #endif // BABBLER_FOOTPRINT
+            babbler_async_set_owner(NULL);
+        }
+        
+        // освобождаем ячейку
+        port->rx_frame_len[port->rx_head] = 0;
+        port->rx_head = (port->rx_head + 1) % port->rx_queue_len;
+        port->rx_count--;
+        _flow_control(port);
+        
+        // отправляем ответ
+        if(writeSize > 0) {
+            #ifdef DEBUG_SERIAL
+                Serial.print("Write: ");
+                Serial.write(port->write_buffer, writeSize);
+                Serial.print(" (size=");
+                Serial.print(writeSize);
+                Serial.println(")");
+            #endif // DEBUG_SERIAL
+            
+            port->write_size = writeSize;
+            port->write_pos = 0;
+            _transmit(port);
+        }
+        
+        // пока обрабатывали пакет, могли прийти новые данные
+        babbler_serial_port_receive(port);
+        
+        if(millis() - start_time >= port->time_budget) {
+            break;
+        }
+    }
+    
+    // ответ отложенной команды, которая успела завершиться 
+    // (по одному за вызов, когда буфер отправки свободен)
+    if(port->write_size == 0) {
+        int writeSize = babbler_async_tasks(port, port->write_buffer, port->write_buffer_size);
+        if(writeSize > 0) {
+            port->write_size = writeSize;
+            port->write_pos = 0;
+            _transmit(port);
+            did_work = true;
+        }
+    }
+    
+    if(did_work || (port->rx_count > 0 && port->write_size == 0)) {
+        // после выполненной работы или с пакетами, которые не уместились 
+        // в ограничение по времени, - сразу на следующий круг
+        return 0;
+    } else if(port->write_size > 0 || port->flow_pending) {
+        // ждем места в буфере отправки порта
+        return 1;
+    } else if(babbler_async_inflight(port) > 0) {
+        return BABBLER_SERIAL_ASYNC_POLL_INTERVAL;
+    }
+    return BABBLER_SERIAL_IDLE_FOREVER;
+}
 
 /**
  * Настроить фильтр пакетов.
@@ -34,7 +586,20 @@ static input_handler _handle_input;
  *         false - содержимое буфера не является корректным пакетом
  */
 void babbler_serial_set_packet_filter(packet_filter is_packet) {
-    _is_packet = is_packet;
+    babbler_serial_port_set_packet_filter(&_default_port, is_packet);
+}
+
+/**
+ * Настроить определение размера пакета (не обязательно). Если размер
+ * пакета известен по его началу (например, пакеты с длиной в заголовке, 
+ * см babbler_len_prefix.h), оставшиеся данные пакета дочитываются 
+ * из порта одним блоком, а пакет, который заведомо не поместится в буфер 
+ * чтения, пропускается целиком, не попадая в обработчик.
+ * @param {module:babbler_io.h~packet_size_hint} packet_size - указатель на функцию, 
+ *       которая определяет полный размер пакета по его началу.
+ */
+void babbler_serial_set_packet_size_hint(packet_size_hint packet_size) {
+    babbler_serial_port_set_packet_size_hint(&_default_port, packet_size);
 }
 
 /**
@@ -52,7 +617,28 @@ void babbler_serial_set_packet_filter(packet_filter is_packet) {
  *     0: не отправлять ответ
  */
 void babbler_serial_set_input_handler(input_handler handle_input) {
-    _handle_input = handle_input;
+    babbler_serial_port_set_input_handler(&_default_port, handle_input);
+}
+
+/**
+ * Настроить обработчик ошибок приема: формирует ответ с сообщением 
+ * об ошибке, если входной пакет не поместился в буфер чтения 
+ * (код ошибки INPUT_OVERFLOW_ERROR). Если обработчик не задан, 
+ * такой пакет отбрасывается без ответа.
+ * @param {module:babbler_io.h~input_error_handler} handle_error - указатель на функцию, 
+ *       которая формирует ответ с сообщением об ошибке в формате обработчика 
+ *       входных данных (например, handle_input_error_simple для handle_input_simple).
+ */
+void babbler_serial_set_error_handler(input_error_handler handle_error) {
+    babbler_serial_port_set_error_handler(&_default_port, handle_error);
+}
+
+/**
+ * Количество входных пакетов, отброшенных из-за того, 
+ * что они не поместились в буфер чтения.
+ */
+unsigned long babbler_serial_overflow_count() {
+    return babbler_serial_port_overflow_count(&_default_port);
 }
 
 /**
@@ -67,10 +653,16 @@ void babbler_serial_setup(
         char* read_buffer, int read_buffer_size,
         char* write_buffer, int write_buffer_size,
         long speed) {
-    _read_buffer = read_buffer;
-    _read_buffer_size = read_buffer_size;
-    _write_buffer = write_buffer;
-    _write_buffer_size = write_buffer_size;
+    // для канала по умолчанию фильтр пакетов и обработчики можно 
+    // настроить и до вызова setup (так написаны старые скетчи)
+    babbler_serial_t configured = _default_port;
+    babbler_serial_port_setup(&_default_port, Serial,
+        read_buffer, read_buffer_size,
+        write_buffer, write_buffer_size);
+    _default_port.is_packet = configured.is_packet;
+    _default_port.packet_size = configured.packet_size;
+    _default_port.handle_input = configured.handle_input;
+    _default_port.handle_error = configured.handle_error;
     
     if(speed != BABBLER_SERIAL_SKIP_PORT_INIT) {
         Serial.begin(speed);
@@ -78,61 +670,153 @@ void babbler_serial_setup(
 }
 
 /**
- * Постоянные задачи для канала связи последовательный порт Serial, 
- * выполнять на каждой итерации в бесконечном цикле loop
+ * Настроить очередь приема: входные пакеты складываются в кольцевой буфер
+ * из frames_count ячеек, каждая размером read_buffer_size+1 
+ * (см babbler_serial_setup), и обрабатываются по очереди в babbler_serial_tasks.
+ * 
+ * Вызывать после babbler_serial_setup. Если очередь не настроена, 
+ * принятые данные хранятся в одной ячейке - буфере read_buffer.
+ * 
+ * @param rx_queue_buffer - буфер для очереди приема размером
+ *     BABBLER_SERIAL_RX_QUEUE_SIZE(read_buffer_size, frames_count) байт
+ * @param frames_count - количество ячеек в очереди, 
+ *     не больше BABBLER_SERIAL_RX_QUEUE_MAX (см babbler_lib_config.h)
+ */
+void babbler_serial_set_rx_queue(char* rx_queue_buffer, int frames_count) {
+    babbler_serial_port_set_rx_queue(&_default_port, rx_queue_buffer, frames_count);
+}
+
+/**
+ * Включить двойной буфер приема: следующий пакет принимается во второй 
+ * буфер, пока выполняется пакет из первого.
+ * 
+ * Вызывать после babbler_serial_setup.
+ * 
+ * @param read_buffer2 - второй буфер чтения размером read_buffer_size+1 байт
+ */
+void babbler_serial_set_double_buffer(char* read_buffer2) {
+    babbler_serial_port_set_double_buffer(&_default_port, read_buffer2);
+}
+
+/**
+ * Настроить управление потоком, чтобы клиент не отправлял команды 
+ * быстрее, чем устройство успевает их обрабатывать (вызывать после 
+ * babbler_serial_set_rx_queue).
+ * 
+ * @param flow_mode - режим управления потоком BABBLER_SERIAL_FLOW_*
+ * @param high_water - количество пакетов в очереди, при котором включается 
+ *     управление потоком
+ */
+void babbler_serial_set_flow_control(int flow_mode, int high_water) {
+    babbler_serial_port_set_flow_control(&_default_port, flow_mode, high_water);
+}
+
+/**
+ * Писать ответы без проверки места в буфере отправки порта (availableForWrite).
+ * Вызывать после babbler_serial_setup.
+ * 
+ * @param blocking - true: писать без проверки availableForWrite
+ */
+void babbler_serial_set_blocking_write(bool blocking) {
+    babbler_serial_port_set_blocking_write(&_default_port, blocking);
+}
+
+/**
+ * Ограничение по времени на обработку пакетов из очереди приема 
+ * за один вызов babbler_serial_tasks.
+ * 
+ * @param time_budget - ограничение по времени в миллисекундах;
+ *     0 (значение по умолчанию) - один пакет за вызов.
+ */
+void babbler_serial_set_time_budget(unsigned long time_budget) {
+    babbler_serial_port_set_time_budget(&_default_port, time_budget);
+}
+
+/**
+ * Забрать доступные входные данные из порта в очередь приема 
+ * (для всех зарегистрированных каналов), разложить на пакеты при помощи 
+ * фильтра пакетов. Сами пакеты не обрабатываются.
+ */
+void babbler_serial_receive() {
+    for(babbler_serial_t* port = _ports; port != NULL; port = port->next) {
+        babbler_serial_port_receive(port);
+    }
+}
+
+/**
+ * Постоянные задачи для каналов связи через последовательный порт, 
+ * выполнять на каждой итерации в бесконечном цикле loop.
+ * Обслуживает все зарегистрированные каналы: канал по умолчанию Serial 
+ * (babbler_serial_setup) и каналы, настроенные babbler_serial_port_setup.
  * При получении команды вызывает функцию handle_input, указатель
- * на которую передан в babbler_serial_setup.
+ * на которую передан в babbler_serial_set_input_handler.
+ * @return через сколько миллисекунд нужен следующий вызов 
+ *     (BABBLER_SERIAL_IDLE_FOREVER - после прихода новых данных)
  */
-void babbler_serial_tasks() {
-    int readSize = 0;
-    int writeSize = 0;
-    
-    // берем из порта по одному символу до тех пор, пока 
-    // - есть данные
-    // - или фильтр пакетов не определит пакет,
-    // - или пока количество символов не превысит лимит чтения на один
-    // раз (размер буфера)
-    while((!_is_packet || !_is_packet(_read_buffer, readSize)) && 
-            Serial.available() > 0 && readSize < _read_buffer_size) {
-        _read_buffer[readSize] = Serial.read();
-        readSize++;
-        
-        // хак: без этой задержки при вводе команд в окно mpide Tools/Serial monitor
-        // первый символ введенной строки отделяется от остальных и воспринимается
-        // этим кодом как отдельная строка
-        if(readSize == 1) {
-            delay(100);
+unsigned long babbler_serial_tasks() {
+    unsigned long timeout = BABBLER_SERIAL_IDLE_FOREVER;
+    for(babbler_serial_t* port = _ports; port != NULL; port = port->next) {
+        unsigned long port_timeout = babbler_serial_port_tasks(port);
+        if(port_timeout < timeout) {
+            timeout = port_timeout;
         }
     }
-    if(readSize > 0) {
-        // Считали порцию данных
-        
-        #ifdef DEBUG_SERIAL
-            Serial.print("Read: ");
-            Serial.print(read_buffer);
-            Serial.print(" (size=");
-            Serial.print(readSize);
-            Serial.println(")");
-        #endif // DEBUG_SERIAL
-        
-        // теперь можно выполнить команду, ответ попадет в write_buffer
-        writeSize = _handle_input(_read_buffer, readSize, _write_buffer, _write_buffer_size);
-        _write_size = writeSize;
-    }
-    
-    // отправляем ответ
-    if(_write_size > 0) {
-        #ifdef DEBUG_SERIAL
-            Serial.print("Write: ");
-            Serial.print(_write_buffer);
-            Serial.print(" (size=");
-            Serial.print(write_size);
-            Serial.println(")");
-        #endif // DEBUG_SERIAL
+    return timeout;
+}
+
+/**
+ * Есть ли входные данные хотя бы в одном из зарегистрированных каналов, 
+ * которые канал может принять в очередь.
+ */
+static bool _input_available() {
+    for(babbler_serial_t* port = _ports; port != NULL; port = port->next) {
+        if(port->rx_count < port->rx_queue_len && port->stream->available() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Ждать не дольше timeout миллисекунд или до прихода входных данных 
+ * в любой из зарегистрированных каналов, не нагружая процессор.
+ * @param timeout - результат babbler_serial_tasks
+ */
+void babbler_serial_idle(unsigned long timeout) {
+    unsigned long start_time = millis();
+    while(timeout > 0 && !_input_available()) {
+        #if defined(__AVR__)
+            // засыпаем, только если за время проверки не пришло
+            // прерывание с новыми данными: sei вступает в силу после
+            // следующей инструкции, поэтому между sei и sleep_cpu
+            // прерывание не потеряется
+            set_sleep_mode(SLEEP_MODE_IDLE);
+            cli();
+            if(!_input_available()) {
+                sleep_enable();
+                sei();
+                sleep_cpu();
+                sleep_disable();
+            }
+            sei();
+        #elif defined(__arm__) && !defined(__linux__)
+            // проснемся по любому прерыванию (UART, SysTick)
+            __asm__ volatile("wfi");
+        #elif defined(BABBLER_HOST_ARDUINO_H)
+            // сборка для Linux: спим в poll до данных или до конца ожидания
+            unsigned long wait_time = BABBLER_SERIAL_IDLE_FOREVER;
+            if(timeout != BABBLER_SERIAL_IDLE_FOREVER) {
+                unsigned long elapsed = millis() - start_time;
+                wait_time = elapsed < timeout ? timeout - elapsed : 0;
+            }
+            babbler_host_wait(wait_time);
+        #else
+            yield();
+        #endif
         
-        // пишем данные
-        Serial.write(_write_buffer, _write_size);
-        _write_size = 0;
+        if(timeout != BABBLER_SERIAL_IDLE_FOREVER && millis() - start_time >= timeout) {
+            break;
+        }
     }
 }
 
@@ -3,8 +3,219 @@
 
 #define BABBLER_SERIAL_SKIP_PORT_INIT -1
 
+/**
+ * Размер буфера для очереди приема babbler_serial_set_rx_queue: 
+ * frames_count пакетов по frame_size байт (+1 байт в конце каждого 
+ * пакета для завершающего нуля).
+ */
+#define BABBLER_SERIAL_RX_QUEUE_SIZE(frame_size, frames_count) ((frames_count)*((frame_size)+1))
+
+/** Управление потоком выключено */
+#define BABBLER_SERIAL_FLOW_NONE 0
+/** 
+ * Программное управление потоком XON/XOFF: при заполнении очереди приема 
+ * клиенту отправляется символ XOFF (0x13), после освобождения - XON (0x11).
+ * Только для текстовых протоколов (символы могут попасть между байтами ответа).
+ */
+#define BABBLER_SERIAL_FLOW_XONXOFF 1
+/** 
+ * Отклонять пакеты при заполнении очереди приема: вместо выполнения 
+ * команды отправляется ответ REPLY_BUSY (см babbler_serial_set_error_handler).
+ */
+#define BABBLER_SERIAL_FLOW_BUSY 2
+
+/** 
+ * Результат babbler_serial_tasks: работы нет, следующий вызов нужен 
+ * только после прихода новых входных данных (см babbler_serial_idle).
+ */
+#define BABBLER_SERIAL_IDLE_FOREVER ((unsigned long)-1)
+
+#include "babbler_lib_config.h"
 #include "babbler_io.h"
 
+class Stream;
+
+/**
+ * Канал связи через последовательный порт: поток Stream 
+ * (Serial, Serial1, SerialUSB, SoftwareSerial и т.п.), собственные 
+ * буферы чтения и записи, фильтр пакетов и обработчик входных данных.
+ * 
+ * Поля структуры - внутреннее состояние модуля, настраивать канал
+ * следует при помощи функций babbler_serial_port_*.
+ */
+typedef struct babbler_serial_t {
+    /** Поток для обмена данными */
+    Stream* stream;
+    
+    // Буферы для обмена данными с компьютером через последовательный порт
+    // +1 байт в конце для завершающего нуля
+    char* read_buffer;
+    int read_buffer_size;
+    char* write_buffer;
+    int write_buffer_size;
+    
+    /** Размер ответа в буфере write_buffer */
+    int write_size;
+    /** Количество уже отправленных байт ответа */
+    int write_pos;
+    /** Писать в поток без проверки availableForWrite (см babbler_serial_port_set_blocking_write) */
+    bool write_blocking;
+    /** Поток хотя бы раз сообщил о месте в буфере отправки (availableForWrite() > 0) */
+    bool write_avail_seen;
+    /** Ждем места в буфере отправки с момента write_wait_start (millis) */
+    bool write_waiting;
+    unsigned long write_wait_start;
+    
+    // Очередь приема: кольцо из rx_queue_len ячеек по read_buffer_size+1 байт,
+    // по умолчанию одна ячейка - read_buffer.
+    // Ячейки [rx_head, rx_head+rx_count) содержат принятые целиком пакеты,
+    // в ячейку rx_head+rx_count (если очередь не заполнена) принимаются
+    // новые данные.
+    /** Указатели на ячейки очереди */
+    char* rx_frames[BABBLER_SERIAL_RX_QUEUE_MAX];
+    int rx_queue_len;
+    /** Количество байт в каждой ячейке */
+    int rx_frame_len[BABBLER_SERIAL_RX_QUEUE_MAX];
+    /** Первый пакет в очереди */
+    volatile int rx_head;
+    /** Количество принятых целиком пакетов в очереди */
+    volatile int rx_count;
+    
+    /** Ограничение по времени на обработку пакетов за один вызов tasks */
+    unsigned long time_budget;
+    
+    /** см module:babbler_io.h~packet_filter */
+    packet_filter is_packet;
+    /** см module:babbler_io.h~packet_size_hint */
+    packet_size_hint packet_size;
+    /** см module:babbler_io.h~input_handler */
+    input_handler handle_input;
+    
+    /** см module:babbler_io.h~input_error_handler */
+    input_error_handler handle_error;
+    
+    /** 
+     * Сколько байт еще нужно пропустить: остаток пакета, 
+     * который не поместится в буфер (см packet_size) 
+     */
+    long rx_skip;
+    /** 
+     * Пакет не поместился в буфер, пропускаем остаток пакета 
+     * до разделителя (см is_packet) 
+     */
+    bool rx_overflow;
+    /** Количество пакетов, отброшенных из-за переполнения буфера */
+    unsigned long overflow_count;
+    
+    /** Режим управления потоком BABBLER_SERIAL_FLOW_* */
+    int flow_mode;
+    /** Количество пакетов в очереди, при котором включается управление потоком */
+    int flow_high_water;
+    /** Клиенту отправлен XOFF */
+    bool flow_stopped;
+    /** Символ XON/XOFF, который еще не удалось отправить (0 - нет) */
+    char flow_pending;
+    /** Отклоненные пакеты, на которые еще не отправлен ответ REPLY_BUSY */
+    unsigned int flow_busy;
+    
+    /** Следующий зарегистрированный канал (см babbler_serial_tasks) */
+    struct babbler_serial_t* next;
+} babbler_serial_t;
+
+/**
+ * Предварительная настройка канала связи через поток stream, 
+ * выполнить один раз в setup. Порт должен быть инициализирован 
+ * отдельно (например, Serial1.begin(9600)).
+ * 
+ * Канал регистрируется в модуле и далее обслуживается вызовом 
+ * babbler_serial_tasks вместе с остальными каналами.
+ * 
+ * Все поля port получают значения по умолчанию (структура может быть 
+ * неинициализированной, например, локальной переменной), поэтому 
+ * фильтр пакетов, обработчики и прочие настройки канала задаются 
+ * функциями babbler_serial_port_set_* после вызова setup.
+ * 
+ * @param port - канал связи
+ * @param stream - поток для обмена данными (Serial, Serial1 и т.п.)
+ */
+void babbler_serial_port_setup(babbler_serial_t* port, Stream& stream,
+        char* read_buffer, int read_buffer_size,
+        char* write_buffer, int write_buffer_size);
+
+/**
+ * Настроить фильтр пакетов для канала port, 
+ * см babbler_serial_set_packet_filter.
+ */
+void babbler_serial_port_set_packet_filter(babbler_serial_t* port, packet_filter is_packet);
+
+/**
+ * Настроить определение размера пакета для канала port, 
+ * см babbler_serial_set_packet_size_hint.
+ */
+void babbler_serial_port_set_packet_size_hint(babbler_serial_t* port, packet_size_hint packet_size);
+
+/**
+ * Настроить обработчик пакетов входных данных для канала port, 
+ * см babbler_serial_set_input_handler.
+ */
+void babbler_serial_port_set_input_handler(babbler_serial_t* port, input_handler handle_input);
+
+/**
+ * Настроить обработчик ошибок приема для канала port, 
+ * см babbler_serial_set_error_handler.
+ */
+void babbler_serial_port_set_error_handler(babbler_serial_t* port, input_error_handler handle_error);
+
+/**
+ * Количество входных пакетов канала port, отброшенных из-за того, 
+ * что они не поместились в буфер чтения.
+ */
+unsigned long babbler_serial_port_overflow_count(babbler_serial_t* port);
+
+/**
+ * Настроить управление потоком для канала port (вызывать после 
+ * babbler_serial_port_set_rx_queue), см babbler_serial_set_flow_control.
+ */
+void babbler_serial_port_set_flow_control(babbler_serial_t* port, int flow_mode, int high_water);
+
+/**
+ * Настроить очередь приема для канала port (вызывать после babbler_serial_port_setup), 
+ * см babbler_serial_set_rx_queue.
+ */
+void babbler_serial_port_set_rx_queue(babbler_serial_t* port, char* rx_queue_buffer, int frames_count);
+
+/**
+ * Включить двойной буфер приема для канала port (вызывать после 
+ * babbler_serial_port_setup), см babbler_serial_set_double_buffer.
+ */
+void babbler_serial_port_set_double_buffer(babbler_serial_t* port, char* read_buffer2);
+
+/**
+ * Писать ответы канала port без проверки availableForWrite 
+ * (вызывать после babbler_serial_port_setup), 
+ * см babbler_serial_set_blocking_write.
+ */
+void babbler_serial_port_set_blocking_write(babbler_serial_t* port, bool blocking);
+
+/**
+ * Ограничение по времени на обработку пакетов для канала port, 
+ * см babbler_serial_set_time_budget.
+ */
+void babbler_serial_port_set_time_budget(babbler_serial_t* port, unsigned long time_budget);
+
+/**
+ * Забрать доступные входные данные канала port в очередь приема, 
+ * см babbler_serial_receive.
+ */
+void babbler_serial_port_receive(babbler_serial_t* port);
+
+/**
+ * Постоянные задачи для одного канала port, 
+ * см babbler_serial_tasks.
+ * @return через сколько миллисекунд канал снова потребует внимания
+ */
+unsigned long babbler_serial_port_tasks(babbler_serial_t* port);
+
 /**
  * Настроить фильтр пакетов.
  * @param {module:babbler_io.h~packet_filter} is_packet - указатель на функцию, 
@@ -17,6 +228,24 @@
  */
 void babbler_serial_set_packet_filter(packet_filter is_packet);
 
+/**
+ * Настроить определение размера пакета (не обязательно). Если размер
+ * пакета известен по его началу (например, пакеты с длиной в заголовке, 
+ * см babbler_len_prefix.h), оставшиеся данные пакета дочитываются 
+ * из порта одним блоком, а пакет, который заведомо не поместится в буфер 
+ * чтения, пропускается целиком, не попадая в обработчик.
+ * С фильтром packet_filter_len_prefix без подсказки размер берется 
+ * из заголовка (packet_size_len_prefix).
+ * @param {module:babbler_io.h~packet_size_hint} packet_size - указатель на функцию, 
+ *       которая определяет полный размер пакета по его началу.
+ *     packet_size:@param input - входные данные
+ *     packet_size:@param input_len - размер данных в буфере
+ *     packet_size:@return 
+ *         >0 - полный размер пакета в байтах
+ *         -1 - размер пакета пока нельзя определить
+ */
+void babbler_serial_set_packet_size_hint(packet_size_hint packet_size);
+
 /**
  * Настроить обработчик пакетов входных данных.
  * @param {module:babbler_io.h~input_handler} handle_input - указатель на функцию - обрабатчик входных данных:
@@ -33,6 +262,34 @@ void babbler_serial_set_packet_filter(packet_filter is_packet);
  */
 void babbler_serial_set_input_handler(input_handler handle_input);
 
+/**
+ * Настроить обработчик ошибок приема: формирует ответ с сообщением 
+ * об ошибке, если входной пакет не поместился в буфер чтения 
+ * (код ошибки INPUT_OVERFLOW_ERROR). 
+ * 
+ * Такой пакет не выполняется: остаток пакета пропускается до разделителя 
+ * (фильтр пакетов при этом получает только последний принятый байт, 
+ * см packet_filter_newline, packet_filter_cobs) или до конца пакета 
+ * известного размера (см babbler_serial_set_packet_size_hint), после чего 
+ * отправляется один ответ с сообщением об ошибке. Если обработчик не задан, 
+ * такой пакет отбрасывается без ответа.
+ * 
+ * @param {module:babbler_io.h~input_error_handler} handle_error - указатель на функцию, 
+ *       которая формирует ответ с сообщением об ошибке в формате обработчика 
+ *       входных данных (например, handle_input_error_simple для handle_input_simple).
+ *     handle_error:@param error_code - код ошибки < 0
+ *     handle_error:@param reply_buffer - буфер для записи ответа
+ *     handle_error:@param reply_buf_size - размер буфера reply_buffer
+ *     handle_error:@return длина ответа в байтах или код ошибки
+ */
+void babbler_serial_set_error_handler(input_error_handler handle_error);
+
+/**
+ * Количество входных пакетов, отброшенных из-за того, 
+ * что они не поместились в буфер чтения.
+ */
+unsigned long babbler_serial_overflow_count();
+
 /**
  * Предварительная настройка модуля канала связи - последовательный порт Serial, 
  * выполнить один раз в setup.
@@ -47,12 +304,178 @@ void babbler_serial_set_input_handler(input_handler handle_input);
         long speed);
 
 /**
- * Постоянные задачи для канала связи последовательный порт Serial, 
- * выполнять на каждой итерации в бесконечном цикле loop
+ * Настроить очередь приема: входные пакеты складываются в кольцевой буфер
+ * из frames_count ячеек, каждая размером read_buffer_size+1 
+ * (см babbler_serial_setup), и обрабатываются по очереди в babbler_serial_tasks.
+ * Позволяет клиенту отправлять несколько команд подряд, не дожидаясь 
+ * ответа на каждую.
+ * 
+ * Вызывать после babbler_serial_setup. Если очередь не настроена, 
+ * принятые данные хранятся в одной ячейке - буфере read_buffer.
+ * 
+ * @param rx_queue_buffer - буфер для очереди приема размером
+ *     BABBLER_SERIAL_RX_QUEUE_SIZE(read_buffer_size, frames_count) байт
+ * @param frames_count - количество ячеек в очереди, 
+ *     не больше BABBLER_SERIAL_RX_QUEUE_MAX (см babbler_lib_config.h)
+ */
+void babbler_serial_set_rx_queue(char* rx_queue_buffer, int frames_count);
+
+/**
+ * Включить двойной буфер приема (ping-pong): пока пакет из одного буфера 
+ * выполняется и пока отправляется ответ на него, следующий пакет принимается 
+ * во второй буфер; по окончании приема пакета буферы меняются местами. 
+ * То же, что очередь приема из двух ячеек (babbler_serial_set_rx_queue), 
+ * но вторым буфером может быть отдельный массив.
+ * 
+ * Вызывать после babbler_serial_setup. При BABBLER_SERIAL_RX_QUEUE_MAX=1 
+ * (см babbler_lib_config.h) второй буфер не используется.
+ * 
+ * Чтобы прием не останавливался и во время выполнения долгой команды, 
+ * команда может время от времени вызывать babbler_serial_receive - 
+ * буфер с выполняемым пакетом при этом не затрагивается 
+ * (он остается в очереди, пока команда не вернет ответ).
+ * 
+ * Double (ping-pong) receive buffer: the next packet is received into
+ * the second buffer while the current one executes and its reply is sent.
+ * Long-running commands may call babbler_serial_receive to keep receiving;
+ * the executing packet stays queued until the command returns.
+ * Ignored when BABBLER_SERIAL_RX_QUEUE_MAX is 1.
+ * 
+ *     char serial_read_buffer[SERIAL_READ_BUFFER_SIZE+1];
+ *     char serial_read_buffer2[SERIAL_READ_BUFFER_SIZE+1];
+ *     ...
+ *     babbler_serial_setup(serial_read_buffer, SERIAL_READ_BUFFER_SIZE, ...);
+ *     babbler_serial_set_double_buffer(serial_read_buffer2);
+ * 
+ * @param read_buffer2 - второй буфер чтения размером read_buffer_size+1 байт
+ *     (см babbler_serial_setup)
+ */
+void babbler_serial_set_double_buffer(char* read_buffer2);
+
+/**
+ * Настроить управление потоком, чтобы клиент не отправлял команды 
+ * быстрее, чем устройство успевает их обрабатывать (вызывать после 
+ * babbler_serial_set_rx_queue).
+ * 
+ * @param flow_mode - режим управления потоком:
+ *     BABBLER_SERIAL_FLOW_NONE - выключено (по умолчанию),
+ *     BABBLER_SERIAL_FLOW_XONXOFF - отправлять XOFF, когда в очереди приема 
+ *         high_water и больше принятых пакетов, и XON, когда очередь 
+ *         освободится до high_water/2 пакетов,
+ *     BABBLER_SERIAL_FLOW_BUSY - отвечать REPLY_BUSY на новые пакеты (не выполняя их),
+ *         пока в очереди приема high_water и больше пакетов; отклоненные пакеты 
+ *         ячеек очереди не занимают, ответы на них отправляются раньше ответов 
+ *         на пакеты из очереди, формирует их обработчик ошибок 
+ *         (см babbler_serial_set_error_handler)
+ * @param high_water - количество пакетов в очереди, при котором включается 
+ *     управление потоком, от 1 до количества ячеек очереди 
+ *     (для BABBLER_SERIAL_FLOW_BUSY - на 1 меньше, чтобы оставалось место 
+ *     для приема отклоняемых пакетов)
+ */
+void babbler_serial_set_flow_control(int flow_mode, int high_water);
+
+/**
+ * Писать ответы без проверки места в буфере отправки порта 
+ * (availableForWrite): запись блокирует loop до окончания отправки. 
+ * Для потоков, которые не сообщают о месте в буфере отправки 
+ * (availableForWrite не переопределен и всегда возвращает 0, 
+ * например SoftwareSerial). Такой поток канал распознает и сам: если 
+ * поток ни разу не сообщил о свободном месте, а ответ ждет отправки 
+ * дольше BABBLER_SERIAL_WRITE_STALL_TIMEOUT миллисекунд, канал переходит 
+ * на блокирующую запись (см babbler_lib_config.h).
+ * 
+ * Вызывать после babbler_serial_setup. По умолчанию выключено 
+ * (включено для всех каналов с BABBLER_SERIAL_BLOCKING_WRITE).
+ * 
+ * Write replies without checking the port TX buffer space; for streams
+ * whose availableForWrite always returns 0 (e.g. SoftwareSerial). Such
+ * streams are also detected after BABBLER_SERIAL_WRITE_STALL_TIMEOUT.
+ * 
+ *     SoftwareSerial soft_serial(10, 11);
+ *     ...
+ *     babbler_serial_port_setup(&soft_port, soft_serial, ...);
+ *     babbler_serial_port_set_blocking_write(&soft_port, true);
+ * 
+ * @param blocking - true: писать без проверки availableForWrite
+ */
+void babbler_serial_set_blocking_write(bool blocking);
+
+/**
+ * Ограничение по времени на обработку пакетов из очереди приема 
+ * за один вызов babbler_serial_tasks: пакеты обрабатываются один за другим,
+ * пока очередь не опустеет или пока не истечет time_budget миллисекунд.
+ * Хотя бы один пакет обрабатывается в любом случае.
+ * 
+ * @param time_budget - ограничение по времени в миллисекундах;
+ *     0 (значение по умолчанию) - один пакет за вызов.
+ */
+void babbler_serial_set_time_budget(unsigned long time_budget);
+
+/**
+ * Забрать доступные входные данные из порта в очередь приема 
+ * (для всех зарегистрированных каналов), разложить на пакеты при помощи 
+ * фильтра пакетов. Сами пакеты не обрабатываются.
+ * 
+ * Вызывается в babbler_serial_tasks; дополнительно можно вызывать из 
+ * serialEvent, чтобы быстрее освобождать аппаратный буфер порта:
+ * 
+ *     void serialEvent() {
+ *         babbler_serial_receive();
+ *     }
+ * 
+ * или из долгой команды, чтобы следующие пакеты принимались, пока она 
+ * выполняется (нужна очередь приема или двойной буфер, 
+ * см babbler_serial_set_double_buffer).
+ */
+void babbler_serial_receive();
+
+/**
+ * Постоянные задачи для каналов связи через последовательный порт, 
+ * выполнять на каждой итерации в бесконечном цикле loop.
+ * Обслуживает все зарегистрированные каналы: канал по умолчанию Serial 
+ * (babbler_serial_setup) и каналы, настроенные babbler_serial_port_setup.
  * При получении команды вызывает функцию handle_input, указатель
- * на которую передан в babbler_serial_setup.
+ * на которую передан в babbler_serial_set_input_handler.
+ * 
+ * Ответ отправляется порциями: за один вызов в порт пишется столько, 
+ * сколько помещается в буфер отправки (Serial.availableForWrite()), 
+ * остаток - при следующих вызовах (см babbler_serial_set_blocking_write). Пока ответ не отправлен целиком,
+ * новые пакеты не обрабатываются (но продолжают приниматься в очередь).
+ * 
+ * Отложенные команды (см babbler_async.h) опрашиваются здесь же, 
+ * их ответы отправляются по мере завершения в свободный буфер отправки 
+ * того канала, через который пришла команда.
+ * 
+ * @return через сколько миллисекунд нужен следующий вызов:
+ *     0 - работа выполнена или осталась (пакеты в очереди), вызвать сразу;
+ *     >0 - ждем отправки ответа или завершения отложенных команд;
+ *     BABBLER_SERIAL_IDLE_FOREVER - работы нет до прихода новых данных.
+ *     Значение можно передать в babbler_serial_idle, чтобы не крутить 
+ *     loop вхолостую:
+ * 
+ *     void loop() {
+ *         babbler_serial_idle(babbler_serial_tasks());
+ *     }
+ */
+unsigned long babbler_serial_tasks();
+
+/**
+ * Ждать не дольше timeout миллисекунд или до прихода входных данных 
+ * в любой из зарегистрированных каналов. На AVR процессор на время 
+ * ожидания засыпает в режиме SLEEP_MODE_IDLE (просыпается по прерыванию 
+ * UART, таймера millis и т.п.), на ARM Cortex-M - по инструкции WFI; 
+ * в сборке для Linux - в poll на все время ожидания (babbler_host_wait);
+ * на остальных платформах ожидание вызывает yield().
+ * 
+ * Wait up to timeout milliseconds or until input arrives on any registered
+ * channel; AVR idles in SLEEP_MODE_IDLE, ARM Cortex-M in WFI, the Linux
+ * build sleeps in a single poll (babbler_host_wait), other platforms
+ * call yield().
+ * 
+ * @param timeout - результат babbler_serial_tasks
+ *     (0 - вернуться сразу, BABBLER_SERIAL_IDLE_FOREVER - ждать входные данные)
  */
-void babbler_serial_tasks();
+void babbler_serial_idle(unsigned long timeout);
 
 #endif // BABBLER_SERIAL_H
 